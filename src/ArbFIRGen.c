@@ -2,7 +2,7 @@
 #include <string.h>
 #include <math.h>
 #include <errno.h>
-#include "kissfft/kiss_fftr.h"
+#include "VectorMath.h"
 #include "ArbFIRGen.h"
 #define PI 3.141592653589793
 #define PI2 6.283185307179586
@@ -194,8 +194,8 @@ double* fir2(int *nn, double *ff, double *aa, int ffsz)
 	}
 	// Fourier time-shift.
 	double dt = 0.5 * (double)(*nn - 1);
-	kiss_fft_cpx *Hz2 = (kiss_fft_cpx*)malloc(npt * sizeof(kiss_fft_cpx));
-	kiss_fft_cpx *Hz = (kiss_fft_cpx*)malloc(npt2 * sizeof(kiss_fft_cpx));
+	FFTComplex *Hz2 = (FFTComplex*)malloc(npt * sizeof(FFTComplex));
+	FFTComplex *Hz = (FFTComplex*)malloc(npt2 * sizeof(FFTComplex));
 	for (i = 0; i < npt; i++)
 	{
 		double rad = -dt * PI * (double)i / ((double)(npt - 1));
@@ -213,14 +213,14 @@ double* fir2(int *nn, double *ff, double *aa, int ffsz)
 	}
 	int nfft = npt2 - 2;
 	double *fo = (double*)malloc(sizeof(double) * npt2);
-	kiss_fftr_cfg plan = kiss_fftr_alloc(nfft, 1, 0, 0);
-	kiss_fftri(plan, Hz, fo);
+	FFTPlan *plan = FFTPlanReal(nfft, 1);
+	FFTRealInverse(plan, Hz, fo);
 	inc = (double)(*nn - 1);
 	double kfft = 1. / nfft;
 	double *retArray = (double*)malloc(*nn * sizeof(double));
 	for (i = 0; i < *nn; i++)
 		retArray[i] = (double)(0.54 - (0.46*cos(PI2*(double)i / (double)inc))) * fo[i] * kfft;
-	free(plan);
+	FFTPlanFree(plan);
 	free(Hz);
 	free(fo);
 	free(Hz2);
@@ -231,41 +231,6 @@ double* fir2(int *nn, double *ff, double *aa, int ffsz)
 /////////////////////////////////////////////////////////////////////////////
 // Log grid interpolated arbitrary response FIR filter design
 /////////////////////////////////////////////////////////////////////////////
-void minimumPhaseSpectrum(kiss_fft_cpx* timeData, kiss_fft_cpx* freqData, kiss_fft_cfg planForward, kiss_fft_cfg planReverse, unsigned int filterLength)
-{
-	unsigned int i, fLMul2 = filterLength << 1;
-	double threshold = pow(10.0, -100.0 / 20.0);
-	double logThreshold = log(threshold);
-	for (i = 0; i < fLMul2; i++)
-	{
-		if (freqData[i].r < threshold)
-			freqData[i].r = logThreshold;
-		else
-			freqData[i].r = log(freqData[i].r);
-		freqData[i].i = 0;
-	}
-	kiss_fft(planReverse, freqData, timeData);
-	for (i = 0; i < fLMul2; i++)
-	{
-		timeData[i].r /= fLMul2;
-		timeData[i].i /= fLMul2;
-	}
-	for (i = 1; i < filterLength; i++)
-	{
-		timeData[i].r += timeData[fLMul2 - i].r;
-		timeData[i].i -= timeData[fLMul2 - i].i;
-		timeData[fLMul2 - i].r = 0;
-		timeData[fLMul2 - i].i = 0;
-	}
-	timeData[filterLength].i *= -1.0;
-	kiss_fft(planForward, timeData, freqData);
-	for (i = 0; i < fLMul2; i++)
-	{
-		double eR = exp(freqData[i].r);
-		freqData[i].r = eR * cos(freqData[i].i);
-		freqData[i].i = eR * sin(freqData[i].i);
-	}
-}
 double gainAtLogGrid(ArbitraryEq *gains, double freq)
 {
 	double dbGain = 0.0, logLeft, logRightMinusLeft;
@@ -305,77 +270,163 @@ double gainAtLogGrid(ArbitraryEq *gains, double freq)
 	}
 	return dbGain;
 }
-double *ArbitraryEqMinimumPhase(ArbitraryEq *gains, double fs)
+static void ArbitraryEqBinLogFreq(ArbitraryEq *gains, double fs)
 {
-	unsigned int fLMul2 = gains->fLMul2;
-	unsigned int flMul2Minus1 = fLMul2 - 1;
-	kiss_fft_cpx* timeData = gains->timeData;
-	kiss_fft_cpx* freqData = gains->freqData;
-	kiss_fft_cfg planForward = gains->planForward;
-	kiss_fft_cfg planReverse = gains->planReverse;
-	// Log grid interpolation
+	// Same abscissa as gainAtLogGrid, log frequency with frequencies below 2 Hz taken as is
+	const v2d two = { 2.0, 2.0 };
+	v2d freq;
 	unsigned int i;
-	for (i = 0; i < gains->filterLength; i++)
+	if (gains->binFs == fs)
+		return;
+	for (i = 0; i < gains->filterLength; i += 2)
 	{
-		double freq = (double)i * fs / (double)fLMul2;
-		double dbGain = gainAtLogGrid(gains, freq);
-		double gain = pow(10.0, dbGain / 20.0);
-		freqData[i].r = gain;
-		freqData[i].i = 0;
-		freqData[flMul2Minus1 - i].r = gain;
-		freqData[flMul2Minus1 - i].i = 0;
+		freq = (v2d){ (double)i * fs / (double)gains->fLMul2, (double)(i + 1) * fs / (double)gains->fLMul2 };
+		freq = v2dSelect(freq < two, freq, v2dLog(v2dSelect(freq < two, two, freq)));
+		gains->binLogFreq[i] = freq[0];
+		if (i + 1 < gains->filterLength)
+			gains->binLogFreq[i + 1] = freq[1];
 	}
-	minimumPhaseSpectrum(timeData, freqData, planForward, planReverse, gains->filterLength);
-	kiss_fft(planReverse, freqData, timeData);
-	double factor, *finalImpulse = gains->impulseResponse;
-	for (i = 0; i < gains->filterLength; i++)
+	gains->binFs = fs;
+}
+static void ArbitraryEqGainGrid(ArbitraryEq *gains, double fs)
+{
+	// Linear gain of every bin written to both halves of freqData, same curve as gainAtLogGrid per bin.
+	// Bins rise monotonically, so the nodes are walked once and each span between two nodes is a straight line in binLogFreq
+	unsigned int i = 0, end, pos, filterLength = gains->filterLength;
+	double *dB = (double*)gains->timeData, freq, logLeft, slope, g0;
+	const v2d dBToLn = { 0.11512925464970228420, 0.11512925464970228420 };
+	ArbitraryEqBinLogFreq(gains, fs);
+	if (gains->nodesCount < 2)
+	{
+		g0 = gains->nodesCount ? gains->nodes[0]->gain : 0.0;
+		for (; i < filterLength; i++)
+			dB[i] = g0;
+	}
+	else
 	{
-		factor = 0.5 * (1.0 + cos(PI2 * (double)i / (double)fLMul2));
-		finalImpulse[i] = factor / (double)fLMul2 * timeData[i].r;
+		for (pos = 0; pos <= gains->nodesCount; pos++)
+		{
+			// Bins up to and including this node, the last span takes the rest
+			if (pos < gains->nodesCount)
+			{
+				freq = gains->nodes[pos]->freq;
+				end = freq > 0.0 ? (unsigned int)fmin(freq * (double)gains->fLMul2 / fs, (double)filterLength) : 0;
+				while (end > 0 && (double)(end - 1) * fs / (double)gains->fLMul2 > freq)
+					end--;
+				while (end < filterLength && (double)end * fs / (double)gains->fLMul2 <= freq)
+					end++;
+			}
+			else
+				end = filterLength;
+			if (!pos || pos == gains->nodesCount)
+			{
+				g0 = gains->nodes[pos ? pos - 1 : 0]->gain;
+				for (; i < end; i++)
+					dB[i] = g0;
+				continue;
+			}
+			logLeft = gains->nodes[pos - 1]->freq < 2.0 ? gains->nodes[pos - 1]->freq : log(gains->nodes[pos - 1]->freq);
+			slope = (gains->nodes[pos]->freq < 2.0 ? gains->nodes[pos]->freq : log(gains->nodes[pos]->freq)) - logLeft;
+			g0 = gains->nodes[pos - 1]->gain;
+			slope = (gains->nodes[pos]->gain - g0) / slope;
+			for (; i < end; i++)
+				dB[i] = g0 + (gains->binLogFreq[i] - logLeft) * slope;
+		}
 	}
+	for (i = 0; i + 1 < filterLength; i += 2)
+		v2dStore(dB + i, v2dExp(v2dLoad(dB + i) * dBToLn));
+	if (i < filterLength)
+		dB[i] = exp(dB[i] * dBToLn[0]);
+	// The full spectrum used to mirror bin i to fLMul2 - 1 - i, half a bin off even symmetry. Its real transform is that of
+	// neighbouring bins averaged, which is kept so both transforms below stay real
+	gains->freqData[0].r = dB[0];
+	for (i = 1; i < filterLength; i++)
+		gains->freqData[i].r = 0.5 * (dB[i] + dB[i - 1]);
+	gains->freqData[filterLength].r = dB[filterLength - 1];
+	for (i = 0; i <= filterLength; i++)
+		gains->freqData[i].i = 0;
+}
+static void minimumPhaseSpectrum(ArbitraryEq *gains)
+{
+	// Real cepstrum of the log magnitude, folded onto positive quefrencies and exponentiated back
+	unsigned int i, filterLength = gains->filterLength;
+	FFTComplex* freqData = gains->freqData;
+	double *cepstrum = (double*)gains->timeData, scale = 1.0 / (double)gains->fLMul2;
+	const v2d threshold = { 1e-5, 1e-5 }, logThreshold = { -11.512925464970229, -11.512925464970229 }, one = { 1.0, 1.0 };
+	v2d mag, sn, cs;
+	for (i = 0; i <= filterLength; i += 2)
+	{
+		mag = (v2d){ freqData[i].r, i < filterLength ? freqData[i + 1].r : 1.0 };
+		mag = v2dSelect(mag < threshold, logThreshold, v2dLog(v2dSelect(mag < threshold, one, mag)));
+		freqData[i].r = mag[0];
+		if (i < filterLength)
+			freqData[i + 1].r = mag[1];
+	}
+	FFTRealInverse(gains->planReverse, freqData, cepstrum);
+	cepstrum[0] *= scale;
+	for (i = 1; i < filterLength; i++)
+		cepstrum[i] *= 2.0 * scale;
+	cepstrum[filterLength] *= scale;
+	memset(cepstrum + filterLength + 1, 0, (filterLength - 1) * sizeof(double));
+	FFTRealForward(gains->planForward, cepstrum, freqData);
+	for (i = 0; i <= filterLength; i += 2)
+	{
+		if (i == filterLength)
+			freqData[i + 1] = freqData[i];
+		mag = v2dExp((v2d){ freqData[i].r, freqData[i + 1].r });
+		v2dSinCos((v2d){ freqData[i].i, freqData[i + 1].i }, &sn, &cs);
+		cs *= mag;
+		sn *= mag;
+		freqData[i].r = cs[0];
+		freqData[i].i = sn[0];
+		if (i < filterLength)
+		{
+			freqData[i + 1].r = cs[1];
+			freqData[i + 1].i = sn[1];
+		}
+	}
+}
+double *ArbitraryEqMinimumPhase(ArbitraryEq *gains, double fs)
+{
+	double *timeData = (double*)gains->timeData, *finalImpulse = gains->impulseResponse;
+	// Log grid interpolation
+	unsigned int i;
+	ArbitraryEqGainGrid(gains, fs);
+	minimumPhaseSpectrum(gains);
+	FFTRealInverse(gains->planReverse, gains->freqData, timeData);
+	for (i = 0; i < gains->filterLength; i++)
+		finalImpulse[i] = gains->window[i] * timeData[i];
 	return finalImpulse;
 }
 double *ArbitraryEqLinearPhase(ArbitraryEq *gains, double fs)
 {
-	unsigned int fLMul2 = gains->fLMul2;
-	unsigned int flMul2Minus1 = fLMul2 - 1;
-	kiss_fft_cpx* timeData = gains->timeData;
-	kiss_fft_cpx* freqData = gains->freqData;
-	kiss_fft_cfg planReverse = gains->planReverse;
+	unsigned int flMul2Minus1 = gains->filterLength - 1;
+	double *timeData = (double*)gains->timeData, *finalImpulse = gains->impulseResponse;
 	// Log grid interpolation
 	unsigned int i;
+	ArbitraryEqGainGrid(gains, fs);
+	FFTRealInverse(gains->planReverse, gains->freqData, timeData);
 	for (i = 0; i < gains->filterLength; i++)
-	{
-		double freq = (double)i * fs / (double)fLMul2;
-		double dbGain = gainAtLogGrid(gains, freq);
-		double gain = pow(10.0, dbGain / 20.0);
-		freqData[i].r = gain;
-		freqData[i].i = 0;
-		freqData[flMul2Minus1 - i].r = gain;
-		freqData[flMul2Minus1 - i].i = 0;
-	}
-	kiss_fft(planReverse, freqData, timeData);
-	double *finalImpulse = gains->impulseResponse;
-	flMul2Minus1 = gains->filterLength - 1;
-	for (i = 0; i < gains->filterLength; i++)
-	{
-		double timeIntermediate = timeData[i].r * 0.5 * ((1.0 + cos(PI2 * (double)i / (double)fLMul2)) / (double)fLMul2);
-		finalImpulse[flMul2Minus1 - i] = finalImpulse[flMul2Minus1 + i] = timeIntermediate;
-	}
+		finalImpulse[flMul2Minus1 - i] = finalImpulse[flMul2Minus1 + i] = timeData[i] * gains->window[i];
 	return finalImpulse;
 }
 void InitArbitraryEq(ArbitraryEq* eqgain, int *filterLength, int isLinearPhase)
 {
 	eqgain->fLMul2 = *filterLength << 1;
-	eqgain->timeData = (kiss_fft_cpx*)malloc(eqgain->fLMul2 * sizeof(kiss_fft_cpx));
-	eqgain->freqData = (kiss_fft_cpx*)malloc(eqgain->fLMul2 * sizeof(kiss_fft_cpx));
+	eqgain->timeData = (FFTComplex*)malloc(eqgain->fLMul2 * sizeof(FFTComplex));
+	eqgain->freqData = (FFTComplex*)malloc(eqgain->fLMul2 * sizeof(FFTComplex));
 	eqgain->filterLength = *filterLength;
 	eqgain->isLinearPhase = isLinearPhase;
 	eqgain->nodes = 0;
 	eqgain->nodesCount = 0;
+	eqgain->window = (double*)malloc(*filterLength * sizeof(double));
+	for (int i = 0; i < *filterLength; i++)
+		eqgain->window[i] = 0.5 * (1.0 + cos(PI2 * (double)i / (double)eqgain->fLMul2)) / (double)eqgain->fLMul2;
+	eqgain->binLogFreq = (double*)malloc(*filterLength * sizeof(double));
+	eqgain->binFs = 0.0;
 	if (!isLinearPhase)
 	{
-		eqgain->planForward = kiss_fft_alloc(eqgain->fLMul2, 0, 0, 0);
+		eqgain->planForward = FFTPlanReal(eqgain->fLMul2, 0);
 		eqgain->impulseResponse = (double*)malloc(*filterLength * sizeof(double));
 		eqgain->GetFilter = &ArbitraryEqMinimumPhase;
 	}
@@ -385,7 +436,7 @@ void InitArbitraryEq(ArbitraryEq* eqgain, int *filterLength, int isLinearPhase)
 		eqgain->GetFilter = &ArbitraryEqLinearPhase;
 		*filterLength = eqgain->fLMul2 - 1;
 	}
-	eqgain->planReverse = kiss_fft_alloc(eqgain->fLMul2, 1, 0, 0);
+	eqgain->planReverse = FFTPlanReal(eqgain->fLMul2, 1);
 }
 void EqNodesFree(ArbitraryEq *eqgain)
 {
@@ -399,37 +450,27 @@ void ArbitraryEqFree(ArbitraryEq *eqgain)
 {
 	EqNodesFree(eqgain);
 	if (!eqgain->isLinearPhase)
-		free(eqgain->planForward);
+		FFTPlanFree(eqgain->planForward);
 	free(eqgain->timeData);
 	free(eqgain->freqData);
-	free(eqgain->planReverse);
+	FFTPlanFree(eqgain->planReverse);
 	free(eqgain->impulseResponse);
+	free(eqgain->window);
+	free(eqgain->binLogFreq);
+}
+int cmpfuncNodes(const void *a, const void *b)
+{
+	double fa = (*(EqNode**)a)->freq, fb = (*(EqNode**)b)->freq;
+	if (fa < fb)
+		return -1;
+	if (fa > fb)
+		return 1;
+	return 0;
 }
 void NodesSorter(ArbitraryEq *eqgain)
 {
-	unsigned int i, numOfNodes = eqgain->nodesCount;
-	double *freqArray = (double*)malloc(numOfNodes * sizeof(double));
-	for (i = 0; i < numOfNodes; i++)
-		freqArray[i] = eqgain->nodes[i]->freq;
-	qsort(freqArray, numOfNodes, sizeof(double), cmpfuncD);
-	for (unsigned int j = 0; j < numOfNodes; j++)
-	{
-		for (i = 0; i < numOfNodes; i++)
-		{
-			if (freqArray[j] == eqgain->nodes[i]->freq)
-			{
-				double tmpFreq1 = eqgain->nodes[j]->freq;
-				double tmpGain1 = eqgain->nodes[j]->gain;
-				double tmpFreq2 = eqgain->nodes[i]->freq;
-				double tmpGain2 = eqgain->nodes[i]->gain;
-				eqgain->nodes[i]->freq = tmpFreq1;
-				eqgain->nodes[i]->gain = tmpGain1;
-				eqgain->nodes[j]->freq = tmpFreq2;
-				eqgain->nodes[j]->gain = tmpGain2;
-			}
-		}
-	}
-	free(freqArray);
+	// Node lists from measurements run to hundreds of points
+	qsort(eqgain->nodes, eqgain->nodesCount, sizeof(EqNode*), cmpfuncNodes);
 }
 int ArbitraryEqInsertNode(ArbitraryEq *eqgain, double freq, double gain, int sortNodes)
 {
@@ -462,6 +503,49 @@ int ArbitraryEqInsertNode(ArbitraryEq *eqgain, double freq, double gain, int sor
 	}
 	return 1;
 }
+int ArbitraryEqSetNodes(ArbitraryEq *eqgain, const double *freq, const double *gain, unsigned int count)
+{
+	unsigned int i;
+	if (!eqgain)
+		return -1;
+	if (count != eqgain->nodesCount)
+	{
+		EqNodesFree(eqgain);
+		if (!count)
+			return 1;
+		eqgain->nodes = (EqNode**)malloc(count * sizeof(EqNode*));
+		if (!eqgain->nodes)
+			return -1;
+		for (i = 0; i < count; i++)
+		{
+			eqgain->nodes[i] = (EqNode*)malloc(sizeof(EqNode));
+			if (!eqgain->nodes[i])
+			{
+				eqgain->nodesCount = i;
+				EqNodesFree(eqgain);
+				return -1;
+			}
+		}
+		eqgain->nodesCount = count;
+	}
+	for (i = 0; i < count; i++)
+	{
+		eqgain->nodes[i]->freq = freq[i];
+		eqgain->nodes[i]->gain = gain[i];
+	}
+	NodesSorter(eqgain);
+	return 1;
+}
+int ArbitraryEqAutoFilterLength(double lowestFreq, double fs)
+{
+	// Four bins below the lowest node resolve its slope, a length of 8192 at 48 kHz for the 25 Hz band
+	int length = ARBEQ_MIN_LENGTH;
+	if (lowestFreq <= 0.0)
+		return ARBEQ_MAX_LENGTH;
+	while (length < ARBEQ_MAX_LENGTH && length < 4.0 * fs / lowestFreq)
+		length <<= 1;
+	return length;
+}
 unsigned int ArbitraryEqFindNode(ArbitraryEq *eqgain, double freq)
 {
 	if (!eqgain)
@@ -1,6 +1,6 @@
 #ifndef ARBFIRGEN_H
 #define ARBFIRGEN_H
-#include "kissfft/kiss_fft.h"
+#include "FFTBackend.h"
 double* fir2(int *nn, double *ff, double *aa, int ffsz);
 typedef struct str_EqNodes
 {
@@ -14,16 +14,28 @@ typedef struct str_ArbitraryEq
 	unsigned int isLinearPhase;
 	unsigned int filterLength;
 	unsigned int fLMul2;
-	kiss_fft_cpx* timeData;
-	kiss_fft_cpx* freqData;
-	kiss_fft_cfg planForward;
-	kiss_fft_cfg planReverse;
+	FFTComplex* timeData;
+	FFTComplex* freqData;
+	FFTPlan* planForward;
+	FFTPlan* planReverse;
 	double *impulseResponse;
+	double *window;		// Hann half window divided by the transform length
+	double *binLogFreq;	// Interpolation abscissa of each bin at binFs
+	double binFs;
 	double* (*GetFilter)(struct str_ArbitraryEq*, double);
 } ArbitraryEq;
 void InitArbitraryEq(ArbitraryEq* eqgain, int *filterLength, int isLinearPhase);
 void ArbitraryEqFree(ArbitraryEq *eqgain);
+void EqNodesFree(ArbitraryEq *eqgain);
 int ArbitraryEqInsertNode(ArbitraryEq *eqgain, double freq, double gain, int sortNodes);
+// Replaces all nodes at once, storage is reused when the count stays the same
+int ArbitraryEqSetNodes(ArbitraryEq *eqgain, const double *freq, const double *gain, unsigned int count);
+// Interpolated dB gain, linear in log frequency between nodes and flat outside them
+double gainAtLogGrid(ArbitraryEq *gains, double freq);
+#define ARBEQ_MIN_LENGTH 1024
+#define ARBEQ_MAX_LENGTH 32768
+// Power of two filter length resolving lowestFreq at fs
+int ArbitraryEqAutoFilterLength(double lowestFreq, double fs);
 unsigned int ArbitraryEqFindNode(ArbitraryEq *eqgain, double freq);
 int ArbitraryEqRemoveNode(ArbitraryEq *eqgain, double freq, int sortNodes);
 void ArbitraryEqString2SortedNodes(ArbitraryEq *eqgain, char *frArbitraryEqString);
@@ -3,8 +3,12 @@
 #include <stdarg.h>
 #include <string.h>
 #include <math.h>
-#include "kissfft/kiss_fftr.h"
+#include "FFTBackend.h"
 #include "AutoConvolver.h"
+#include "VectorMath.h"
+#define CONV_THREAD_DISPATCH_COST 4e-5 // pthread_create + pthread_join round trip in seconds
+#define CONV_DIRECT_TAP_COST 1.0 // Flops per direct form tap and output sample, a multiply-add over two vector lanes
+#define CONV_BATCH_MAX 4 // Convolvers stepped in lockstep by AutoConvolver1x1ProcessBatch, true stereo needs four
 typedef struct str_dffirfilter
 {
 	unsigned int pos, coeffslength;
@@ -18,21 +22,28 @@ typedef struct str_HConv1Stage
 	int framelength;		// number of samples per audio frame
 	int *steptask;			// processing tasks per step
 	double *dft_time;		// DFT buffer (time domain)
-	kiss_fft_cpx *dft_freq;	// DFT buffer (frequency domain)
+	FFTComplex *dft_freq;	// DFT buffer (frequency domain)
 	double *in_freq_real;		// input buffer (frequency domain)
 	double *in_freq_imag;		// input buffer (frequency domain)
 	int num_filterbuf;		// number of filter segments
 	double **filterbuf_freq_realChannel1;	// filter segments (frequency domain)
 	double **filterbuf_freq_imagChannel1;	// filter segments (frequency domain)
+	float **filterbufSingle_real;	// filter segments in single precision (frequency domain)
+	float **filterbufSingle_imag;	// filter segments in single precision (frequency domain)
+	int singlePrecision;	// filter segments are kept in the float arrays above
 	int num_mixbuf;			// number of mixing segments
 	double **mixbuf_freq_real;	// mixing segments (frequency domain)
 	double **mixbuf_freq_imag;	// mixing segments (frequency domain)
 	double *history_time;		// history buffer (time domain)
 	double normalizationGain;
 	double gain;
-	kiss_fftr_cfg fft;			// FFT transformation plan
-	kiss_fftr_cfg ifft;		// IFFT transformation plan
+	FFTPlan *fft;			// FFT transformation plan
+	FFTPlan *ifft;		// IFFT transformation plan
 	int memSize;
+	int sharedSpectra;		// filter segments point into memory owned by the caller
+	double *fade_real;		// first segment before the last update minus after it (frequency domain)
+	double *fade_imag;		// first segment before the last update minus after it (frequency domain)
+	int fadePending;		// next frame fades from the old first segment to the new one
 } HConv1Stage1x1;
 typedef struct str_HConv2Stage
 {
@@ -56,6 +67,16 @@ typedef struct str_HConv3Stage
 	HConv2Stage1x1 *f_medium;	// convolution filter (long segments)
 	HConv1Stage1x1 *f_short;	// convolution filter (short segments)
 } HConv3Stage1x1;
+typedef struct str_HConvHybrid
+{
+	int headLen;		// taps run in direct form, also the frame length of the tail
+	int paddedLen;		// headLen rounded up to the vector width
+	double *headCoeffs;	// head taps in reverse order, zero padded at the front
+	double *history;	// paddedLen - 1 past inputs followed by up to headLen new ones
+	HConv1Stage1x1 *tail;	// remaining taps, absent when the head covers the whole filter
+	double *headCoeffsOld;	// head taps before the last update
+	int fadePos;		// samples into the head crossfade, headLen when there is none
+} HConvHybrid1x1;
 void DFFIRInit(DFFIR *fir, double *h, int hlen)
 {
 	int i, size;
@@ -90,19 +111,23 @@ double DFFIRProcess(DFFIR *fir, double x)
 		fir->pos = 0;
 	return y;
 }
-inline void hcPut1Stage(HConv1Stage1x1 *filter, double *x)
+// Batched stages must share frame length and step position
+static void hcPut1StageBatch(HConv1Stage1x1 **filter, double **x, int count)
 {
-	int j, flen, size;
-	flen = filter->framelength;
-	size = filter->memSize;
-	memcpy(filter->dft_time, x, size);
-	memset(&(filter->dft_time[flen]), 0, size);
-	kiss_fftr(filter->fft, filter->dft_time, filter->dft_freq);
-	for (j = 0; j < flen + 1; j++)
+	FFTPlan *plans[CONV_BATCH_MAX];
+	double *re[CONV_BATCH_MAX], *im[CONV_BATCH_MAX];
+	for (int c = 0; c < count; c++)
 	{
-		filter->in_freq_real[j] = filter->dft_freq[j].r;
-		filter->in_freq_imag[j] = filter->dft_freq[j].i;
+		plans[c] = filter[c]->fft;
+		re[c] = filter[c]->in_freq_real;
+		im[c] = filter[c]->in_freq_imag;
 	}
+	// The zero padded second half of the frame is implied by the length
+	FFTRealForwardBatch(plans, count, (const double *const*)x, filter[0]->framelength, re, im);
+}
+static inline void hcPut1Stage(HConv1Stage1x1 *filter, double *x)
+{
+	hcPut1StageBatch(&filter, &x, 1);
 }
 void hcProcess1Stage(HConv1Stage1x1 *filter)
 {
@@ -111,6 +136,8 @@ void hcProcess1Stage(HConv1Stage1x1 *filter)
 	double *x_imag;
 	double *h_real;
 	double *h_imag;
+	float *hs_real;
+	float *hs_imag;
 	double *y_real;
 	double *y_imag;
 	flen = filter->framelength;
@@ -123,6 +150,18 @@ void hcProcess1Stage(HConv1Stage1x1 *filter)
 		n = (s + filter->mixpos) % filter->num_mixbuf;
 		y_real = filter->mixbuf_freq_real[n];
 		y_imag = filter->mixbuf_freq_imag[n];
+		if (filter->singlePrecision)
+		{
+			// Products and accumulation stay in double, only the stored spectrum is rounded
+			hs_real = filter->filterbufSingle_real[s];
+			hs_imag = filter->filterbufSingle_imag[s];
+			for (n = 0; n < flen + 1; n++)
+			{
+				y_real[n] += (x_real[n] * hs_real[n] - x_imag[n] * hs_imag[n]);
+				y_imag[n] += (x_real[n] * hs_imag[n] + x_imag[n] * hs_real[n]);
+			}
+			continue;
+		}
 		h_real = filter->filterbuf_freq_realChannel1[s];
 		h_imag = filter->filterbuf_freq_imagChannel1[s];
 		for (n = 0; n < flen + 1; n++)
@@ -133,31 +172,79 @@ void hcProcess1Stage(HConv1Stage1x1 *filter)
 	}
 	filter->step = (filter->step + 1) % filter->maxstep;
 }
-inline void hcGet1Stage(HConv1Stage1x1 *filter, double *y)
+static void hcGet1StageBatch(HConv1Stage1x1 **filter, double **y, int count)
 {
-	int flen, mpos;
-	double *out;
-	double *hist;
-	int size, n, j;
-	flen = filter->framelength;
-	mpos = filter->mixpos;
-	out = filter->dft_time;
-	hist = filter->history_time;
-	for (j = 0; j < flen + 1; j++)
+	FFTPlan *plans[CONV_BATCH_MAX];
+	double *re[CONV_BATCH_MAX], *im[CONV_BATCH_MAX], *time[CONV_BATCH_MAX];
+	double *out, *hist;
+	int c, n, flen = filter[0]->framelength;
+	for (c = 0; c < count; c++)
 	{
-		filter->dft_freq[j].r = filter->mixbuf_freq_real[mpos][j];
-		filter->dft_freq[j].i = filter->mixbuf_freq_imag[mpos][j];
-		filter->mixbuf_freq_real[mpos][j] = 0.0f;
-		filter->mixbuf_freq_imag[mpos][j] = 0.0f;
+		plans[c] = filter[c]->ifft;
+		re[c] = filter[c]->mixbuf_freq_real[filter[c]->mixpos];
+		im[c] = filter[c]->mixbuf_freq_imag[filter[c]->mixpos];
+		time[c] = filter[c]->dft_time;
 	}
-	kiss_fftri(filter->ifft, filter->dft_freq, filter->dft_time);
+	// The mixing segment is cleared for reuse as the transform reads it
+	FFTRealInverseBatch(plans, count, re, im, 1, time);
+	for (c = 0; c < count; c++)
+	{
+		out = filter[c]->dft_time;
+		hist = filter[c]->history_time;
+		for (n = 0; n < flen; n++)
+			y[c][n] = (out[n] + hist[n]) * filter[c]->gain;
+		memcpy(hist, &(out[flen]), filter[c]->memSize);
+		filter[c]->mixpos = (filter[c]->mixpos + 1) % filter[c]->num_mixbuf;
+	}
+}
+static inline void hcGet1Stage(HConv1Stage1x1 *filter, double *y)
+{
+	hcGet1StageBatch(&filter, &y, 1);
+}
+// Called after hcGet1Stage on the first frame with updated segments. Only the first segment reaches this frame, so the
+// old filter's output is the new one plus the input frame convolved with the segment difference, which is faded out
+static void hcFade1Stage(HConv1Stage1x1 *filter, double *y)
+{
+	int n, flen = filter->framelength;
+	double *x_real = filter->in_freq_real, *x_imag = filter->in_freq_imag;
+	double *re = (double*)filter->dft_freq, *im = re + flen + 1;
+	for (n = 0; n < flen + 1; n++)
+	{
+		re[n] = x_real[n] * filter->fade_real[n] - x_imag[n] * filter->fade_imag[n];
+		im[n] = x_real[n] * filter->fade_imag[n] + x_imag[n] * filter->fade_real[n];
+	}
+	FFTRealInverseSplit(filter->ifft, re, im, 0, filter->dft_time);
 	for (n = 0; n < flen; n++)
-		y[n] = (out[n] + hist[n]) * filter->gain;
-	size = filter->memSize;
-	memcpy(hist, &(out[flen]), size);
-	filter->mixpos = (filter->mixpos + 1) % filter->num_mixbuf;
+		y[n] += filter->dft_time[n] * filter->gain * (0.5 + 0.5 * cos(M_PI * (double)(n + 1) / (double)flen));
+	filter->fadePending = 0;
+}
+static void hcGenerateSegments(HConv1Stage1x1 *filter, const double *h, int hlen)
+{
+	// Transform each flen slice of h into its filter segment, the last one zero padded
+	int i, j, len, flen = filter->framelength;
+	double *re, *im;
+	for (i = 0; i < filter->num_filterbuf; i++)
+	{
+		len = hlen - i * flen < flen ? hlen - i * flen : flen;
+		if (len < 0) // Updates may be shorter than the allocation, the remaining segments become silent
+			len = 0;
+		if (!filter->singlePrecision)
+		{
+			FFTRealForwardSplit(filter->fft, h + i * flen, len, filter->filterbuf_freq_realChannel1[i], filter->filterbuf_freq_imagChannel1[i]);
+			continue;
+		}
+		// dft_freq holds flen + 1 complex bins, room for the split real and imaginary halves
+		re = (double*)filter->dft_freq;
+		im = re + flen + 1;
+		FFTRealForwardSplit(filter->fft, h + i * flen, len, re, im);
+		for (j = 0; j < flen + 1; j++)
+		{
+			filter->filterbufSingle_real[i][j] = (float)re[j];
+			filter->filterbufSingle_imag[i][j] = (float)im[j];
+		}
+	}
 }
-void hcInit1Stage(HConv1Stage1x1 *filter, double *h, int hlen, int flen, int steps)
+void hcInit1Stage(HConv1Stage1x1 *filter, double *h, int hlen, int flen, int steps, int singlePrecision, const void **spectra)
 {
 	int i, j, size, num, pos;
 	// processing step counter
@@ -168,12 +255,15 @@ void hcInit1Stage(HConv1Stage1x1 *filter, double *h, int hlen, int flen, int ste
 	filter->mixpos = 0;
 	// number of samples per audio frame
 	filter->framelength = flen;
+	// crossfade state of filter updates
+	filter->fade_real = filter->fade_imag = 0;
+	filter->fadePending = 0;
 	// DFT buffer (time domain)
 	size = sizeof(double) * 2 * flen;
 	filter->dft_time = (double *)malloc(size);
 	// DFT buffer (frequency domain)
-	size = sizeof(kiss_fft_cpx) * (flen + 1);
-	filter->dft_freq = (kiss_fft_cpx*)malloc(size);
+	size = sizeof(FFTComplex) * (flen + 1);
+	filter->dft_freq = (FFTComplex*)malloc(size);
 	// input buffer (frequency domain)
 	size = sizeof(double) * (flen + 1);
 	filter->in_freq_real = (double*)malloc(size);
@@ -196,15 +286,51 @@ void hcInit1Stage(HConv1Stage1x1 *filter, double *h, int hlen, int flen, int ste
 		for (i = j; i <= steps; i++)
 			filter->steptask[i]++;
 	}
-	// filter segments (frequency domain)
-	size = sizeof(double*) * filter->num_filterbuf;
-	filter->filterbuf_freq_realChannel1 = (double**)malloc(size);
-	filter->filterbuf_freq_imagChannel1 = (double**)malloc(size);
-	size = sizeof(double) * (flen + 1);
+	// filter segments (frequency domain), each laid out as real then imaginary part when placed in caller memory
+	filter->singlePrecision = singlePrecision;
+	filter->sharedSpectra = spectra && *spectra;
+	filter->filterbuf_freq_realChannel1 = filter->filterbuf_freq_imagChannel1 = 0;
+	filter->filterbufSingle_real = filter->filterbufSingle_imag = 0;
+	if (singlePrecision)
+	{
+		size = sizeof(float*) * filter->num_filterbuf;
+		filter->filterbufSingle_real = (float**)malloc(size);
+		filter->filterbufSingle_imag = (float**)malloc(size);
+		size = sizeof(float) * (flen + 1);
+	}
+	else
+	{
+		size = sizeof(double*) * filter->num_filterbuf;
+		filter->filterbuf_freq_realChannel1 = (double**)malloc(size);
+		filter->filterbuf_freq_imagChannel1 = (double**)malloc(size);
+		size = sizeof(double) * (flen + 1);
+	}
 	for (i = 0; i < filter->num_filterbuf; i++)
 	{
-		filter->filterbuf_freq_realChannel1[i] = (double*)malloc(size);
-		filter->filterbuf_freq_imagChannel1[i] = (double*)malloc(size);
+		if (filter->sharedSpectra)
+		{
+			if (singlePrecision)
+			{
+				filter->filterbufSingle_real[i] = (float*)*spectra;
+				filter->filterbufSingle_imag[i] = (float*)*spectra + flen + 1;
+			}
+			else
+			{
+				filter->filterbuf_freq_realChannel1[i] = (double*)*spectra;
+				filter->filterbuf_freq_imagChannel1[i] = (double*)*spectra + flen + 1;
+			}
+			*spectra = (const char*)*spectra + 2 * size;
+		}
+		else if (singlePrecision)
+		{
+			filter->filterbufSingle_real[i] = (float*)malloc(size);
+			filter->filterbufSingle_imag[i] = (float*)malloc(size);
+		}
+		else
+		{
+			filter->filterbuf_freq_realChannel1[i] = (double*)malloc(size);
+			filter->filterbuf_freq_imagChannel1[i] = (double*)malloc(size);
+		}
 	}
 	// number of mixing segments
 	filter->num_mixbuf = filter->num_filterbuf + 1;
@@ -225,69 +351,69 @@ void hcInit1Stage(HConv1Stage1x1 *filter, double *h, int hlen, int flen, int ste
 	filter->history_time = (double *)malloc(size);
 	memset(filter->history_time, 0, size);
 	// FFT transformation plan
-	filter->fft = kiss_fftr_alloc(2 * flen, 0, 0, 0);
+	filter->fft = FFTPlanReal(2 * flen, 0);
 	// IFFT transformation plan
-	filter->ifft = kiss_fftr_alloc(2 * flen, 1, 0, 0);
+	filter->ifft = FFTPlanReal(2 * flen, 1);
 	// generate filter segments
 	filter->normalizationGain = 0.5 / (double)flen;
 	filter->gain = filter->normalizationGain;
-	size = sizeof(double) * 2 * flen;
-	memset(filter->dft_time, 0, size);
-	for (i = 0; i < filter->num_filterbuf - 1; i++)
+	filter->memSize = sizeof(double) * flen;
+	if (!h)
+		return;
+	hcGenerateSegments(filter, h, hlen);
+}
+static void hcProcess2StageBatch(HConv2Stage1x1 **filter, double **in, double **out, int count)
+{
+	int lpos, size, i, c, step = filter[0]->step;
+	HConv1Stage1x1 *f_short[CONV_BATCH_MAX], *f_long[CONV_BATCH_MAX];
+	double *in_long[CONV_BATCH_MAX], *out_long[CONV_BATCH_MAX];
+	for (c = 0; c < count; c++)
 	{
-		for (j = 0; j < flen; j++)
-			filter->dft_time[j] = h[i * flen + j];
-		kiss_fftr(filter->fft, filter->dft_time, filter->dft_freq);
-		for (j = 0; j < flen + 1; j++)
-		{
-			filter->filterbuf_freq_realChannel1[i][j] = filter->dft_freq[j].r;
-			filter->filterbuf_freq_imagChannel1[i][j] = filter->dft_freq[j].i;
-		}
+		f_short[c] = filter[c]->f_short;
+		f_long[c] = filter[c]->f_long;
+		in_long[c] = filter[c]->in_long;
+		out_long[c] = filter[c]->out_long;
 	}
-	for (j = 0; j < hlen - i * flen; j++)
-		filter->dft_time[j] = h[i * flen + j];
-	size = sizeof(double) * ((i + 1) * flen - hlen);
-	memset(&(filter->dft_time[hlen - i * flen]), 0, size);
-	kiss_fftr(filter->fft, filter->dft_time, filter->dft_freq);
-	for (j = 0; j < flen + 1; j++)
+	// convolution with short segments
+	hcPut1StageBatch(f_short, in, count);
+	for (c = 0; c < count; c++)
+		hcProcess1Stage(f_short[c]);
+	hcGet1StageBatch(f_short, out, count);
+	// add contribution from last long frame
+	lpos = step * filter[0]->flen_short;
+	for (c = 0; c < count; c++)
+		for (i = 0; i < filter[c]->flen_short; i++)
+			out[c][i] += out_long[c][lpos + i];
+	// convolution with long segments
+	if (step == 0)
+		hcPut1StageBatch(f_long, in_long, count);
+	for (c = 0; c < count; c++)
+		hcProcess1Stage(f_long[c]);
+	if (step == filter[0]->maxstep - 1)
+		hcGet1StageBatch(f_long, out_long, count);
+	for (c = 0; c < count; c++)
 	{
-		filter->filterbuf_freq_realChannel1[i][j] = filter->dft_freq[j].r;
-		filter->filterbuf_freq_imagChannel1[i][j] = filter->dft_freq[j].i;
+		// add current frame to long input buffer
+		size = sizeof(double) * filter[c]->flen_short;
+		memcpy(&(in_long[c][lpos]), in[c], size);
+		// increase step counter
+		filter[c]->step = (step + 1) % filter[c]->maxstep;
 	}
-	filter->memSize = sizeof(double) * flen;
 }
 void hcProcess2Stage(HConv2Stage1x1 *filter, double *in, double *out)
 {
-	int lpos, size, i;
-	// convolution with short segments
-	hcPut1Stage(filter->f_short, in);
-	hcProcess1Stage(filter->f_short);
-	hcGet1Stage(filter->f_short, out);
-	// add contribution from last long frame
-	lpos = filter->step * filter->flen_short;
-	for (i = 0; i < filter->flen_short; i++)
-		out[i] += filter->out_long[lpos + i];
-	// convolution with long segments
-	if (filter->step == 0)
-		hcPut1Stage(filter->f_long, filter->in_long);
-	hcProcess1Stage(filter->f_long);
-	if (filter->step == filter->maxstep - 1)
-		hcGet1Stage(filter->f_long, filter->out_long);
-	// add current frame to long input buffer
-	lpos = filter->step * filter->flen_short;
-	size = sizeof(double) * filter->flen_short;
-	memcpy(&(filter->in_long[lpos]), in, size);
-	// increase step counter
-	filter->step = (filter->step + 1) % filter->maxstep;
+	hcProcess2StageBatch(&filter, &in, &out, 1);
 }
-void hcInit2Stage(HConv2Stage1x1 *filter, double *h, int hlen, int sflen, int lflen)
+void hcInit2Stage(HConv2Stage1x1 *filter, double *h, int hlen, int sflen, int lflen, int singlePrecision, const void **spectra)
 {
 	int size;
 	double *h2 = NULL;
 	int h2len;
 	// sanity check: minimum impulse response length
 	h2len = 2 * lflen + 1;
-	if (hlen < h2len)
+	if (hlen < h2len && !h)
+		hlen = h2len;
+	else if (hlen < h2len)
 	{
 		size = sizeof(double) * h2len;
 		h2 = (double*)malloc(size);
@@ -316,43 +442,63 @@ void hcInit2Stage(HConv2Stage1x1 *filter, double *h, int hlen, int sflen, int lf
 	// convolution filter (short segments)
 	size = sizeof(HConv1Stage1x1);
 	filter->f_short = (HConv1Stage1x1 *)malloc(size);
-	hcInit1Stage(filter->f_short, h, 2 * lflen, sflen, 1);
+	hcInit1Stage(filter->f_short, h, 2 * lflen, sflen, 1, singlePrecision, spectra);
 	// convolution filter (long segments)
 	size = sizeof(HConv1Stage1x1);
 	filter->f_long = (HConv1Stage1x1 *)malloc(size);
-	hcInit1Stage(filter->f_long, &(h[2 * lflen]), hlen - 2 * lflen, lflen, lflen / sflen);
+	hcInit1Stage(filter->f_long, h ? &(h[2 * lflen]) : 0, hlen - 2 * lflen, lflen, lflen / sflen, singlePrecision, spectra);
 	if (h2 != NULL)
 		free(h2);
 }
-void hcProcess3Stage(HConv3Stage1x1 *filter, double *in, double *out)
+static void hcProcess3StageBatch(HConv3Stage1x1 **filter, double **in, double **out, int count)
 {
-	int lpos, size, i;
+	int lpos, size, i, c, step = filter[0]->step;
+	HConv1Stage1x1 *f_short[CONV_BATCH_MAX];
+	HConv2Stage1x1 *f_medium[CONV_BATCH_MAX];
+	double *in_medium[CONV_BATCH_MAX], *out_medium[CONV_BATCH_MAX];
+	for (c = 0; c < count; c++)
+	{
+		f_short[c] = filter[c]->f_short;
+		f_medium[c] = filter[c]->f_medium;
+		in_medium[c] = filter[c]->in_medium;
+		out_medium[c] = filter[c]->out_medium;
+	}
 	// convolution with short segments
-	hcPut1Stage(filter->f_short, in);
-	hcProcess1Stage(filter->f_short);
-	hcGet1Stage(filter->f_short, out);
-	// add contribution from last medium frame
-	lpos = filter->step * filter->flen_short;
-	for (i = 0; i < filter->flen_short; i++)
-		out[i] += filter->out_medium[lpos + i];
-	// add current frame to medium input buffer
-	lpos = filter->step * filter->flen_short;
-	size = sizeof(double) * filter->flen_short;
-	memcpy(&(filter->in_medium[lpos]), in, size);
+	hcPut1StageBatch(f_short, in, count);
+	for (c = 0; c < count; c++)
+		hcProcess1Stage(f_short[c]);
+	hcGet1StageBatch(f_short, out, count);
+	lpos = step * filter[0]->flen_short;
+	for (c = 0; c < count; c++)
+	{
+		// add contribution from last medium frame
+		for (i = 0; i < filter[c]->flen_short; i++)
+			out[c][i] += out_medium[c][lpos + i];
+		// add current frame to medium input buffer
+		size = sizeof(double) * filter[c]->flen_short;
+		memcpy(&(in_medium[c][lpos]), in[c], size);
+	}
 	// convolution with medium segments
-	if (filter->step == filter->maxstep - 1)
-		hcProcess2Stage(filter->f_medium, filter->in_medium, filter->out_medium);
+	if (step == filter[0]->maxstep - 1)
+		hcProcess2StageBatch(f_medium, in_medium, out_medium, count);
 	// increase step counter
-	filter->step = (filter->step + 1) % filter->maxstep;
+	for (c = 0; c < count; c++)
+		filter[c]->step = (step + 1) % filter[c]->maxstep;
 }
-void hcInit3Stage(HConv3Stage1x1 *filter, double *h, int hlen, int sflen, int mflen, int lflen)
+void hcProcess3Stage(HConv3Stage1x1 *filter, double *in, double *out)
+{
+	hcProcess3StageBatch(&filter, &in, &out, 1);
+}
+void hcInit3Stage(HConv3Stage1x1 *filter, double *h, int hlen, int sflen, int mflen, int lflen, int singlePrecision, const void **spectra)
 {
 	int size;
 	double *h2 = NULL;
 	int h2len;
 	// sanity check: minimum impulse response length
 	h2len = mflen + 2 * lflen + 1;
-	if (hlen < h2len)
+	if (hlen < h2len && !h)
+		hlen = h2len;
+	else if (hlen < h2len)
 	{
 		size = sizeof(double) * h2len;
 		h2 = (double*)malloc(size);
@@ -381,60 +527,80 @@ void hcInit3Stage(HConv3Stage1x1 *filter, double *h, int hlen, int sflen, int mf
 	// convolution filter (short segments)
 	size = sizeof(HConv1Stage1x1);
 	filter->f_short = (HConv1Stage1x1 *)malloc(size);
-	hcInit1Stage(filter->f_short, h, mflen, sflen, 1);
+	hcInit1Stage(filter->f_short, h, mflen, sflen, 1, singlePrecision, spectra);
 	// convolution filter (medium segments)
 	size = sizeof(HConv2Stage1x1);
 	filter->f_medium = (HConv2Stage1x1 *)malloc(size);
-	hcInit2Stage(filter->f_medium, &(h[mflen]), hlen - mflen, mflen, lflen);
+	hcInit2Stage(filter->f_medium, h ? &(h[mflen]) : 0, hlen - mflen, mflen, lflen, singlePrecision, spectra);
 	if (h2 != NULL)
 		free(h2);
 }
-void Convolver2StageProcessArbitrarySignalLength1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
+// Short frame buffering shared by the 2 and 3 stage schemes, all convolvers at the same buffer position
+static void ConvolverMultiStageProcessBatch(AutoConvolver1x1 **autoConv, double **inputs, double **outputs, int count, int sigLen)
 {
-	int m_lenShort = autoConv->hnShortLen;
-	double *m_inbuf = autoConv->inbuf;
-	double *m_outbuf = autoConv->outbuf;
-	HConv2Stage1x1 *m_filter = (HConv2Stage1x1*)autoConv->filter;
-	int pos = autoConv->bufpos;
+	int m_lenShort = autoConv[0]->hnShortLen;
+	int c, pos = autoConv[0]->bufpos;
+	double *m_inbuf[CONV_BATCH_MAX], *m_outbuf[CONV_BATCH_MAX];
+	for (c = 0; c < count; c++)
+	{
+		m_inbuf[c] = autoConv[c]->inbuf;
+		m_outbuf[c] = autoConv[c]->outbuf;
+	}
 	for (int s = 0; s < sigLen; s++)
 	{
-		m_inbuf[pos] = inputs[s];
-		outputs[s] = m_outbuf[pos];
+		for (c = 0; c < count; c++)
+		{
+			m_inbuf[c][pos] = inputs[c][s];
+			outputs[c][s] = m_outbuf[c][pos];
+		}
 		pos++;
 		if (pos == m_lenShort)
 		{
-			hcProcess2Stage(m_filter, m_inbuf, m_outbuf);
+			if (autoConv[0]->methods == 3)
+			{
+				HConv3Stage1x1 *m_filter[CONV_BATCH_MAX];
+				for (c = 0; c < count; c++)
+					m_filter[c] = (HConv3Stage1x1*)autoConv[c]->filter;
+				hcProcess3StageBatch(m_filter, m_inbuf, m_outbuf, count);
+			}
+			else
+			{
+				HConv2Stage1x1 *m_filter[CONV_BATCH_MAX];
+				for (c = 0; c < count; c++)
+					m_filter[c] = (HConv2Stage1x1*)autoConv[c]->filter;
+				hcProcess2StageBatch(m_filter, m_inbuf, m_outbuf, count);
+			}
 			pos = 0;
 		}
 	}
-	autoConv->bufpos = pos;
+	for (c = 0; c < count; c++)
+		autoConv[c]->bufpos = pos;
+}
+void Convolver2StageProcessArbitrarySignalLength1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
+{
+	ConvolverMultiStageProcessBatch(&autoConv, &inputs, &outputs, 1, sigLen);
 }
 void Convolver3StageProcessArbitrarySignalLength1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
 {
-	int m_lenShort = autoConv->hnShortLen;
-	double *m_inbuf = autoConv->inbuf;
-	double *m_outbuf = autoConv->outbuf;
-	HConv3Stage1x1 *m_filter = (HConv3Stage1x1*)autoConv->filter;
-	int pos = autoConv->bufpos;
-	for (int s = 0; s < sigLen; s++)
-	{
-		m_inbuf[pos] = inputs[s];
-		outputs[s] = m_outbuf[pos];
-		pos++;
-		if (pos == m_lenShort)
-		{
-			hcProcess3Stage(m_filter, m_inbuf, m_outbuf);
-			pos = 0;
-		}
-	}
-	autoConv->bufpos = pos;
+	ConvolverMultiStageProcessBatch(&autoConv, &inputs, &outputs, 1, sigLen);
+}
+static void Convolver1StageProcessBatch(AutoConvolver1x1 **autoConv, double **inputs, double **outputs, int count)
+{
+	HConv1Stage1x1 *m_filter[CONV_BATCH_MAX];
+	int c;
+	for (c = 0; c < count; c++)
+		m_filter[c] = (HConv1Stage1x1*)autoConv[c]->filter;
+	hcPut1StageBatch(m_filter, inputs, count);
+	for (c = 0; c < count; c++)
+		hcProcess1Stage(m_filter[c]);
+	hcGet1StageBatch(m_filter, outputs, count);
+	for (c = 0; c < count; c++)
+		if (m_filter[c]->fadePending)
+			hcFade1Stage(m_filter[c], outputs[c]);
 }
 void Convolver1StageLowLatencyProcess1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int unused)
 {
-	HConv1Stage1x1 *m_filter = (HConv1Stage1x1*)autoConv->filter;
-	hcPut1Stage(m_filter, inputs);
-	hcProcess1Stage(m_filter);
-	hcGet1Stage(m_filter, outputs);
+	Convolver1StageProcessBatch(&autoConv, &inputs, &outputs, 1);
 }
 void Convolver1DirectFormProcess1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
 {
@@ -442,122 +608,197 @@ void Convolver1DirectFormProcess1x1(AutoConvolver1x1 *autoConv, double* inputs,
 	for (int i = 0; i < sigLen; i++)
 		outputs[i] = DFFIRProcess(m_filter, inputs[i]);
 }
-int PartitionerAnalyser(int hlen, int latency, int strategy, int fs, int entriesResult, double **result_c0_c1, int *sflen_best, int *mflen_best, int *lflen_best)
+// Heads run per channel, the tails of all convolvers step together
+static void ConvolverHybridProcessBatch(AutoConvolver1x1 **autoConv, double **inputs, double **outputs, int count, int sigLen)
 {
-	if (hlen < 0)
-		return 0;
-	else if (hlen < 32)
-		return 999;
-	int s, m, l, begin_m, end_m, type_best, num_s, num_m, num_l, sflen, mflen, lflen;
-	double cpu_load, tau_s, tau_m, tau_l;
-	double *c0 = result_c0_c1[0];
-	double *c1 = result_c0_c1[1];
-	if (latency < 128)
-		latency = 128;
-	s = (int)log2(latency) - 6;
-	if (!strategy)
-	{
-		begin_m = 2;
-		end_m = 3;
+	HConvHybrid1x1 *m_filter;
+	HConv1Stage1x1 *tails[CONV_BATCH_MAX];
+	double *m_inbuf[CONV_BATCH_MAX], *m_outbuf[CONV_BATCH_MAX];
+	int c, i, chunk, done = 0;
+	int headLen = ((HConvHybrid1x1*)autoConv[0]->filter)->headLen, pos = autoConv[0]->bufpos;
+	double y, yOld;
+	for (c = 0; c < count; c++)
+	{
+		tails[c] = ((HConvHybrid1x1*)autoConv[c]->filter)->tail;
+		m_inbuf[c] = autoConv[c]->inbuf;
+		m_outbuf[c] = autoConv[c]->outbuf;
 	}
-	else
+	while (done < sigLen)
+	{
+		// Chunks never cross a tail frame boundary
+		chunk = headLen - pos;
+		if (chunk > sigLen - done)
+			chunk = sigLen - done;
+		for (c = 0; c < count; c++)
+		{
+			m_filter = (HConvHybrid1x1*)autoConv[c]->filter;
+			memcpy(m_filter->history + m_filter->paddedLen - 1, inputs[c] + done, chunk * sizeof(double));
+			for (i = 0; i < chunk; i++)
+			{
+				y = VecDotProduct(m_filter->headCoeffs, m_filter->history + i, m_filter->paddedLen);
+				if (m_filter->fadePos < headLen)
+				{
+					// Old taps on the same history, faded out over one frame
+					yOld = VecDotProduct(m_filter->headCoeffsOld, m_filter->history + i, m_filter->paddedLen);
+					y = yOld + (y - yOld) * (0.5 - 0.5 * cos(M_PI * (double)++m_filter->fadePos / (double)headLen));
+				}
+				if (tails[c])
+				{
+					// The tail starts headLen taps late, exactly the latency of its frame buffering
+					m_inbuf[c][pos + i] = inputs[c][done + i];
+					y += m_outbuf[c][pos + i];
+				}
+				outputs[c][done + i] = y;
+			}
+			memmove(m_filter->history, m_filter->history + chunk, (m_filter->paddedLen - 1) * sizeof(double));
+		}
+		done += chunk;
+		pos += chunk;
+		if (pos == headLen)
+		{
+			if (tails[0])
+			{
+				hcPut1StageBatch(tails, m_inbuf, count);
+				for (c = 0; c < count; c++)
+					hcProcess1Stage(tails[c]);
+				hcGet1StageBatch(tails, m_outbuf, count);
+				for (c = 0; c < count; c++)
+					if (tails[c]->fadePending)
+						hcFade1Stage(tails[c], m_outbuf[c]);
+			}
+			pos = 0;
+		}
+	}
+	for (c = 0; c < count; c++)
+		autoConv[c]->bufpos = pos;
+}
+void ConvolverHybridProcess1x1(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
+{
+	ConvolverHybridProcessBatch(&autoConv, &inputs, &outputs, 1, sigLen);
+}
+static double PartitionCost(double *c0, double *c1, int entries, int flen, int num)
+{
+	// Benchmark entries are measured for segment lengths of 256 << s, scale linearly in between
+	int s = (int)floor(log2((double)flen / 256.0) + 0.5);
+	if (s < 0)
+		s = 0;
+	if (s > entries - 1)
+		s = entries - 1;
+	return (c0[s] + c1[s] * num) * (double)flen / (double)(256 << s);
+}
+void AutoConvolver1x1Planner(ConvolverPlan *plan, int hlen, int audioBufferSize, int fs, int channels, int maxThreads, double **recommendation, int items)
+{
+	int m, l, w, num_s, num_m, num_l, sflen, mflen, lflen, maxflen, instances, perWorker;
+	double cost, cost_best, critical, critical_best, tau_s, tau_m, tau_l;
+	double *c0 = recommendation[0];
+	double *c1 = recommendation[1];
+	memset(plan, 0, sizeof(ConvolverPlan));
+	plan->threads = 1;
+	instances = channels > 2 ? 4 : 2;
+	if (hlen < 32)
 	{
-		begin_m = 1;
-		end_m = entriesResult - s - 1;
+		plan->methods = 999;
+		plan->sflen = audioBufferSize;
+		return;
+	}
+	// Short segments always match the block size, larger segments are limited to what has been benchmarked
+	sflen = audioBufferSize;
+	maxflen = 256 << (items - 1);
+	// performance prediction with 1 segment length
+	num_s = (hlen + sflen - 1) / sflen;
+	cost_best = PartitionCost(c0, c1, items, sflen, num_s) / (double)sflen;
+	plan->methods = 1;
+	plan->sflen = sflen;
+	// performance prediction with 2 segment lengths
+	for (m = 1; (sflen << m) <= maxflen; m++)
+	{
+		mflen = sflen << m;
+		num_s = 2 * mflen / sflen;
+		num_m = (int)ceil((hlen - num_s * sflen) / (double)mflen);
+		if (num_m < 1)
+			num_m = 1;
+		tau_s = PartitionCost(c0, c1, items, sflen, num_s);
+		tau_m = PartitionCost(c0, c1, items, mflen, num_m);
+		cost = tau_s / (double)sflen + tau_m / (double)mflen;
+		if (cost < cost_best)
+		{
+			cost_best = cost;
+			plan->methods = 2;
+			plan->mflen = mflen;
+			plan->lflen = 0;
+		}
 	}
-	sflen = latency;
-	double cpu_load_best = 1e12;
 	// performance prediction with 3 segment lengths
-	for (m = begin_m; m < end_m; m++)
+	for (m = 1; (sflen << (m + 1)) <= maxflen; m++)
 	{
-		for (l = 1; l + m + s < entriesResult; l++)
+		for (l = 1; (sflen << (m + l)) <= maxflen; l++)
 		{
 			mflen = sflen << m;
 			lflen = mflen << l;
 			num_s = mflen / sflen;
 			num_m = 2 * lflen / mflen;
-			num_l = (int)(ceil((hlen - num_s * sflen - num_m * mflen) / (double)lflen));
+			num_l = (int)ceil((hlen - num_s * sflen - num_m * mflen) / (double)lflen);
 			if (num_l < 1)
 				num_l = 1;
-			tau_s = c0[s] + c1[s] * num_s;
-			tau_m = c0[s + m] + c1[s + m] * num_m;
-			tau_l = c0[s + m + l] + c1[s + m + l] * num_l;
-			cpu_load = 400.0 * (tau_s * lflen / sflen + tau_m * lflen / mflen + tau_l) * fs / (double)lflen;
-			if (cpu_load < cpu_load_best)
+			tau_s = PartitionCost(c0, c1, items, sflen, num_s);
+			tau_m = PartitionCost(c0, c1, items, mflen, num_m);
+			tau_l = PartitionCost(c0, c1, items, lflen, num_l);
+			cost = tau_s / (double)sflen + tau_m / (double)mflen + tau_l / (double)lflen;
+			if (cost < cost_best)
 			{
-				cpu_load_best = cpu_load;
-				*sflen_best = sflen;
-				*mflen_best = mflen;
-				*lflen_best = lflen;
-				type_best = 3;
+				cost_best = cost;
+				plan->methods = 3;
+				plan->mflen = mflen;
+				plan->lflen = lflen;
 			}
 		}
 	}
-	// performance prediction with 2 segment lengths
-	begin_m = 1;
-	end_m = entriesResult - s;
-	for (m = begin_m; m < end_m; m++)
+	// Distribute the instances over worker threads, every extra worker costs a thread dispatch per block
+	critical_best = 1e12;
+	for (w = 1; w <= instances && w <= maxThreads; w <<= 1)
 	{
-		mflen = sflen << m;
-		num_s = 2 * mflen / sflen;
-		num_m = (int)(ceil((hlen - num_s * sflen) / (double)mflen));
-		if (num_m < 1)
-			num_m = 1;
-		tau_s = c0[s] + c1[s] * num_s;
-		tau_m = c0[s + m] + c1[s + m] * num_m;
-		cpu_load = 400.0 * (tau_s * mflen / sflen + tau_m) * fs / (double)mflen;
-		if (cpu_load < cpu_load_best)
+		perWorker = (instances + w - 1) / w;
+		critical = perWorker * cost_best + (w - 1) * CONV_THREAD_DISPATCH_COST / (double)audioBufferSize;
+		if (critical < critical_best)
 		{
-			cpu_load_best = cpu_load;
-			*sflen_best = sflen;
-			*mflen_best = mflen;
-			type_best = 2;
+			critical_best = critical;
+			plan->threads = w;
 		}
 	}
-	// performance prediction with 1 segment length
-	num_s = (int)(ceil(hlen / (double)sflen));
-	tau_s = c0[s] + c1[s] * num_s;
-	cpu_load = 400.0 * tau_s * fs / (double)sflen;
-	if (cpu_load < cpu_load_best)
-	{
-		cpu_load_best = cpu_load;
-		*sflen_best = hlen;
-		type_best = 1;
-	}
-	return type_best;
+	plan->cpuLoad = 100.0 * fs * (instances * cost_best + (plan->threads - 1) * CONV_THREAD_DISPATCH_COST / (double)audioBufferSize);
+	plan->criticalLoad = 100.0 * fs * critical_best;
 }
-AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int audioBufferSize, double gaindB, double **recommendation, int items)
+static AutoConvolver1x1* AutoConvolver1x1Build(double *impulseResponse, const void *spectra, int hlen, int audioBufferSize, double gaindB, ConvolverPlan *plan)
 {
-	int bestMethod = 1, sflen_best = 4096, mflen_best = 8192, lflen_best = 16384;
+	int bestMethod, sflen_best, mflen_best, lflen_best, singlePrecision;
+	const void *cursor;
 	if (!hlen)
 		return 0;
-	if (recommendation)
-		bestMethod = PartitionerAnalyser(hlen, 4096, 1, 48000, items, recommendation, &sflen_best, &mflen_best, &lflen_best);
-	if (hlen > 0 && hlen < 32)
-		bestMethod = 999;
-	else if (hlen > 20000 && hlen < 81921 && bestMethod < 2)
-	{
-		bestMethod = 2;
-		sflen_best = 2048;
-		mflen_best = 8192;
-	}
-	else if (hlen > 81920 && hlen < 245764 && bestMethod < 2)
-	{
-		bestMethod = 2;
-		sflen_best = 4096;
-		mflen_best = 8192;
-	}
-	else if (hlen > 245763 && hlen < 1000001 && bestMethod < 2)
-	{
-		bestMethod = 2;
-		sflen_best = 4096;
-		mflen_best = 16384;
-	}
-	else if (hlen > 1000000 && hlen < 2000001 && bestMethod < 2)
-		bestMethod = 3;
+	bestMethod = plan->methods;
+	sflen_best = plan->sflen;
+	mflen_best = plan->mflen;
+	lflen_best = plan->lflen;
+	singlePrecision = plan->singlePrecision;
 	double linGain = powf(10.0f, gaindB / 20.0f);
 	AutoConvolver1x1 *autoConv = (AutoConvolver1x1*)calloc(1, sizeof(AutoConvolver1x1));
 	autoConv->methods = bestMethod;
+	if (bestMethod != 999)
+	{
+		// All partitions of an instance live in one block, which is what gets exported, cached and shared
+		autoConv->spectraSize = AutoConvolver1x1SpectraSize(plan, hlen, audioBufferSize);
+		if (!spectra)
+		{
+			spectra = malloc(autoConv->spectraSize);
+			if (!spectra)
+			{
+				free(autoConv);
+				return 0;
+			}
+			autoConv->ownsSpectra = 1;
+		}
+		autoConv->spectra = spectra;
+	}
+	cursor = spectra;
 	if (bestMethod > 1)
 	{
 		autoConv->hnShortLen = sflen_best;
@@ -567,7 +808,7 @@ AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int au
 	if (bestMethod == 3)
 	{
 		HConv3Stage1x1* stage = (HConv3Stage1x1*)malloc(sizeof(HConv3Stage1x1));
-		hcInit3Stage(stage, impulseResponse, hlen, sflen_best, mflen_best, lflen_best);
+		hcInit3Stage(stage, impulseResponse, hlen, sflen_best, mflen_best, lflen_best, singlePrecision, &cursor);
 		stage->f_medium->f_long->gain = stage->f_medium->f_long->normalizationGain * linGain;
 		stage->f_medium->f_short->gain = stage->f_medium->f_short->normalizationGain * linGain;
 		stage->f_short->gain = stage->f_short->normalizationGain * linGain;
@@ -577,7 +818,7 @@ AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int au
 	else if (bestMethod == 2)
 	{
 		HConv2Stage1x1* stage = (HConv2Stage1x1*)malloc(sizeof(HConv2Stage1x1));
-		hcInit2Stage(stage, impulseResponse, hlen, sflen_best, mflen_best);
+		hcInit2Stage(stage, impulseResponse, hlen, sflen_best, mflen_best, singlePrecision, &cursor);
 		stage->f_long->gain = stage->f_long->normalizationGain * linGain;
 		stage->f_short->gain = stage->f_short->normalizationGain * linGain;
 		autoConv->filter = (void*)stage;
@@ -594,61 +835,302 @@ AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int au
 	else
 	{
 		HConv1Stage1x1* stage = (HConv1Stage1x1*)malloc(sizeof(HConv1Stage1x1));
-		hcInit1Stage(stage, impulseResponse, hlen, audioBufferSize, 1);
+		hcInit1Stage(stage, impulseResponse, hlen, audioBufferSize, 1, singlePrecision, &cursor);
 		stage->gain = stage->normalizationGain * linGain;
 		autoConv->filter = (void*)stage;
 		autoConv->process = &Convolver1StageLowLatencyProcess1x1;
 	}
 	return autoConv;
 }
+AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int audioBufferSize, double gaindB, ConvolverPlan *plan)
+{
+	return AutoConvolver1x1Build(impulseResponse, 0, hlen, audioBufferSize, gaindB, plan);
+}
+AutoConvolver1x1* InitAutoConvolver1x1Spectra(const void *spectra, int hlen, int audioBufferSize, double gaindB, ConvolverPlan *plan)
+{
+	// Direct form filters keep their taps in the time domain, they are never cached
+	if (plan->methods == 999 || !spectra)
+		return 0;
+	return AutoConvolver1x1Build(0, spectra, hlen, audioBufferSize, gaindB, plan);
+}
+static size_t hcSpectraLength(int hlen, int flen)
+{
+	return (size_t)((hlen + flen - 1) / flen) * 2 * (flen + 1);
+}
+size_t AutoConvolver1x1SpectraSize(ConvolverPlan *plan, int hlen, int audioBufferSize)
+{
+	int sflen = plan->sflen, mflen = plan->mflen, lflen = plan->lflen;
+	size_t length = 0;
+	if (plan->methods == 1)
+		length = hcSpectraLength(hlen, audioBufferSize);
+	else if (plan->methods == 2)
+	{
+		if (hlen < 2 * mflen + 1)
+			hlen = 2 * mflen + 1;
+		length = hcSpectraLength(2 * mflen, sflen) + hcSpectraLength(hlen - 2 * mflen, mflen);
+	}
+	else if (plan->methods == 3)
+	{
+		if (hlen < mflen + 2 * lflen + 1)
+			hlen = mflen + 2 * lflen + 1;
+		length = hcSpectraLength(mflen, sflen) + hcSpectraLength(2 * lflen, mflen) + hcSpectraLength(hlen - mflen - 2 * lflen, lflen);
+	}
+	return length * (plan->singlePrecision ? sizeof(float) : sizeof(double));
+}
+size_t AutoConvolver1x1ExportSpectra(AutoConvolver1x1 *autoConv, void *dst)
+{
+	if (!autoConv->spectra)
+		return 0;
+	memcpy(dst, autoConv->spectra, autoConv->spectraSize);
+	return autoConv->spectraSize;
+}
+static size_t hcMemory1Stage(HConv1Stage1x1 *filter)
+{
+	size_t flen = filter->framelength, bytes;
+	// FFT plans, DFT scratch, input spectrum, step table and history
+	bytes = FFTPlanMemory(filter->fft) + FFTPlanMemory(filter->ifft) + sizeof(double) * 2 * flen + sizeof(FFTComplex) * (flen + 1) + sizeof(double) * 2 * (flen + 1);
+	bytes += sizeof(int) * (filter->maxstep + 1) + sizeof(double) * flen;
+	// Mixing ring, one spectrum per filter segment plus one
+	bytes += filter->num_mixbuf * 2 * (sizeof(double*) + sizeof(double) * (flen + 1));
+	bytes += filter->num_filterbuf * 2 * sizeof(void*);
+	if (!filter->sharedSpectra)
+		bytes += filter->num_filterbuf * 2 * (flen + 1) * (filter->singlePrecision ? sizeof(float) : sizeof(double));
+	if (filter->fade_real)
+		bytes += sizeof(double) * 2 * (flen + 1);
+	return bytes;
+}
+size_t AutoConvolver1x1MemoryUsage(AutoConvolver1x1 *autoConv)
+{
+	size_t bytes = sizeof(AutoConvolver1x1) + sizeof(double) * autoConv->delayLength;
+	if (autoConv->ownsSpectra)
+		bytes += autoConv->spectraSize;
+	if (autoConv->methods > 1)
+		bytes += sizeof(double) * 2 * autoConv->hnShortLen;
+	if (autoConv->methods == 1)
+		bytes += sizeof(HConv1Stage1x1) + hcMemory1Stage((HConv1Stage1x1*)autoConv->filter);
+	else if (autoConv->methods == 2)
+	{
+		HConv2Stage1x1 *stage = (HConv2Stage1x1*)autoConv->filter;
+		bytes += sizeof(HConv2Stage1x1) + sizeof(double) * 2 * stage->flen_long;
+		bytes += 2 * sizeof(HConv1Stage1x1) + hcMemory1Stage(stage->f_short) + hcMemory1Stage(stage->f_long);
+	}
+	else if (autoConv->methods == 3)
+	{
+		HConv3Stage1x1 *stage = (HConv3Stage1x1*)autoConv->filter;
+		bytes += sizeof(HConv3Stage1x1) + sizeof(double) * 2 * stage->flen_medium + sizeof(HConv1Stage1x1) + hcMemory1Stage(stage->f_short);
+		bytes += sizeof(HConv2Stage1x1) + sizeof(double) * 2 * stage->f_medium->flen_long;
+		bytes += 2 * sizeof(HConv1Stage1x1) + hcMemory1Stage(stage->f_medium->f_short) + hcMemory1Stage(stage->f_medium->f_long);
+	}
+	else if (autoConv->methods == 4)
+	{
+		HConvHybrid1x1 *stage = (HConvHybrid1x1*)autoConv->filter;
+		bytes += sizeof(HConvHybrid1x1) + sizeof(double) * (3 * stage->paddedLen - 1 + stage->headLen);
+		if (stage->tail)
+			bytes += sizeof(HConv1Stage1x1) + hcMemory1Stage(stage->tail);
+	}
+	else if (autoConv->methods == 999)
+	{
+		DFFIR *stage = (DFFIR*)autoConv->filter;
+		bytes += sizeof(DFFIR) + sizeof(double) * 2 * stage->coeffslength;
+	}
+	return bytes;
+}
+static double ZeroLatencyCost(int hlen, int headLen, int flen)
+{
+	// Flops per output sample of headLen direct form taps followed by uniform FFT partitions of flen, real FFT taken as 2.5 N log2 N
+	int parts = (hlen - headLen + flen - 1) / flen;
+	double cost = headLen * CONV_DIRECT_TAP_COST;
+	if (parts > 0)
+		cost += (5.0 * flen * log2(2.0 * flen) * 2.0 + parts * 8.0 * (flen + 1) + 2.0 * flen) / flen;
+	return cost;
+}
+int AutoConvolver1x1ZeroLatencyPlanner(int hlen, int audioBufferSize)
+{
+	// Uniform partitions of the block size add no latency when called with whole blocks, the hybrid for any call size.
+	// Returns the direct form head length, 0 keeps the uniform FFT convolver
+	int headLen, best = 0;
+	double cost, costBest = ZeroLatencyCost(hlen, 0, audioBufferSize);
+	for (headLen = 16; headLen < hlen; headLen <<= 1)
+	{
+		cost = ZeroLatencyCost(hlen, headLen, headLen);
+		if (cost < costBest)
+		{
+			costBest = cost;
+			best = headLen;
+		}
+	}
+	if (ZeroLatencyCost(hlen, hlen, 1) < costBest)
+		best = hlen;
+	return best;
+}
+double AutoConvolver1x1ZeroLatencyCost(int hlen, int audioBufferSize)
+{
+	int headLen = AutoConvolver1x1ZeroLatencyPlanner(hlen, audioBufferSize);
+	if (!headLen)
+		return ZeroLatencyCost(hlen, 0, audioBufferSize);
+	return ZeroLatencyCost(hlen, headLen, headLen == hlen ? 1 : headLen);
+}
+static void hcAllocFade(HConv1Stage1x1 *filter)
+{
+	if (filter->fade_real)
+		return;
+	filter->fade_real = (double*)malloc(sizeof(double) * (filter->framelength + 1));
+	filter->fade_imag = (double*)malloc(sizeof(double) * (filter->framelength + 1));
+}
+static void hcStartHybridFade(HConvHybrid1x1 *filter)
+{
+	int i;
+	double w;
+	// Updates crossfade from the taps heard last, a fade that is still running restarts from its current mix
+	if (filter->fadePos >= filter->headLen)
+		memcpy(filter->headCoeffsOld, filter->headCoeffs, filter->paddedLen * sizeof(double));
+	else
+	{
+		w = 0.5 - 0.5 * cos(M_PI * (double)filter->fadePos / (double)filter->headLen);
+		for (i = 0; i < filter->paddedLen; i++)
+			filter->headCoeffsOld[i] += w * (filter->headCoeffs[i] - filter->headCoeffsOld[i]);
+	}
+	filter->fadePos = 0;
+}
+static void hcSetHybridHead(HConvHybrid1x1 *filter, double *h, int hlen)
+{
+	int i, n = filter->headLen < hlen ? filter->headLen : hlen;
+	hcStartHybridFade(filter);
+	memset(filter->headCoeffs, 0, filter->paddedLen * sizeof(double));
+	for (i = 0; i < n; i++)
+		filter->headCoeffs[filter->paddedLen - 1 - i] = h[i];
+}
+static void hcInitHybrid(HConvHybrid1x1 *filter, double *h, int hlen, int headLen)
+{
+	filter->headLen = headLen;
+	filter->paddedLen = (headLen + 3) & ~3;
+	filter->headCoeffs = (double*)malloc(filter->paddedLen * sizeof(double));
+	filter->headCoeffsOld = (double*)malloc(filter->paddedLen * sizeof(double));
+	filter->history = (double*)calloc(filter->paddedLen - 1 + headLen, sizeof(double));
+	filter->fadePos = headLen;
+	hcSetHybridHead(filter, h, hlen);
+	filter->fadePos = headLen;
+	filter->tail = 0;
+	if (hlen > headLen)
+	{
+		filter->tail = (HConv1Stage1x1*)malloc(sizeof(HConv1Stage1x1));
+		hcInit1Stage(filter->tail, h + headLen, hlen - headLen, headLen, 1, 0, 0);
+	}
+}
 AutoConvolver1x1* AllocateAutoConvolver1x1ZeroLatency(double *impulseResponse, int hlen, int audioBufferSize)
 {
 	AutoConvolver1x1 *autoConv = (AutoConvolver1x1*)calloc(1, sizeof(AutoConvolver1x1));
+	int headLen = AutoConvolver1x1ZeroLatencyPlanner(hlen, audioBufferSize);
+	if (headLen)
+	{
+		autoConv->methods = 4;
+		autoConv->hnShortLen = headLen;
+		autoConv->inbuf = (double*)calloc(headLen, sizeof(double));
+		autoConv->outbuf = (double*)calloc(headLen, sizeof(double));
+		HConvHybrid1x1* stage = (HConvHybrid1x1*)calloc(1, sizeof(HConvHybrid1x1));
+		hcInitHybrid(stage, impulseResponse, hlen, headLen);
+		if (stage->tail)
+			hcAllocFade(stage->tail);
+		autoConv->filter = (void*)stage;
+		autoConv->process = &ConvolverHybridProcess1x1;
+		return autoConv;
+	}
 	autoConv->methods = 1;
 	HConv1Stage1x1* stage = (HConv1Stage1x1*)calloc(1, sizeof(HConv1Stage1x1));
-	hcInit1Stage(stage, impulseResponse, hlen, audioBufferSize, 1);
+	hcInit1Stage(stage, impulseResponse, hlen, audioBufferSize, 1, 0, 0);
+	hcAllocFade(stage);
 	autoConv->filter = (void*)stage;
 	autoConv->process = &Convolver1StageLowLatencyProcess1x1;
 	return autoConv;
 }
-void hcInit1StageDeterminedAllocation(HConv1Stage1x1 *filter, double *h, int hlen)
+static void hcFirstSegment(HConv1Stage1x1 *filter, double *re, double *im, double sign)
 {
-	int i, j, size;
-	int flen = filter->framelength;
-	// generate filter segments
-	size = sizeof(double) * 2 * flen;
-	memset(filter->dft_time, 0, size);
-	for (i = 0; i < filter->num_filterbuf - 1; i++)
+	// Accumulates sign times the first filter segment
+	for (int n = 0; n < filter->framelength + 1; n++)
 	{
-		for (j = 0; j < flen; j++)
-			filter->dft_time[j] = h[i * flen + j];
-		kiss_fftr(filter->fft, filter->dft_time, filter->dft_freq);
-		for (j = 0; j < flen + 1; j++)
-		{
-			filter->filterbuf_freq_realChannel1[i][j] = filter->dft_freq[j].r;
-			filter->filterbuf_freq_imagChannel1[i][j] = filter->dft_freq[j].i;
-		}
+		re[n] += sign * (filter->singlePrecision ? filter->filterbufSingle_real[0][n] : filter->filterbuf_freq_realChannel1[0][n]);
+		im[n] += sign * (filter->singlePrecision ? filter->filterbufSingle_imag[0][n] : filter->filterbuf_freq_imagChannel1[0][n]);
 	}
-	for (j = 0; j < hlen - i * flen; j++)
-		filter->dft_time[j] = h[i * flen + j];
-	size = sizeof(double) * ((i + 1) * flen - hlen);
-	memset(&(filter->dft_time[hlen - i * flen]), 0, size);
-	kiss_fftr(filter->fft, filter->dft_time, filter->dft_freq);
-	for (j = 0; j < flen + 1; j++)
+}
+static void hcStartFade(HConv1Stage1x1 *filter)
+{
+	// The difference accumulates over updates until the next frame, so the fade starts from the segment last heard
+	hcAllocFade(filter);
+	if (!filter->fadePending)
 	{
-		filter->filterbuf_freq_realChannel1[i][j] = filter->dft_freq[j].r;
-		filter->filterbuf_freq_imagChannel1[i][j] = filter->dft_freq[j].i;
+		memset(filter->fade_real, 0, sizeof(double) * (filter->framelength + 1));
+		memset(filter->fade_imag, 0, sizeof(double) * (filter->framelength + 1));
 	}
+	hcFirstSegment(filter, filter->fade_real, filter->fade_imag, 1.0);
+}
+void hcInit1StageDeterminedAllocation(HConv1Stage1x1 *filter, double *h, int hlen)
+{
+	hcStartFade(filter);
+	// generate filter segments
+	hcGenerateSegments(filter, h, hlen);
+	hcFirstSegment(filter, filter->fade_real, filter->fade_imag, -1.0);
+	filter->fadePending = 1;
+}
+static int hcSwappable1Stage(HConv1Stage1x1 *a, HConv1Stage1x1 *b)
+{
+	return a->framelength == b->framelength && a->num_filterbuf == b->num_filterbuf && a->singlePrecision == b->singlePrecision && !a->sharedSpectra && !b->sharedSpectra && a->fade_real;
+}
+static void hcSwapSegments(HConv1Stage1x1 *filter, HConv1Stage1x1 *staged)
+{
+	double **re = filter->filterbuf_freq_realChannel1, **im = filter->filterbuf_freq_imagChannel1;
+	float **reSingle = filter->filterbufSingle_real, **imSingle = filter->filterbufSingle_imag;
+	hcStartFade(filter);
+	filter->filterbuf_freq_realChannel1 = staged->filterbuf_freq_realChannel1;
+	filter->filterbuf_freq_imagChannel1 = staged->filterbuf_freq_imagChannel1;
+	filter->filterbufSingle_real = staged->filterbufSingle_real;
+	filter->filterbufSingle_imag = staged->filterbufSingle_imag;
+	staged->filterbuf_freq_realChannel1 = re;
+	staged->filterbuf_freq_imagChannel1 = im;
+	staged->filterbufSingle_real = reSingle;
+	staged->filterbufSingle_imag = imSingle;
+	hcFirstSegment(filter, filter->fade_real, filter->fade_imag, -1.0);
+	filter->fadePending = 1;
 }
 void UpdateAutoConvolver1x1ZeroLatency(AutoConvolver1x1 *autoConv, double *impulseResponse, int hlen)
 {
+	if (autoConv->methods == 4)
+	{
+		HConvHybrid1x1 *stage = (HConvHybrid1x1*)autoConv->filter;
+		hcSetHybridHead(stage, impulseResponse, hlen);
+		if (stage->tail)
+			hcInit1StageDeterminedAllocation(stage->tail, impulseResponse + stage->headLen, hlen - stage->headLen);
+		return;
+	}
 	hcInit1StageDeterminedAllocation((HConv1Stage1x1*)autoConv->filter, impulseResponse, hlen);
 }
+int SwapAutoConvolver1x1ZeroLatency(AutoConvolver1x1 *autoConv, AutoConvolver1x1 *staged)
+{
+	if (autoConv->methods != staged->methods)
+		return 0;
+	if (autoConv->methods == 4)
+	{
+		HConvHybrid1x1 *stage = (HConvHybrid1x1*)autoConv->filter, *next = (HConvHybrid1x1*)staged->filter;
+		double *coeffs;
+		if (stage->headLen != next->headLen || !stage->tail != !next->tail || (stage->tail && !hcSwappable1Stage(stage->tail, next->tail)))
+			return 0;
+		hcStartHybridFade(stage);
+		coeffs = stage->headCoeffs;
+		stage->headCoeffs = next->headCoeffs;
+		next->headCoeffs = coeffs;
+		if (stage->tail)
+			hcSwapSegments(stage->tail, next->tail);
+		return 1;
+	}
+	if (autoConv->methods != 1 || !hcSwappable1Stage((HConv1Stage1x1*)autoConv->filter, (HConv1Stage1x1*)staged->filter))
+		return 0;
+	hcSwapSegments((HConv1Stage1x1*)autoConv->filter, (HConv1Stage1x1*)staged->filter);
+	return 1;
+}
 void hcClose1Stage(HConv1Stage1x1 *filter)
 {
 	int i;
-	free(filter->ifft);
-	free(filter->fft);
+	FFTPlanFree(filter->ifft);
+	FFTPlanFree(filter->fft);
 	free(filter->history_time);
 	for (i = 0; i < filter->num_mixbuf; i++)
 	{
@@ -657,18 +1139,33 @@ void hcClose1Stage(HConv1Stage1x1 *filter)
 	}
 	free(filter->mixbuf_freq_real);
 	free(filter->mixbuf_freq_imag);
-	for (i = 0; i < filter->num_filterbuf; i++)
+	if (!filter->sharedSpectra)
 	{
-		free(filter->filterbuf_freq_realChannel1[i]);
-		free(filter->filterbuf_freq_imagChannel1[i]);
+		for (i = 0; i < filter->num_filterbuf; i++)
+		{
+			if (filter->singlePrecision)
+			{
+				free(filter->filterbufSingle_real[i]);
+				free(filter->filterbufSingle_imag[i]);
+			}
+			else
+			{
+				free(filter->filterbuf_freq_realChannel1[i]);
+				free(filter->filterbuf_freq_imagChannel1[i]);
+			}
+		}
 	}
 	free(filter->filterbuf_freq_realChannel1);
 	free(filter->filterbuf_freq_imagChannel1);
+	free(filter->filterbufSingle_real);
+	free(filter->filterbufSingle_imag);
 	free(filter->in_freq_real);
 	free(filter->in_freq_imag);
 	free(filter->dft_freq);
 	free(filter->dft_time);
 	free(filter->steptask);
+	free(filter->fade_real);
+	free(filter->fade_imag);
 	memset(filter, 0, sizeof(HConv1Stage1x1));
 }
 void hcClose2Stage(HConv2Stage1x1 *filter)
@@ -681,6 +1178,18 @@ void hcClose2Stage(HConv2Stage1x1 *filter)
 	free(filter->in_long);
 	memset(filter, 0, sizeof(HConv2Stage1x1));
 }
+void hcCloseHybrid(HConvHybrid1x1 *filter)
+{
+	if (filter->tail)
+	{
+		hcClose1Stage(filter->tail);
+		free(filter->tail);
+	}
+	free(filter->history);
+	free(filter->headCoeffs);
+	free(filter->headCoeffsOld);
+	memset(filter, 0, sizeof(HConvHybrid1x1));
+}
 void hcClose3Stage(HConv3Stage1x1 *filter)
 {
 	hcClose1Stage(filter->f_short);
@@ -691,8 +1200,107 @@ void hcClose3Stage(HConv3Stage1x1 *filter)
 	free(filter->in_medium);
 	memset(filter, 0, sizeof(HConv3Stage1x1));
 }
+// All stages process in place, so the delayed input is staged in the output buffer
+static void AutoConvolver1x1DelayStage(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
+{
+	double *line = autoConv->delayLine, tmp;
+	int pos = autoConv->delayPos, len = autoConv->delayLength;
+	for (int i = 0; i < sigLen; i++)
+	{
+		tmp = line[pos];
+		line[pos] = inputs[i];
+		outputs[i] = tmp;
+		if (++pos == len)
+			pos = 0;
+	}
+	autoConv->delayPos = pos;
+}
+static void AutoConvolver1x1DelayedProcess(AutoConvolver1x1 *autoConv, double* inputs, double* outputs, int sigLen)
+{
+	AutoConvolver1x1DelayStage(autoConv, inputs, outputs, sigLen);
+	autoConv->processUndelayed(autoConv, outputs, outputs, sigLen);
+}
+static int hcBatchable1Stage(HConv1Stage1x1 *a, HConv1Stage1x1 *b)
+{
+	return a->framelength == b->framelength;
+}
+static int hcBatchable2Stage(HConv2Stage1x1 *a, HConv2Stage1x1 *b)
+{
+	return a->step == b->step && a->maxstep == b->maxstep && hcBatchable1Stage(a->f_short, b->f_short) && hcBatchable1Stage(a->f_long, b->f_long);
+}
+static int AutoConvolver1x1Batchable(AutoConvolver1x1 *a, AutoConvolver1x1 *b)
+{
+	void(*fn)(AutoConvolver1x1*, double*, double*, int) = a->delayLine ? a->processUndelayed : a->process;
+	if (fn != (b->delayLine ? b->processUndelayed : b->process) || a->bufpos != b->bufpos || a->hnShortLen != b->hnShortLen)
+		return 0;
+	if (fn == &Convolver1StageLowLatencyProcess1x1)
+		return hcBatchable1Stage((HConv1Stage1x1*)a->filter, (HConv1Stage1x1*)b->filter);
+	if (fn == &Convolver2StageProcessArbitrarySignalLength1x1)
+		return hcBatchable2Stage((HConv2Stage1x1*)a->filter, (HConv2Stage1x1*)b->filter);
+	if (fn == &Convolver3StageProcessArbitrarySignalLength1x1)
+	{
+		HConv3Stage1x1 *fa = (HConv3Stage1x1*)a->filter, *fb = (HConv3Stage1x1*)b->filter;
+		return fa->step == fb->step && fa->maxstep == fb->maxstep && hcBatchable1Stage(fa->f_short, fb->f_short) && hcBatchable2Stage(fa->f_medium, fb->f_medium);
+	}
+	if (fn == &ConvolverHybridProcess1x1)
+	{
+		HConvHybrid1x1 *fa = (HConvHybrid1x1*)a->filter, *fb = (HConvHybrid1x1*)b->filter;
+		if (fa->headLen != fb->headLen || !fa->tail != !fb->tail)
+			return 0;
+		return !fa->tail || hcBatchable1Stage(fa->tail, fb->tail);
+	}
+	return 0;
+}
+void AutoConvolver1x1ProcessBatch(AutoConvolver1x1 **autoConv, double **inputs, double **outputs, int count, int sigLen)
+{
+	double *in[CONV_BATCH_MAX];
+	void(*fn)(AutoConvolver1x1*, double*, double*, int);
+	int c, batchable = count > 1 && count <= CONV_BATCH_MAX;
+	for (c = 1; c < count && batchable; c++)
+		batchable = AutoConvolver1x1Batchable(autoConv[0], autoConv[c]);
+	if (!batchable)
+	{
+		for (c = 0; c < count; c++)
+			autoConv[c]->process(autoConv[c], inputs[c], outputs[c], sigLen);
+		return;
+	}
+	for (c = 0; c < count; c++)
+	{
+		in[c] = inputs[c];
+		if (autoConv[c]->delayLine)
+		{
+			AutoConvolver1x1DelayStage(autoConv[c], inputs[c], outputs[c], sigLen);
+			in[c] = outputs[c];
+		}
+	}
+	fn = autoConv[0]->delayLine ? autoConv[0]->processUndelayed : autoConv[0]->process;
+	if (fn == &Convolver1StageLowLatencyProcess1x1)
+		Convolver1StageProcessBatch(autoConv, in, outputs, count);
+	else if (fn == &ConvolverHybridProcess1x1)
+		ConvolverHybridProcessBatch(autoConv, in, outputs, count, sigLen);
+	else
+		ConvolverMultiStageProcessBatch(autoConv, in, outputs, count, sigLen);
+}
+int AutoConvolver1x1SetDelay(AutoConvolver1x1 *autoConv, int delay)
+{
+	if (delay <= 0 || autoConv->delayLine)
+		return 0;
+	autoConv->delayLine = (double*)calloc(delay, sizeof(double));
+	if (!autoConv->delayLine)
+		return 0;
+	autoConv->delayLength = delay;
+	autoConv->delayPos = 0;
+	autoConv->processUndelayed = autoConv->process;
+	autoConv->process = &AutoConvolver1x1DelayedProcess;
+	return 1;
+}
 void AutoConvolver1x1Free(AutoConvolver1x1 *autoConv)
 {
+	free(autoConv->delayLine);
+	autoConv->delayLine = 0;
+	if (autoConv->ownsSpectra)
+		free((void*)autoConv->spectra);
+	autoConv->spectra = 0;
 	if (autoConv->methods > 1)
 	{
 		free(autoConv->inbuf);
@@ -716,6 +1324,12 @@ void AutoConvolver1x1Free(AutoConvolver1x1 *autoConv)
 		hcClose3Stage(stage);
 		free(stage);
 	}
+	else if (autoConv->methods == 4)
+	{
+		HConvHybrid1x1* stage = (HConvHybrid1x1*)autoConv->filter;
+		hcCloseHybrid(stage);
+		free(stage);
+	}
 	else if (autoConv->methods == 999)
 	{
 		DFFIR* stage = (DFFIR*)autoConv->filter;
@@ -723,6 +1337,96 @@ void AutoConvolver1x1Free(AutoConvolver1x1 *autoConv)
 		free(stage);
 	}
 }
+int ImpulseResponseTrim(double **impulseResponse, int channels, int hlen, double noiseFloordB, int *leadingSilence)
+{
+	int i, ch, head, end, noiseEnd, tailLen, win, fade;
+	double e, total, peak, remaining, noise, a, b, threshold;
+	double floorLin = pow(10.0, noiseFloordB / 10.0);
+	*leadingSilence = 0;
+	if (hlen < 2 || noiseFloordB >= 0.0)
+		return hlen;
+	double *energy = (double*)malloc(hlen * sizeof(double));
+	if (!energy)
+		return hlen;
+	total = peak = 0.0;
+	for (i = 0; i < hlen; i++)
+	{
+		e = 0.0;
+		for (ch = 0; ch < channels; ch++)
+			e += impulseResponse[ch][i] * impulseResponse[ch][i];
+		energy[i] = e;
+		total += e;
+		if (e > peak)
+			peak = e;
+	}
+	if (total <= 0.0)
+	{
+		free(energy);
+		return hlen;
+	}
+	// Schroeder backward integration: cut where the energy still to come falls below the floor
+	remaining = 0.0;
+	end = hlen;
+	for (i = hlen - 1; i > 0; i--)
+	{
+		remaining += energy[i];
+		if (remaining > total * floorLin)
+			break;
+		end = i;
+	}
+	// Recorded IRs tend to end in stationary background noise, detected as two halves of the last tenth carrying the same energy.
+	// The decay is then over where the short time energy last rises 3 dB above that noise
+	noise = 0.0;
+	noiseEnd = hlen;
+	tailLen = hlen / 20;
+	win = 1024;
+	if (tailLen >= win)
+	{
+		a = b = 0.0;
+		for (i = hlen - 2 * tailLen; i < hlen - tailLen; i++)
+			a += energy[i];
+		for (; i < hlen; i++)
+			b += energy[i];
+		if (a > 0.0 && b > 0.0 && fabs(10.0 * log10(a / b)) < 0.5 && (a + b) / (2.0 * tailLen) < peak * 1e-4)
+		{
+			noise = (a + b) / (2.0 * tailLen);
+			for (noiseEnd = hlen - 2 * tailLen; noiseEnd >= win; noiseEnd -= win)
+			{
+				e = 0.0;
+				for (i = noiseEnd - win; i < noiseEnd; i++)
+					e += energy[i];
+				if (e > 2.0 * noise * win)
+					break;
+			}
+			if (noiseEnd < end)
+				end = noiseEnd;
+		}
+	}
+	// Leading silence is anything quieter than the floor relative to the peak and not clearly above the noise
+	threshold = peak * floorLin;
+	if (threshold < noise * 100.0)
+		threshold = noise * 100.0;
+	for (head = 0; head < end - 1; head++)
+	{
+		if (energy[head] > threshold)
+			break;
+	}
+	free(energy);
+	// Only a cut tail is faded out, so the truncation does not click
+	fade = end < hlen ? 256 : 0;
+	hlen = end - head;
+	if (fade > hlen / 4)
+		fade = hlen / 4;
+	for (ch = 0; ch < channels; ch++)
+	{
+		if (head)
+			memmove(impulseResponse[ch], impulseResponse[ch] + head, hlen * sizeof(double));
+		for (i = 0; i < fade; i++)
+			impulseResponse[ch][hlen - fade + i] *= 0.5 * (1.0 + cos(M_PI * (i + 1) / fade));
+	}
+	*leadingSilence = head;
+	return hlen;
+}
 #ifdef _WIN32
 #include <Windows.h>
 double hcTime(void)
@@ -776,7 +1480,7 @@ double getProcTime(int flen, int num, double dur)
 	size = sizeof(double) * ylen;
 	y = (double *)malloc(size);
 
-	hcInit1Stage(&filter, h, hlen, flen, 1);
+	hcInit1Stage(&filter, h, hlen, flen, 1, 0, 0);
 
 	t_diff = 0.0;
 	t_start = hcTime();
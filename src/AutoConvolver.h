@@ -1,16 +1,49 @@
 #ifndef __AUTOCONVOLVER_H__
 #define __AUTOCONVOLVER_H__
+#include <stddef.h>
 typedef struct str_AutoConvolver1x1
 {
     int methods, hnShortLen, bufpos;
     double *inbuf, *outbuf;
     void *filter;
     void(*process)(struct str_AutoConvolver1x1*, double*, double*, int);
+    double *delayLine; // Leading silence removed from the IR, replayed as a pure delay
+    int delayLength, delayPos;
+    void(*processUndelayed)(struct str_AutoConvolver1x1*, double*, double*, int);
+    const void *spectra; // Frequency domain partitions of all stages, owned unless built from caller memory
+    size_t spectraSize;
+    int ownsSpectra;
 } AutoConvolver1x1;
-AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int audioBufferSize, double gaindB, double **recommendation, int items);
+typedef struct str_ConvolverPlan
+{
+    int methods, sflen, mflen, lflen; // Partition scheme
+    int threads; // Workers the instances are spread over, including the caller
+    int singlePrecision; // Store partition spectra as float, set by the caller
+    double cpuLoad, criticalLoad; // Predicted load of all instances and of the busiest worker in % of one core
+} ConvolverPlan;
+void AutoConvolver1x1Planner(ConvolverPlan *plan, int hlen, int audioBufferSize, int fs, int channels, int maxThreads, double **recommendation, int items);
+AutoConvolver1x1* InitAutoConvolver1x1(double *impulseResponse, int hlen, int audioBufferSize, double gaindB, ConvolverPlan *plan);
+// Frequency domain partitions as exported below or taken from another instance's spectra. The memory is referenced, not copied, and must outlive the convolver
+AutoConvolver1x1* InitAutoConvolver1x1Spectra(const void *spectra, int hlen, int audioBufferSize, double gaindB, ConvolverPlan *plan);
+size_t AutoConvolver1x1SpectraSize(ConvolverPlan *plan, int hlen, int audioBufferSize);
+size_t AutoConvolver1x1ExportSpectra(AutoConvolver1x1 *autoConv, void *dst);
+size_t AutoConvolver1x1MemoryUsage(AutoConvolver1x1 *autoConv);
+// Steps up to four convolvers of one channel group together so their transforms share SIMD lanes. Same result as calling process on each,
+// which is also the fallback when their partition schemes differ. Input and output buffers of different channels must not overlap
+void AutoConvolver1x1ProcessBatch(AutoConvolver1x1 **autoConv, double **inputs, double **outputs, int count, int sigLen);
+// Zero latency FIR: uniform FFT partitions of the block size, or a vectorised direct form head with a partitioned FFT tail, whichever is cheaper
+int AutoConvolver1x1ZeroLatencyPlanner(int hlen, int audioBufferSize);
+// Flops per output sample of the zero latency plan above, same scale as CONV_DIRECT_TAP_COST
+double AutoConvolver1x1ZeroLatencyCost(int hlen, int audioBufferSize);
 AutoConvolver1x1* AllocateAutoConvolver1x1ZeroLatency(double *impulseResponse, int hlen, int audioBufferSize);
 void UpdateAutoConvolver1x1ZeroLatency(AutoConvolver1x1 *autoConv, double *impulseResponse, int hlen);
+// Takes the filter of staged, a zero latency convolver of the same length and block size, and crossfades to it as an update would.
+// Only pointers change hands, staged is left with the previous filter. Returns 0 without touching either when their layouts differ
+int SwapAutoConvolver1x1ZeroLatency(AutoConvolver1x1 *autoConv, AutoConvolver1x1 *staged);
+int AutoConvolver1x1SetDelay(AutoConvolver1x1 *autoConv, int delay);
 void AutoConvolver1x1Free(AutoConvolver1x1 *autoConv);
+// Strips leading silence and the tail whose remaining energy is below noiseFloordB, in place on all channels. Returns the new length
+int ImpulseResponseTrim(double **impulseResponse, int channels, int hlen, double noiseFloordB, int *leadingSilence);
 double** PartitionHelperWisdomGetFromFile(const char *file, int *itemRet);
 char* PartitionHelper(int s_max, int fs);
 double** PartitionHelperDirect(int s_max, int fs);
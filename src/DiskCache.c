@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DiskCache.h"
+#define DISKCACHE_DIR "jamesdsp"
+#define HASH_PRIME 0x100000001b3ULL
+uint64_t DiskCacheHash(const void *data, size_t size, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	uint64_t h = seed ^ 0xcbf29ce484222325ULL;
+	uint64_t w;
+	size_t i;
+	// Word-wise FNV-1a variant, the tail is folded in byte by byte
+	for (i = 0; i + 8 <= size; i += 8)
+	{
+		memcpy(&w, p + i, 8);
+		h = (h ^ w) * HASH_PRIME;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+		h = (h ^ p[i]) * HASH_PRIME;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+int DiskCacheHashFile(const char *path, uint64_t *hash)
+{
+	struct stat st;
+	void *data;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return 0;
+	}
+	data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return 0;
+	*hash = DiskCacheHash(data, (size_t)st.st_size, (uint64_t)st.st_size);
+	munmap(data, (size_t)st.st_size);
+	return 1;
+}
+int DiskCachePath(const char *name, char *path, size_t size)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	int len;
+	if (base && base[0])
+		len = snprintf(path, size, "%s/%s", base, DISKCACHE_DIR);
+	else
+	{
+		base = getenv("HOME");
+		if (!base || !base[0])
+			return 0;
+		len = snprintf(path, size, "%s/.cache/%s", base, DISKCACHE_DIR);
+	}
+	if (len < 0 || (size_t)len >= size)
+		return 0;
+	if (!name)
+		return 1;
+	len = snprintf(path + len, size - len, "/%s", name);
+	return len > 0 && (size_t)len < size;
+}
+static int DiskCacheMakeDir(void)
+{
+	char path[4096];
+	char *slash;
+	if (!DiskCachePath(0, path, sizeof(path)))
+		return 0;
+	for (slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+	{
+		*slash = 0;
+		if (mkdir(path, 0755) < 0 && errno != EEXIST)
+			return 0;
+		*slash = '/';
+	}
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+int DiskCacheMap(const char *name, DiskCacheMapping *mapping)
+{
+	char path[4096];
+	struct stat st;
+	void *data;
+	int fd;
+	mapping->data = 0;
+	mapping->size = 0;
+	if (!DiskCachePath(name, path, sizeof(path)))
+		return 0;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return 0;
+	}
+	// Shared read-only mapping, every process loading the same entry shares the page cache
+	data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return 0;
+	mapping->data = data;
+	mapping->size = (size_t)st.st_size;
+	return 1;
+}
+void DiskCacheUnmap(DiskCacheMapping *mapping)
+{
+	if (mapping->data)
+		munmap(mapping->data, mapping->size);
+	mapping->data = 0;
+	mapping->size = 0;
+}
+int DiskCacheStore(const char *name, const void *header, size_t headerSize, const void *payload, size_t payloadSize)
+{
+	char path[4096], tmpPath[4096];
+	FILE *fp;
+	int ok;
+	if (!DiskCacheMakeDir() || !DiskCachePath(name, path, sizeof(path)))
+		return 0;
+	// Write under a private name and rename, readers never see a partial entry
+	if (snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tmpPath))
+		return 0;
+	fp = fopen(tmpPath, "wb");
+	if (!fp)
+		return 0;
+	ok = fwrite(header, 1, headerSize, fp) == headerSize;
+	if (ok && payloadSize)
+		ok = fwrite(payload, 1, payloadSize, fp) == payloadSize;
+	if (fclose(fp) != 0)
+		ok = 0;
+	if (ok)
+		ok = rename(tmpPath, path) == 0;
+	if (!ok)
+		unlink(tmpPath);
+	return ok;
+}
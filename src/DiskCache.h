@@ -0,0 +1,16 @@
+#ifndef __DISKCACHE_H__
+#define __DISKCACHE_H__
+#include <stddef.h>
+#include <stdint.h>
+typedef struct str_DiskCacheMapping
+{
+    void *data;
+    size_t size;
+} DiskCacheMapping;
+uint64_t DiskCacheHash(const void *data, size_t size, uint64_t seed);
+int DiskCacheHashFile(const char *path, uint64_t *hash);
+int DiskCachePath(const char *name, char *path, size_t size);
+int DiskCacheMap(const char *name, DiskCacheMapping *mapping);
+void DiskCacheUnmap(DiskCacheMapping *mapping);
+int DiskCacheStore(const char *name, const void *header, size_t headerSize, const void *payload, size_t payloadSize);
+#endif
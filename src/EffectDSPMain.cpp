@@ -3,6 +3,7 @@
 #include "MemoryUsage.h"
 #endif
 #include <unistd.h>
+#include <float.h>
 #include "EffectDSPMain.h"
 typedef struct
 {
@@ -12,13 +13,55 @@ typedef struct
 	int32_t cmd;
 	int32_t data;
 } reply1x4_1x4_t;
+typedef struct
+{
+	int32_t status;
+	uint32_t psize;
+	uint32_t vsize;
+	int32_t cmd;
+	int32_t data[7];
+} reply1x4_7x4_t;
+typedef struct irCacheHeader_s
+{
+	char magic[8];
+	uint64_t contentHash;
+	int32_t samplingRate, channels, sourceLength, noiseFloor, blockLength, singlePrecision; // Lookup key
+	int32_t hlen, delay, methods, sflen, mflen, lflen; // Outcome of trimming and planning
+	uint64_t spectraSize;
+} irCacheHeader_t;
+// Compiled DDC: rateCount sets of { int32_t samplingRate, sections; double b0 b1 b2 a1 a2 per section } follow the header
+typedef struct ddcCacheHeader_s
+{
+	char magic[8];
+	uint64_t contentHash, checksum; // Checksum covers everything after the header
+	int32_t sosCount, rateCount;
+} ddcCacheHeader_t;
+#define DDC_SECTION_COST 4.0 // Flops per section and channel sample of the SIMD cascade, on the convolver's cost scale
+#define DDC_FIR_DECAY_DB 100.0 // Truncation point of the FIR, relative to the slowest pole's envelope
+#define DDC_FIR_MAX_LENGTH 131072
+#define DDC_FIR_MAX_ERROR 0.1 // dB, largest deviation from the cascade the FIR may have in the audible band
+#define EQ_DESIGN_INTERVAL 40 // Minimum time between two FIR EQ designs in ms, slider drags in between collapse into the last position
 const double interpFreq[NUM_BANDS] = { 25.0, 40.0, 63.0, 100.0, 160.0, 250.0, 400.0, 630.0, 1000.0, 1600.0, 2500.0, 4000.0, 6300.0, 10000.0, 16000.0 };
 
 EffectDSPMain::EffectDSPMain()
-	: DSPbufferLength(1024), inOutRWPosition(0), equalizerEnabled(0), ramp(1.0), pregain(12.0), threshold(-60.0), knee(30.0), ratio(12.0), attack(0.001), release(0.24), isBenchData(0), mPreset(0), reverbEnabled(0)
-	, mMatrixMCoeff(1.0), mMatrixSCoeff(1.0), bassBoostLp(0), FIREq(0), convolver(0), fullStereoConvolver(0), sosCount(0), resampledSOSCount(0), usedSOSCount(0), df441(0), df48(0), dfResampled(0)
-	, tempImpulseIncoming(0), tempImpulsedouble(0), finalImpulse(0), convolverReady(-1), bassLpReady(-1), analogModelEnable(0), tubedrive(2.0), eqFilterType(0), arbEq(0), xaxis(0), yaxis(0), eqFIRReady(0)
+	: DSPbufferLength(1024), inOutRWPosition(0), equalizerEnabled(0), ramp(1.0), pregain(12.0), threshold(-60.0), knee(30.0), ratio(12.0), attack(0.001), release(0.24), isBenchData(0), mPreset(0), reverbEnabled(0), reverbEngine(0)
+	, mMatrixMCoeff(1.0), mMatrixSCoeff(1.0), bassBoostLp(0), FIREq(0), convolver(0), fullStereoConvolver(0), sosCount(0), resampledSOSCount(0), usedSOSCount(0), df441(0), df48(0), dfResampled(0), resampledFs(0.0), ddcContentHash(0), ddcFIR(0), ddcFIRReady(0)
+	, tempImpulseIncoming(0), tempImpulsedouble(0), finalImpulse(0), convolverReady(-1), bassLpReady(-1), analogModelEnable(0), tubedrive(2.0), eqFilterType(0), arbEq(0), xaxis(0), yaxis(0), eqFIRReady(0), irContentHash(0)
+	, impulseLengthSource(0), impulseDelay(0), irNoiseFloor(-90), convolverSinglePrecision(0), eqDesignRunning(0), eqDesignQuit(0), eqDesignPending(0), eqDesignDone(0)
+	, eqBandsValid(0), eqDesignConv(0), eqSOSCount(0), eqIIRReady(0), eqCustomString(0)
 {
+	memset(&eqCustom, 0, sizeof(eqCustom));
+	memset(&ddcCascade, 0, sizeof(ddcCascade));
+	memset(&eqCascade, 0, sizeof(eqCascade));
+	memset(&myreverb, 0, sizeof(myreverb));
+	memset(&fdnReverb, 0, sizeof(fdnReverb));
+	memset(eqBands, 0, sizeof(eqBands));
+	for (int i = 0; i < NUM_BANDS; i++)
+		eqSOSPointer[i] = &eqSOS[i];
+	pthread_mutex_init(&eqDesignLock, 0);
+	pthread_cond_init(&eqDesignCond, 0);
+	irCache.data = 0;
+	irCache.size = 0;
 	double c0[12] = { 2.138018534150542e-5, 4.0608501987194246e-5, 7.950414700590711e-5, 1.4049065318523225e-4, 2.988065284903209e-4, 0.0013061668170781858, 0.0036204239724680425, 0.008959629624060151, 0.027083658741258742, 0.08156916666666666, 0.1978822177777778, 0.4410733777777778 };
 	double c1[12] = { 5.88199398839289e-6, 1.1786813951189911e-5, 2.5600214528512222e-5, 8.53041086120132e-5, 2.656291374239004e-4, 5.047717001008378e-4, 8.214255850540808e-4, 0.0016754651127819551, 0.0033478867132867136, 0.006705333333333334, 0.013496382222222221, 0.02673028888888889 };
 	benchmarkValue[0] = (double*)malloc(12 * sizeof(double));
@@ -35,7 +78,8 @@ EffectDSPMain::EffectDSPMain()
 	tempBuf[0] = (double*)malloc(memSize);
 	tempBuf[1] = (double*)malloc(memSize);
 
-	r = (reverbdata_t*)malloc(sizeof *r);
+	// Zeroed so the reverb sizes its delay memory from sane values if it is enabled before any parameters arrive
+	r = (reverbdata_t*)calloc(1, sizeof *r);
 #ifdef DEBUG
 	printf("[I] %d space allocated\n", DSPbufferLength);
 #endif
@@ -56,6 +100,13 @@ EffectDSPMain::~EffectDSPMain()
 	}
 	FreeBassBoost();
 	FreeEq();
+	SOSCascadeFree(&eqCascade);
+	SOSCascadeFree(&ddcCascade);
+	FreeDDCFIR();
+	EqNodesFree(&eqCustom);
+	free(eqCustomString);
+	pthread_mutex_destroy(&eqDesignLock);
+	pthread_cond_destroy(&eqDesignCond);
 	FreeConvolver();
 	if (finalImpulse)
 	{
@@ -71,6 +122,30 @@ EffectDSPMain::~EffectDSPMain()
 		free(benchmarkValue[0]);
 	if (benchmarkValue[1])
 		free(benchmarkValue[1]);
+	FreeDDC();
+	sf_reverb_free(&myreverb);
+	FDNReverbFree(&fdnReverb);
+	free(r);
+#ifdef DEBUG
+	printf("[I] Buffer freed\n");
+#endif
+}
+void EffectDSPMain::FreeBassBoost()
+{
+	if (bassBoostLp)
+	{
+		for (unsigned int i = 0; i < NUMCHANNEL; i++)
+		{
+			AutoConvolver1x1Free(bassBoostLp[i]);
+			free(bassBoostLp[i]);
+		}
+		free(bassBoostLp);
+		bassBoostLp = 0;
+		ramp = 0.4;
+	}
+}
+void EffectDSPMain::FreeDDC()
+{
 	if (sosCount)
 	{
 		for (int i = 0; i < sosCount; i++)
@@ -79,37 +154,209 @@ EffectDSPMain::~EffectDSPMain()
 			free(df48[i]);
 		}
 		free(df441);
+		df441 = 0;
 		free(df48);
+		df48 = 0;
 		sosCount = 0;
-		if (resampledSOSCount)
+	}
+	// Retargeted sections belong to the DDC they were made from
+	if (dfResampled)
+	{
+		for (int i = 0; i < resampledSOSCount; i++)
+			free(dfResampled[i]);
+		free(dfResampled);
+		dfResampled = 0;
+		resampledSOSCount = 0;
+	}
+	sosPointer = 0;
+}
+void EffectDSPMain::FreeDDCFIR()
+{
+	ddcFIRReady = 0;
+	if (ddcFIR)
+	{
+		for (unsigned int i = 0; i < NUMCHANNEL; i++)
 		{
-			for (int i = 0; i < resampledSOSCount; i++)
-				free(dfResampled[i]);
-			free(dfResampled);
-			dfResampled = 0;
-			resampledSOSCount = 0;
+			AutoConvolver1x1Free(ddcFIR[i]);
+			free(ddcFIR[i]);
 		}
+		free(ddcFIR);
+		ddcFIR = 0;
+	}
+}
+void EffectDSPMain::refreshDDCStrategy()
+{
+	int i, k, nfft, hlen;
+	FreeDDCFIR();
+	if (usedSOSCount < 1)
+		return;
+	// Recursion costs the same for any decay, the FIR grows with it. Most DDCs are decided here without computing anything
+	hlen = SOSCascadeDecayLength(sosPointer, usedSOSCount, DDC_FIR_DECAY_DB);
+	if (hlen < 1 || hlen > DDC_FIR_MAX_LENGTH || AutoConvolver1x1ZeroLatencyCost(hlen, DSPbufferLength) >= usedSOSCount * DDC_SECTION_COST)
+		return;
+	// Impulse response of the cascade itself, minimum phase as the sections are, exact up to the truncation
+	double *impulse = (double*)calloc(hlen, sizeof(double)), *scratch = (double*)calloc(hlen, sizeof(double));
+	SOSCascade probe;
+	memset(&probe, 0, sizeof(probe));
+	SOSCascadeLoad(&probe, sosPointer, usedSOSCount);
+	impulse[0] = 1.0;
+	SOSCascadeProcess(&probe, impulse, scratch, impulse, scratch, hlen);
+	SOSCascadeFree(&probe);
+	free(scratch);
+	for (nfft = 2; nfft < 2 * hlen; nfft <<= 1);
+	FFTPlan *plan = FFTPlanReal(nfft, 0);
+	FFTComplex *spectrum = (FFTComplex*)malloc((nfft / 2 + 1) * sizeof(FFTComplex));
+	double *padded = (double*)calloc(nfft, sizeof(double)), fs = mSamplingRate, f, target, dB, err = 0.0;
+	memcpy(padded, impulse, hlen * sizeof(double));
+	FFTRealForward(plan, padded, spectrum);
+	FFTPlanFree(plan);
+	free(padded);
+	// Log spaced probes snapped to bins, bands attenuated below -60 dB do not count
+	for (f = 20.0; f < fmin(20000.0, 0.45 * fs); f *= 1.02)
+	{
+		k = (int)(f * nfft / fs + 0.5);
+		target = SOSCascadeMagnitudedB(sosPointer, usedSOSCount, 6.2831853071795862 * k / nfft);
+		if (target < -60.0)
+			continue;
+		dB = 10.0 * log10(spectrum[k].r * spectrum[k].r + spectrum[k].i * spectrum[k].i + DBL_MIN);
+		err = fmax(err, fabs(dB - target));
+	}
+	free(spectrum);
+	if (err <= DDC_FIR_MAX_ERROR)
+	{
+		ddcFIR = (AutoConvolver1x1**)malloc(sizeof(AutoConvolver1x1*) * NUMCHANNEL);
+		for (i = 0; i < NUMCHANNEL; i++)
+			ddcFIR[i] = AllocateAutoConvolver1x1ZeroLatency(impulse, hlen, DSPbufferLength);
+		ddcFIRReady = 1;
 	}
 #ifdef DEBUG
-	printf("[I] Buffer freed\n");
+	printf("[I] DDC: %d sections, FIR of %d taps %s (max error %.3f dB)\n", usedSOSCount, hlen, ddcFIRReady ? "selected" : "rejected", err);
 #endif
+	free(impulse);
 }
-void EffectDSPMain::FreeBassBoost()
+int EffectDSPMain::loadDDCCache()
 {
-	if (bassBoostLp)
+	DiskCacheMapping map;
+	ddcCacheHeader_t header;
+	char name[64];
+	const char *p, *end;
+	int32_t set[2];
+	int i, j, have441 = 0, have48 = 0;
+	snprintf(name, sizeof(name), "ddc-%016llx.sos", (unsigned long long)ddcContentHash);
+	if (!DiskCacheMap(name, &map))
+		return 0;
+	if (map.size < sizeof(header))
 	{
-		for (unsigned int i = 0; i < NUMCHANNEL; i++)
+		DiskCacheUnmap(&map);
+		return 0;
+	}
+	memcpy(&header, map.data, sizeof(header));
+	p = (const char*)map.data + sizeof(header);
+	end = (const char*)map.data + map.size;
+	if (memcmp(header.magic, "JDSPDDC1", 8) || header.contentHash != ddcContentHash || header.sosCount < 1
+		|| header.checksum != DiskCacheHash(p, end - p, ddcContentHash))
+	{
+		DiskCacheUnmap(&map);
+		return 0;
+	}
+	FreeDDC();
+	sosCount = header.sosCount;
+	df441 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
+	df48 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
+	for (i = 0; i < sosCount; i++)
+	{
+		df441[i] = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+		df48[i] = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+	}
+	for (i = 0; i < header.rateCount && end - p >= (ptrdiff_t)sizeof(set); i++)
+	{
+		memcpy(set, p, sizeof(set));
+		p += sizeof(set);
+		if (set[1] < 0 || (size_t)(end - p) < set[1] * 5 * sizeof(double))
+			break;
+		DirectForm2 **dst = 0;
+		if (set[0] == 44100 && set[1] == sosCount)
 		{
-			AutoConvolver1x1Free(bassBoostLp[i]);
-			free(bassBoostLp[i]);
+			dst = df441;
+			have441 = 1;
 		}
-		free(bassBoostLp);
-		bassBoostLp = 0;
-		ramp = 0.4;
+		else if (set[0] == 48000 && set[1] == sosCount)
+		{
+			dst = df48;
+			have48 = 1;
+		}
+		else if (set[0] == (int32_t)mSamplingRate && !dfResampled)
+		{
+			// Retargeted set stored alongside the source rates
+			dfResampled = (DirectForm2**)malloc((set[1] ? set[1] : 1) * sizeof(DirectForm2*));
+			for (j = 0; j < set[1]; j++)
+				dfResampled[j] = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+			resampledSOSCount = set[1];
+			resampledFs = mSamplingRate;
+			dst = dfResampled;
+		}
+		for (j = 0; dst && j < set[1]; j++)
+			memcpy(&dst[j]->b0, p + j * 5 * sizeof(double), 5 * sizeof(double));
+		p += set[1] * 5 * sizeof(double);
+	}
+	DiskCacheUnmap(&map);
+	if (!have441 || !have48)
+	{
+		FreeDDC();
+		return 0;
 	}
+#ifdef DEBUG
+	printf("[I] DDC with %d sections mapped from cache %s\n", sosCount, name);
+#endif
+	return 1;
+}
+void EffectDSPMain::storeDDCCache()
+{
+	ddcCacheHeader_t header;
+	char name[64];
+	int32_t rates[3] = { 44100, 48000, (int32_t)mSamplingRate }, set[2];
+	DirectForm2 **sets[3] = { df441, df48, dfResampled };
+	int counts[3] = { sosCount, sosCount, resampledSOSCount };
+	int i, j, rateCount = dfResampled && resampledFs == mSamplingRate ? 3 : 2;
+	size_t size = 0;
+	for (i = 0; i < rateCount; i++)
+		size += sizeof(set) + counts[i] * 5 * sizeof(double);
+	char *payload = (char*)malloc(size), *p = payload;
+	if (!payload)
+		return;
+	for (i = 0; i < rateCount; i++)
+	{
+		set[0] = rates[i];
+		set[1] = counts[i];
+		memcpy(p, set, sizeof(set));
+		p += sizeof(set);
+		for (j = 0; j < counts[i]; j++, p += 5 * sizeof(double))
+			memcpy(p, &sets[i][j]->b0, 5 * sizeof(double));
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "JDSPDDC1", 8);
+	header.contentHash = ddcContentHash;
+	header.checksum = DiskCacheHash(payload, size, ddcContentHash);
+	header.sosCount = sosCount;
+	header.rateCount = rateCount;
+	snprintf(name, sizeof(name), "ddc-%016llx.sos", (unsigned long long)ddcContentHash);
+	if (DiskCacheStore(name, &header, sizeof(header), payload, size))
+	{
+#ifdef DEBUG
+		printf("[I] DDC stored to cache %s\n", name);
+#endif
+	}
+	free(payload);
 }
 void EffectDSPMain::FreeEq()
 {
+	// The worker reads the design state below
+	stopEqDesign();
+	eqIIRReady = 0;
+	eqSOSCount = 0;
+	memset(eqSOS, 0, sizeof(eqSOS));
+	// An empty cascade, sections loaded later start at rest
+	SOSCascadeLoad(&eqCascade, eqSOSPointer, 0);
 	if (xaxis)
 	{
 		free(xaxis);
@@ -169,6 +416,7 @@ void EffectDSPMain::FreeConvolver()
 		free(fullStereoConvolver);
 		fullStereoConvolver = 0;
 	}
+	DiskCacheUnmap(&irCache);
 }
 void EffectDSPMain::channel_splitFloat(const float *buffer, unsigned int num_frames, float **chan_buffers, unsigned int num_channels)
 {
@@ -198,6 +446,8 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 		fullStconvparams.frameCount = DSPbufferLength;
 		fullStconvparams1.in = inputBuffer;
 		fullStconvparams1.frameCount = DSPbufferLength;
+		fullStconvparams2.in = inputBuffer;
+		fullStconvparams2.frameCount = DSPbufferLength;
 		rightparams2.in = inputBuffer;
 		rightparams2.frameCount = DSPbufferLength;
 		if(replyData!=NULL)*replyData = 0;
@@ -272,18 +522,50 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 			}
 			else if (cmd == 20004)
 			{
-				reply1x4_1x4_t *replyData = (reply1x4_1x4_t *)pReplyData;
+				reply1x4_7x4_t *replyData = (reply1x4_7x4_t *)pReplyData;
 				replyData->status = 0;
 				replyData->psize = 4;
-				replyData->vsize = 4;
-				replyData->cmd = 20003;
-				if (convolver)
-					replyData->data = convolver[0]->methods;
-				else if (fullStereoConvolver)
-					replyData->data = fullStereoConvolver[0]->methods;
-				else
-					replyData->data = 0;
-				*replySize = sizeof(reply1x4_1x4_t);
+				replyData->vsize = 28;
+				replyData->cmd = 20004;
+				memset(replyData->data, 0, sizeof(replyData->data));
+				if (convolver || fullStereoConvolver)
+				{
+					replyData->data[0] = convPlan.methods;
+					replyData->data[1] = convPlan.threads;
+					replyData->data[2] = convPlan.sflen;
+					replyData->data[3] = convPlan.mflen;
+					replyData->data[4] = convPlan.lflen;
+					replyData->data[5] = (int32_t)(convPlan.cpuLoad * 100.0);
+					replyData->data[6] = (int32_t)(convPlan.criticalLoad * 100.0);
+				}
+				*replySize = sizeof(reply1x4_7x4_t);
+				return 0;
+			}
+			else if (cmd == 20005)
+			{
+				reply1x4_7x4_t *replyData = (reply1x4_7x4_t *)pReplyData;
+				replyData->status = 0;
+				replyData->psize = 4;
+				replyData->vsize = 28;
+				replyData->cmd = 20005;
+				memset(replyData->data, 0, sizeof(replyData->data));
+				AutoConvolver1x1 **conv = fullStereoConvolver ? fullStereoConvolver : convolver;
+				int instances = fullStereoConvolver ? 4 : 2;
+				size_t bytes, total = irCache.size;
+				if (conv)
+				{
+					// Bytes held by each instance, then the mapped cache entry the instances may reference, then the sum
+					replyData->data[0] = instances;
+					for (int i = 0; i < instances; i++)
+					{
+						bytes = conv[i] ? AutoConvolver1x1MemoryUsage(conv[i]) : 0;
+						replyData->data[1 + i] = bytes > INT32_MAX ? INT32_MAX : (int32_t)bytes;
+						total += bytes;
+					}
+					replyData->data[5] = irCache.size > INT32_MAX ? INT32_MAX : (int32_t)irCache.size;
+					replyData->data[6] = total > INT32_MAX ? INT32_MAX : (int32_t)total;
+				}
+				*replySize = sizeof(reply1x4_7x4_t);
 				return 0;
 			}
 		}
@@ -415,6 +697,15 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 				return 0;
 			}
 
+			else if (cmd == 129)
+			{
+				int16_t oldVal = reverbEngine;
+				reverbEngine = ((int16_t *)cep)[8] ? 1 : 0;
+				if (oldVal != reverbEngine)
+					refreshReverb();
+                if(replyData!=NULL)*replyData = 0;
+				return 0;
+			}
 			else if (cmd == 150)
 			{
 				double oldVal = tubedrive;
@@ -443,6 +734,26 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
                 if(replyData!=NULL)*replyData = 0;
 				return 0;
 			}
+			else if (cmd == 160)
+			{
+				// Takes effect with the next impulse response, the time domain IR is gone once partitioned
+				convolverSinglePrecision = ((int16_t *)cep)[8] ? 1 : 0;
+#ifdef DEBUG
+				printf("[I] Convolver spectra precision: %s\n", convolverSinglePrecision ? "single" : "double");
+#endif
+                if(replyData!=NULL)*replyData = 0;
+				return 0;
+			}
+			else if (cmd == 161)
+			{
+				// Plans are created per IR/EQ load, so reload them for an A/B comparison
+				int accepted = FFTSelectBackend(((int16_t *)cep)[8]);
+#ifdef DEBUG
+				printf("[I] FFT backend: %s\n", FFTBackendName(FFTActiveBackend()));
+#endif
+                if(replyData!=NULL)*replyData = accepted ? 0 : -EINVAL;
+				return 0;
+			}
 			/*			else if (cmd == 808)
 			{
 			double oldVal = tubedrive;
@@ -503,19 +814,7 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 				int16_t oldVal = equalizerEnabled;
 				equalizerEnabled = ((int16_t *)cep)[8];
 				if ((equalizerEnabled == 1 && (oldVal != equalizerEnabled)) || eqFIRReady == 2)
-				{
-					xaxis = (double*)malloc(1024 * sizeof(double));
-					yaxis = (double*)malloc(1024 * sizeof(double));
-					linspace(xaxis, 1024, interpFreq[0], interpFreq[NUM_BANDSM1]);
-					arbEq = (ArbitraryEq*)malloc(sizeof(ArbitraryEq));
-					eqfilterLength = 8192;
-					InitArbitraryEq(arbEq, &eqfilterLength, eqFilterType);
-					for (int i = 0; i < 1024; i++)
-						ArbitraryEqInsertNode(arbEq, xaxis[i], 0.0, 0);
-#ifdef DEBUG
-					printf("[I] FIR EQ Initialised\n");
-#endif
-				}
+					initEq();
 				else if (!equalizerEnabled && (oldVal != equalizerEnabled))
 				{
 					eqFIRReady = 0;
@@ -585,13 +884,35 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 					usedSOSCount = sosCount;
 					viperddcEnabled = ((int16_t *)cep)[8];
 				}
-				else
+				else if (df48)
 				{
-					resampledSOSCount = PeakingFilterResampler(df48, 48000.0, &dfResampled, mSamplingRate, sosCount);
+					// Retargeted sections are kept until the DDC or the rate changes
+					if (!dfResampled || resampledFs != mSamplingRate)
+					{
+						if (dfResampled)
+						{
+							for (int i = 0; i < resampledSOSCount; i++)
+								free(dfResampled[i]);
+							free(dfResampled);
+						}
+						resampledSOSCount = PeakingFilterResampler(df48, 48000.0, &dfResampled, mSamplingRate, sosCount);
+						resampledFs = mSamplingRate;
+					}
 					usedSOSCount = resampledSOSCount;
 					sosPointer = dfResampled;
 					viperddcEnabled = ((int16_t *)cep)[8];
 				}
+				else
+				{
+					usedSOSCount = 0;
+					viperddcEnabled = ((int16_t *)cep)[8];
+				}
+				// The FIR is only worth building for a DDC that is going to run
+				if (viperddcEnabled)
+				{
+					SOSCascadeLoad(&ddcCascade, sosPointer, usedSOSCount);
+					refreshDDCStrategy();
+				}
 #ifdef DEBUG
 				printf("[I] viperddcEnabled: %d\n", viperddcEnabled);
 #endif
@@ -602,28 +923,11 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 						free(stringEq);
 						stringEq = 0;
 					}
-					if (sosCount)
-					{
-						for (int i = 0; i < sosCount; i++)
-						{
-							free(df441[i]);
-							free(df48[i]);
-						}
-						free(df441);
-						df441 = 0;
-						free(df48);
-						df48 = 0;
-						sosCount = 0;
-						if (resampledSOSCount)
-						{
-							for (int i = 0; i < resampledSOSCount; i++)
-								free(dfResampled[i]);
-							free(dfResampled);
-							dfResampled = 0;
-							resampledSOSCount = 0;
-						}
-						sosPointer = 0;
-					}
+					FreeDDCFIR();
+					FreeDDC();
+					usedSOSCount = 0;
+					// An empty cascade, sections loaded later start at rest
+					SOSCascadeLoad(&ddcCascade, sosPointer, 0);
 				}
                 if(replyData!=NULL)*replyData = 0;
 				return 0;
@@ -673,6 +977,8 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 							channelbuf[j] = p[j * impChannels];
 						finalImpulse[i] = channelbuf;
 					}
+					if (finalImpulse)
+						trimImpulse();
 					if (!refreshConvolver(DSPbufferLength))
 					{
 						convolverReady = -1;
@@ -702,31 +1008,7 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 			}
 			else if (cmd == 10009)
 			{
-				if (!viperddcEnabled)
-				{
-					if (sosCount)
-					{
-						for (int i = 0; i < sosCount; i++)
-						{
-							free(df441[i]);
-							free(df48[i]);
-						}
-						free(df441);
-						df441 = 0;
-						free(df48);
-						df48 = 0;
-						sosCount = 0;
-						if (resampledSOSCount)
-						{
-							for (int i = 0; i < resampledSOSCount; i++)
-								free(dfResampled[i]);
-							free(dfResampled);
-							dfResampled = 0;
-							resampledSOSCount = 0;
-						}
-						sosPointer = 0;
-					}
-				}
+				FreeDDC();
 #ifdef DEBUG
 				printf("[I] %s\n", stringEq);
 #endif
@@ -801,7 +1083,7 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 				double mBand[NUM_BANDS];
 				for (int i = 0; i < NUM_BANDS; i++)
 					mBand[i] = (double)((float*)cep)[4 + i];
-				refreshEqBands(DSPbufferLength, mBand);
+				refreshEqBands(mBand);
                 if(replyData!=NULL)*replyData = 0;
 				return 0;
 			}
@@ -815,7 +1097,9 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 				{
 					for (uint32_t i = 0; i < 10; i++)
 					{
-						benchmarkValue[0][i] = (double)((float*)cep)[4 + i];
+						// Entries left empty by the sender keep the built-in estimate
+						if (((float*)cep)[4 + i] > 0.0f)
+							benchmarkValue[0][i] = (double)((float*)cep)[4 + i];
 #ifdef DEBUG
 						printf("[I] bench_c0: %lf\n", benchmarkValue[0][i]);
 #endif
@@ -835,7 +1119,9 @@ int32_t EffectDSPMain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdDat
 				{
 					for (uint32_t i = 0; i < 10; i++)
 					{
-						benchmarkValue[1][i] = (double)((float*)cep)[4 + i];
+						// Entries left empty by the sender keep the built-in estimate
+						if (((float*)cep)[4 + i] > 0.0f)
+							benchmarkValue[1][i] = (double)((float*)cep)[4 + i];
 #ifdef DEBUG
 						printf("[I] bench_c1: %lf\n", benchmarkValue[1][i]);
 #endif
@@ -969,81 +1255,220 @@ void EffectDSPMain::refreshBassLinearPhase(uint32_t DSPbufferLength, uint32_t ta
 #endif
 	bassLpReady = 1;
 }
-int EffectDSPMain::refreshConvolver(uint32_t DSPbufferLength)
+void EffectDSPMain::planConvolver(uint32_t DSPbufferLength)
 {
-	if (!finalImpulse)
+	int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1)
+		cores = 1;
+	AutoConvolver1x1Planner(&convPlan, impulseLengthActual, DSPbufferLength, (int)mSamplingRate, impChannels, cores, benchmarkValue, 12);
+	convPlan.singlePrecision = convolverSinglePrecision;
+#ifdef DEBUG
+	printf("[I] Convolver plan: method %d (%d/%d/%d), %d worker(s), predicted load %.2f%% (busiest worker %.2f%%)\n", convPlan.methods, convPlan.sflen, convPlan.mflen, convPlan.lflen, convPlan.threads, convPlan.cpuLoad, convPlan.criticalLoad);
+#endif
+}
+int EffectDSPMain::buildConvolvers(AutoConvolver1x1 **conv, int instances, uint32_t DSPbufferLength, const void *spectra, size_t spectraSize)
+{
+	int i, j, ch, chj;
+	for (i = 0; i < instances; i++)
+	{
+		ch = impChannels == 1 ? 0 : i;
+		// An instance whose IR channel matches an earlier one references that instance's partitions instead of holding a copy
+		for (j = 0; j < i; j++)
+		{
+			chj = impChannels == 1 ? 0 : j;
+			if (chj == ch)
+				break;
+			if (spectra && !memcmp((const char*)spectra + chj * spectraSize, (const char*)spectra + ch * spectraSize, spectraSize))
+				break;
+			if (!spectra && !memcmp(finalImpulse[chj], finalImpulse[ch], impulseLengthActual * sizeof(double)))
+				break;
+		}
+		if (j < i && conv[j]->spectra)
+			conv[i] = InitAutoConvolver1x1Spectra(conv[j]->spectra, impulseLengthActual, DSPbufferLength, convGaindB, &convPlan);
+		else if (spectra)
+			conv[i] = InitAutoConvolver1x1Spectra((const char*)spectra + ch * spectraSize, impulseLengthActual, DSPbufferLength, convGaindB, &convPlan);
+		else
+			conv[i] = InitAutoConvolver1x1(finalImpulse[ch], impulseLengthActual, DSPbufferLength, convGaindB, &convPlan);
+		if (!conv[i] || (impulseDelay > 0 && !AutoConvolver1x1SetDelay(conv[i], impulseDelay)))
+			return 0;
+#ifdef DEBUG
+		if (j < i)
+			printf("[I] Convolver %d shares the partitions of convolver %d\n", i, j);
+#endif
+	}
+	return 1;
+}
+int EffectDSPMain::allocateConvolver(uint32_t DSPbufferLength, const void *spectra, size_t spectraSize)
+{
+	if (impChannels < 3)
+	{
+		convolver = (AutoConvolver1x1**)calloc(2, sizeof(AutoConvolver1x1*));
+		if (!convolver || !buildConvolvers(convolver, 2, DSPbufferLength, spectra, spectraSize))
+			return 0;
+		fullStconvparams.conv = convolver;
+		fullStconvparams.out = outputBuffer;
+		if (convPlan.threads < 2)
+			convolverReady = 1;
+		else
+			convolverReady = 2;
+#ifdef DEBUG
+		printf("[I] Convolver strategy used: %d\n", convolver[0]->methods);
+#endif
+	}
+	else if (impChannels == 4)
+	{
+		fullStereoConvolver = (AutoConvolver1x1**)calloc(4, sizeof(AutoConvolver1x1*));
+		if (!fullStereoConvolver || !buildConvolvers(fullStereoConvolver, 4, DSPbufferLength, spectra, spectraSize))
+			return 0;
+		fullStconvparams.conv = fullStereoConvolver;
+		fullStconvparams1.conv = fullStereoConvolver;
+		fullStconvparams2.conv = fullStereoConvolver;
+		fullStconvparams.out = tempBuf;
+		fullStconvparams1.out = tempBuf;
+		fullStconvparams2.out = outputBuffer;
+		if (convPlan.threads < 2)
+			convolverReady = 5;
+		else if (convPlan.threads < 4)
+			convolverReady = 3;
+		else
+			convolverReady = 4;
+#ifdef DEBUG
+		printf("[I] Convolver strategy used: %d\n", fullStereoConvolver[0]->methods);
+#endif
+	}
+	else
 		return 0;
+	ramp = 0.4;
+	return 1;
+}
+void EffectDSPMain::trimImpulse()
+{
+	int32_t sourceLength = impulseLengthActual;
+	impulseLengthSource = sourceLength;
+	impulseLengthActual = ImpulseResponseTrim(finalImpulse, impChannels, sourceLength, irNoiseFloor, &impulseDelay);
 #ifdef DEBUG
-	printf("[I] refreshConvolver::IR channel count:%d, IR frame count:%d, Audio buffer size:%d\n", impChannels, impulseLengthActual, DSPbufferLength);
+	printf("[I] IR trimmed at %d dB: %d -> %d frames, %d frames of leading silence replaced by a delay line\n", irNoiseFloor, sourceLength, impulseLengthActual, impulseDelay);
 #endif
-	int i;
+}
+void EffectDSPMain::convolverCacheName(char *name, size_t nameSize, uint32_t DSPbufferLength)
+{
+	snprintf(name, nameSize, "ir-%016llx-%u-%d-%d-%d-%u-%c.spec", (unsigned long long)irContentHash, (unsigned)mSamplingRate, impChannels, impulseLengthSource, irNoiseFloor, DSPbufferLength, convolverSinglePrecision ? 'f' : 'd');
+}
+void EffectDSPMain::convolverCacheHeader(irCacheHeader_t *header, uint32_t DSPbufferLength)
+{
+	memset(header, 0, sizeof(irCacheHeader_t));
+	memcpy(header->magic, "JDSPIRC3", 8);
+	header->contentHash = irContentHash;
+	header->samplingRate = (int32_t)mSamplingRate;
+	header->channels = impChannels;
+	header->sourceLength = impulseLengthSource;
+	header->noiseFloor = irNoiseFloor;
+	header->blockLength = DSPbufferLength;
+	header->singlePrecision = convolverSinglePrecision;
+	header->hlen = impulseLengthActual;
+	header->delay = impulseDelay;
+	header->methods = convPlan.methods;
+	header->sflen = convPlan.sflen;
+	header->mflen = convPlan.mflen;
+	header->lflen = convPlan.lflen;
+	header->spectraSize = AutoConvolver1x1SpectraSize(&convPlan, impulseLengthActual, DSPbufferLength);
+}
+int EffectDSPMain::loadConvolverCache(uint32_t DSPbufferLength)
+{
+	irCacheHeader_t header, expected;
+	char name[128];
 	FreeConvolver();
-	if (!convolver)
+	convolverCacheName(name, sizeof(name), DSPbufferLength);
+	if (!DiskCacheMap(name, &irCache))
+		return 0;
+	if (irCache.size < sizeof(header))
 	{
-		if (impChannels < 3)
-		{
-			convolver = (AutoConvolver1x1**)malloc(sizeof(AutoConvolver1x1*) * 2);
-			if (!convolver)
-				return 0;
-			for (i = 0; i < 2; i++)
-			{
-				if (impChannels == 1)
-					convolver[i] = InitAutoConvolver1x1(finalImpulse[0], impulseLengthActual, DSPbufferLength, convGaindB, benchmarkValue, 12);
-				else
-					convolver[i] = InitAutoConvolver1x1(finalImpulse[i], impulseLengthActual, DSPbufferLength, convGaindB, benchmarkValue, 12);
-			}
-			fullStconvparams.conv = convolver;
-			fullStconvparams.out = outputBuffer;
-			if (finalImpulse)
-			{
-				for (i = 0; i < impChannels; i++)
-					free(finalImpulse[i]);
-				free(finalImpulse);
-				finalImpulse = 0;
-				free(tempImpulsedouble);
-				tempImpulsedouble = 0;
-			}
-			if (impulseLengthActual < 20000)
-				convolverReady = 1;
-			else
-				convolverReady = 2;
+		DiskCacheUnmap(&irCache);
+		return 0;
+	}
+	memcpy(&header, irCache.data, sizeof(header));
+	// Trimming depends on the file content only, its outcome is taken from the entry and the plan must agree with it
+	convolverCacheHeader(&expected, DSPbufferLength);
+	if (memcmp(&header, &expected, offsetof(irCacheHeader_t, hlen)) || header.hlen <= 0 || header.hlen > impulseLengthSource || header.delay < 0 || header.delay >= impulseLengthSource)
+	{
+		DiskCacheUnmap(&irCache);
+		return 0;
+	}
+	impulseLengthActual = header.hlen;
+	impulseDelay = header.delay;
+	planConvolver(DSPbufferLength);
+	convolverCacheHeader(&expected, DSPbufferLength);
+	size_t channels = impChannels == 4 ? 4 : impChannels;
+	if (convPlan.methods == 999 || memcmp(&header, &expected, sizeof(header)) || irCache.size != sizeof(header) + channels * header.spectraSize)
+	{
+		DiskCacheUnmap(&irCache);
+		return 0;
+	}
+	if (!allocateConvolver(DSPbufferLength, (const char*)irCache.data + sizeof(header), header.spectraSize))
+	{
+		FreeConvolver();
+		return 0;
+	}
 #ifdef DEBUG
-			printf("[I] Convolver strategy used: %d\n", convolver[0]->methods);
+	printf("[I] Convolver spectra mapped from cache %s\n", name);
 #endif
-		}
-		else if (impChannels == 4)
-		{
-			fullStereoConvolver = (AutoConvolver1x1**)malloc(sizeof(AutoConvolver1x1*) * 4);
-			if (!fullStereoConvolver)
-				return 0;
-			for (i = 0; i < 4; i++)
-				fullStereoConvolver[i] = InitAutoConvolver1x1(finalImpulse[i], impulseLengthActual, DSPbufferLength, convGaindB, benchmarkValue, 12);
-			fullStconvparams.conv = fullStereoConvolver;
-			fullStconvparams1.conv = fullStereoConvolver;
-			fullStconvparams.out = tempBuf;
-			fullStconvparams1.out = tempBuf;
-			if (finalImpulse)
-			{
-				for (i = 0; i < 4; i++)
-					free(finalImpulse[i]);
-				free(finalImpulse);
-				finalImpulse = 0;
-				free(tempImpulsedouble);
-				tempImpulsedouble = 0;
-			}
-			if (impulseLengthActual < 8192)
-				convolverReady = 3;
-			else
-				convolverReady = 4;
+	return 1;
+}
+void EffectDSPMain::storeConvolverCache(uint32_t DSPbufferLength)
+{
+	irCacheHeader_t header;
+	char name[128];
+	int i, channels = impChannels == 4 ? 4 : impChannels;
+	AutoConvolver1x1 **conv = impChannels == 4 ? fullStereoConvolver : convolver;
+	if (convPlan.methods == 999 || !conv)
+		return;
+	convolverCacheName(name, sizeof(name), DSPbufferLength);
+	convolverCacheHeader(&header, DSPbufferLength);
+	char *payload = (char*)malloc(channels * header.spectraSize);
+	if (!payload)
+		return;
+	for (i = 0; i < channels; i++)
+	{
+		if (AutoConvolver1x1ExportSpectra(conv[i], payload + i * header.spectraSize) != header.spectraSize)
+			break;
+	}
+	if (i == channels && DiskCacheStore(name, &header, sizeof(header), payload, channels * header.spectraSize))
+	{
 #ifdef DEBUG
-			printf("[I] Convolver strategy used: %d\n", fullStereoConvolver[0]->methods);
+		printf("[I] Convolver spectra stored to cache %s\n", name);
 #endif
-		}
-		ramp = 0.4;
+	}
+	free(payload);
+}
+int EffectDSPMain::refreshConvolver(uint32_t DSPbufferLength)
+{
+	if (!finalImpulse)
+		return 0;
 #ifdef DEBUG
-		printf("[I] Convolver IR allocate complete\n");
+	printf("[I] refreshConvolver::IR channel count:%d, IR frame count:%d, Audio buffer size:%d\n", impChannels, impulseLengthActual, DSPbufferLength);
 #endif
+	int i;
+	FreeConvolver();
+	planConvolver(DSPbufferLength);
+	if (!allocateConvolver(DSPbufferLength, 0, 0))
+	{
+		FreeConvolver();
+		return 0;
 	}
+	if (irContentHash)
+	{
+		storeConvolverCache(DSPbufferLength);
+		irContentHash = 0;
+	}
+	for (i = 0; i < impChannels; i++)
+		free(finalImpulse[i]);
+	free(finalImpulse);
+	finalImpulse = 0;
+	free(tempImpulsedouble);
+	tempImpulsedouble = 0;
+#ifdef DEBUG
+	printf("[I] Convolver IR allocate complete\n");
+#endif
 	return 1;
 }
 void EffectDSPMain::refreshStereoWiden(uint32_t m,uint32_t s)
@@ -1080,42 +1505,287 @@ void EffectDSPMain::refreshCompressor()
 	sf_advancecomp(&compressor, mSamplingRate, pregain, threshold, knee, ratio, attack, release, 0.003, 0.09, 0.16, 0.42, 0.98, -(pregain / 1.4));
 	ramp = 0.3;
 }
-void EffectDSPMain::refreshEqBands(uint32_t DSPbufferLength, double *bands)
+int EffectDSPMain::eqLength()
 {
-	if (!arbEq || !xaxis || !yaxis)
+	double lowest = interpFreq[0];
+	if (eqCustom.nodesCount)
+	{
+		// Sorted, a node at DC does not set the resolution
+		lowest = 0.0;
+		for (unsigned int i = 0; i < eqCustom.nodesCount && lowest <= 0.0; i++)
+			lowest = eqCustom.nodes[i]->freq;
+	}
+	return ArbitraryEqAutoFilterLength(lowest, mSamplingRate);
+}
+void EffectDSPMain::initEq()
+{
+	FreeEq();
+	eqFIRReady = 0;
+	if (eqFilterType == 2)
+	{
+		if (eqBandsValid || eqCustom.nodesCount)
+			refreshEqIIR();
 		return;
+	}
+	xaxis = (double*)malloc(1024 * sizeof(double));
+	yaxis = (double*)malloc(1024 * sizeof(double));
+	linspace(xaxis, 1024, interpFreq[0], interpFreq[NUM_BANDSM1]);
+	arbEq = (ArbitraryEq*)malloc(sizeof(ArbitraryEq));
+	eqfilterLength = eqLength();
+	InitArbitraryEq(arbEq, &eqfilterLength, eqFilterType);
 #ifdef DEBUG
-	printf("[I] Allocating FIR Equalizer\n");
+	printf("[I] FIR EQ Initialised: %d taps\n", eqfilterLength);
 #endif
-	double y2[NUM_BANDS];
-	double workingBuf[NUM_BANDSM1]; // interpFreq or bands data length minus 1
-	spline(&interpFreq[0], bands, NUM_BANDS, &y2[0], &workingBuf[0]);
-	splint(&interpFreq[0], bands, &y2[0], NUM_BANDS, xaxis, yaxis, 1024, 1);
-	int i;
-	for (i = 0; i < 1024; i++)
-		arbEq->nodes[i]->gain = yaxis[i];
-	double *eqImpulseResponse = arbEq->GetFilter(arbEq, mSamplingRate);
-	if (!FIREq)
+	// Bands set while the EQ was off or being rebuilt
+	if (eqBandsValid || eqCustom.nodesCount)
+		scheduleEqDesign();
+}
+void EffectDSPMain::_loadEqNodes(char *nodes)
+{
+	if (nodes && !*nodes)
+		nodes = 0;
+	if ((!nodes && !eqCustomString) || (nodes && eqCustomString && !strcmp(nodes, eqCustomString)))
+		return;
+	free(eqCustomString);
+	eqCustomString = nodes ? strdup(nodes) : 0;
+	int oldLength = arbEq ? (int)arbEq->filterLength : 0;
+	// The design worker copies the nodes under this lock
+	pthread_mutex_lock(&eqDesignLock);
+	EqNodesFree(&eqCustom);
+	if (eqCustomString)
+		ArbitraryEqString2SortedNodes(&eqCustom, eqCustomString);
+	pthread_mutex_unlock(&eqDesignLock);
+#ifdef DEBUG
+	printf("[I] EQ nodes: %u\n", eqCustom.nodesCount);
+#endif
+	if (!equalizerEnabled)
+		return;
+	if (eqFilterType == 2)
+		refreshEqIIR();
+	else if (arbEq && oldLength != eqLength())
+		initEq();
+	else
+		scheduleEqDesign();
+}
+void EffectDSPMain::refreshEqBands(double *bands)
+{
+	pthread_mutex_lock(&eqDesignLock);
+	if (eqBandsValid && !memcmp(eqBands, bands, sizeof(eqBands)))
 	{
-		FIREq = (AutoConvolver1x1**)malloc(sizeof(AutoConvolver1x1*) * NUMCHANNEL);
-		for (i = 0; i < NUMCHANNEL; i++)
-			FIREq[i] = AllocateAutoConvolver1x1ZeroLatency(eqImpulseResponse, eqfilterLength, DSPbufferLength);
+		pthread_mutex_unlock(&eqDesignLock);
+		return;
+	}
+	memcpy(eqBands, bands, sizeof(eqBands));
+	eqBandsValid = 1;
+	pthread_mutex_unlock(&eqDesignLock);
+	// A node list takes precedence, the bands are kept for when it is cleared
+	if (eqCustom.nodesCount)
+		return;
+	if (eqFilterType == 2)
+	{
+		// A handful of closed form sections, cheap enough to design right here
+		if (equalizerEnabled)
+			refreshEqIIR();
 	}
 	else
+		scheduleEqDesign();
+}
+void EffectDSPMain::refreshEqIIR()
+{
+	double bands[NUM_BANDS];
+	// Node lists are sampled at the band centres, the cascade has one section per band
+	for (int i = 0; i < NUM_BANDS; i++)
+		bands[i] = eqCustom.nodesCount ? gainAtLogGrid(&eqCustom, interpFreq[i]) : eqBands[i];
+	// Only coefficients change, the section states carry over
+	eqSOSCount = GraphicEqDesign(interpFreq, bands, NUM_BANDS, mSamplingRate, eqSOS);
+	SOSCascadeLoad(&eqCascade, eqSOSPointer, eqSOSCount);
+	eqIIRReady = 1;
+#ifdef DEBUG
+	printf("[I] IIR Equalizer: %d sections\n", eqSOSCount);
+#endif
+}
+void EffectDSPMain::scheduleEqDesign()
+{
+	if (!arbEq || !xaxis || !yaxis)
+		return;
+	if (!eqDesignRunning)
 	{
-		for (i = 0; i < NUMCHANNEL; i++)
-			UpdateAutoConvolver1x1ZeroLatency(FIREq[i], eqImpulseResponse, eqfilterLength);
+		eqDesignQuit = 0;
+		eqDesignPending = 0;
+		eqDesignDone = 0;
+		if (pthread_create(&eqDesignThread, 0, EffectDSPMain::threadingEqDesign, (void*)this))
+			return;
+		eqDesignRunning = 1;
+	}
+	pthread_mutex_lock(&eqDesignLock);
+	eqDesignPending = 1;
+	pthread_cond_signal(&eqDesignCond);
+	pthread_mutex_unlock(&eqDesignLock);
+}
+void EffectDSPMain::stopEqDesign()
+{
+	if (!eqDesignRunning)
+		return;
+	pthread_mutex_lock(&eqDesignLock);
+	eqDesignQuit = 1;
+	pthread_cond_signal(&eqDesignCond);
+	pthread_mutex_unlock(&eqDesignLock);
+	pthread_join(eqDesignThread, 0);
+	eqDesignRunning = 0;
+	eqDesignDone = 0;
+	if (eqDesignConv)
+	{
+		for (unsigned int i = 0; i < NUMCHANNEL; i++)
+		{
+			AutoConvolver1x1Free(eqDesignConv[i]);
+			free(eqDesignConv[i]);
+		}
+		free(eqDesignConv);
+		eqDesignConv = 0;
 	}
+}
+void *EffectDSPMain::threadingEqDesign(void *args)
+{
+	EffectDSPMain *dsp = (EffectDSPMain*)args;
+	ArbitraryEq *arbEq = dsp->arbEq;
+	double bands[NUM_BANDS], y2[NUM_BANDS];
+	double workingBuf[NUM_BANDSM1]; // interpFreq or bands data length minus 1
+	double *nodeFreq = 0, *nodeGain = 0;
+	unsigned int nodes = 0, nodesAllocated = 0;
+	struct timespec next = { 0, 0 }, now;
+	unsigned int i;
+	pthread_mutex_lock(&dsp->eqDesignLock);
+	for (;;)
+	{
+		while (!dsp->eqDesignPending && !dsp->eqDesignQuit)
+			pthread_cond_wait(&dsp->eqDesignCond, &dsp->eqDesignLock);
+		// Hold off until the previous design is old enough, requests arriving meanwhile replace the bands
+		while (!dsp->eqDesignQuit)
+		{
+			clock_gettime(CLOCK_REALTIME, &now);
+			if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec >= next.tv_nsec))
+				break;
+			pthread_cond_timedwait(&dsp->eqDesignCond, &dsp->eqDesignLock, &next);
+		}
+		if (dsp->eqDesignQuit)
+			break;
+		memcpy(bands, dsp->eqBands, sizeof(bands));
+		nodes = dsp->eqCustom.nodesCount;
+		if (nodes > nodesAllocated)
+		{
+			nodeFreq = (double*)realloc(nodeFreq, nodes * sizeof(double));
+			nodeGain = (double*)realloc(nodeGain, nodes * sizeof(double));
+			nodesAllocated = nodes;
+		}
+		for (i = 0; i < nodes; i++)
+		{
+			nodeFreq[i] = dsp->eqCustom.nodes[i]->freq;
+			nodeGain[i] = dsp->eqCustom.nodes[i]->gain;
+		}
+		dsp->eqDesignPending = 0;
+		// A design not picked up yet is superseded, the audio thread leaves eqDesignConv alone until this one is done
+		dsp->eqDesignDone = 0;
+		pthread_mutex_unlock(&dsp->eqDesignLock);
+		if (nodes)
+			ArbitraryEqSetNodes(arbEq, nodeFreq, nodeGain, nodes);
+		else
+		{
+			spline(&interpFreq[0], bands, NUM_BANDS, &y2[0], &workingBuf[0]);
+			splint(&interpFreq[0], bands, &y2[0], NUM_BANDS, dsp->xaxis, dsp->yaxis, 1024, 1);
+			ArbitraryEqSetNodes(arbEq, dsp->xaxis, dsp->yaxis, 1024);
+		}
+		double *eqImpulseResponse = arbEq->GetFilter(arbEq, dsp->mSamplingRate);
+		// Allocation and partition transforms stay here, the audio thread only exchanges pointers
+		if (!dsp->eqDesignConv)
+		{
+			AutoConvolver1x1 **conv = (AutoConvolver1x1**)malloc(sizeof(AutoConvolver1x1*) * NUMCHANNEL);
+			for (i = 0; i < NUMCHANNEL; i++)
+				conv[i] = AllocateAutoConvolver1x1ZeroLatency(eqImpulseResponse, dsp->eqfilterLength, dsp->DSPbufferLength);
+			dsp->eqDesignConv = conv;
+		}
+		else
+		{
+			for (i = 0; i < NUMCHANNEL; i++)
+				UpdateAutoConvolver1x1ZeroLatency(dsp->eqDesignConv[i], eqImpulseResponse, dsp->eqfilterLength);
+		}
+		pthread_mutex_lock(&dsp->eqDesignLock);
+		dsp->eqDesignDone = 1;
+		clock_gettime(CLOCK_REALTIME, &next);
+		next.tv_nsec += EQ_DESIGN_INTERVAL * 1000000L;
+		if (next.tv_nsec >= 1000000000L)
+		{
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+	}
+	pthread_mutex_unlock(&dsp->eqDesignLock);
+	free(nodeFreq);
+	free(nodeGain);
+	return 0;
+}
+void EffectDSPMain::applyEqDesign()
+{
+	// Called from process, a design still being handed over is picked up on the next buffer instead of waiting for it
+	if (!eqDesignRunning || pthread_mutex_trylock(&eqDesignLock))
+		return;
+	if (eqDesignDone)
+	{
+		if (!FIREq)
+		{
+			FIREq = eqDesignConv;
+			eqDesignConv = 0;
+		}
+		else
+		{
+			// The worker keeps the previous filter to build the next design into
+			for (int i = 0; i < NUMCHANNEL; i++)
+			{
+				if (!SwapAutoConvolver1x1ZeroLatency(FIREq[i], eqDesignConv[i]))
+				{
+					AutoConvolver1x1 *conv = FIREq[i];
+					FIREq[i] = eqDesignConv[i];
+					eqDesignConv[i] = conv;
+				}
+			}
+		}
 #ifdef DEBUG
-	printf("[I] FIR Equalizer allocate all done: total taps %d\n", eqfilterLength);
+		printf("[I] FIR Equalizer allocate all done: total taps %d\n", eqfilterLength);
 #endif
-	eqFIRReady = 1;
+		eqDesignDone = 0;
+		eqFIRReady = 1;
+	}
+	pthread_mutex_unlock(&eqDesignLock);
 }
 void EffectDSPMain::refreshReverb()
 {
-	sf_advancereverb(&myreverb,mSamplingRate,r->oversamplefactor,r->ertolate,r->erefwet
+	// The delay memory is only held while the reverb is on, and only by the engine in use
+	if (!reverbEnabled)
+	{
+		sf_reverb_free(&myreverb);
+		FDNReverbFree(&fdnReverb);
+		return;
+	}
+	if (reverbEngine)
+	{
+		sf_reverb_free(&myreverb);
+		if (!FDNReverbInit(&fdnReverb, mSamplingRate, r->ertolate, r->erefwet, r->dry, r->ereffactor, r->erefwidth, r->width, r->wet,
+			r->inputlpf, r->damplpf, r->outputlpf, r->rt60, r->delay))
+			printf("[E] Reverb delay memory could not be allocated\n");
+#ifdef DEBUG
+		else
+			printf("[I] FDN reverb delay memory: %.2f Mb\n", fdnReverb.memSize * sizeof(double) / 1024.0 / 1024.0);
+#endif
+		return;
+	}
+	FDNReverbFree(&fdnReverb);
+	if (!sf_advancereverb(&myreverb,mSamplingRate,r->oversamplefactor,r->ertolate,r->erefwet
 	        ,r->dry,r->ereffactor,r->erefwidth,r->width,r->wet,r->wander,r->bassb,
-	        r->spin,r->inputlpf,r->basslpf,r->damplpf,r->outputlpf,r->rt60,r->delay);
+	        r->spin,r->inputlpf,r->basslpf,r->damplpf,r->outputlpf,r->rt60,r->delay))
+		printf("[E] Reverb delay memory could not be allocated\n");
+#ifdef DEBUG
+	else
+		printf("[I] Reverb delay memory: %.2f Mb\n", myreverb.memsize * sizeof(double) / 1024.0 / 1024.0);
+#endif
 	//sf_presetreverb(&myreverb, mSamplingRate, (sf_reverb_preset)mPreset);
 }
 void *EffectDSPMain::threadingConvF(void *args)
@@ -1124,6 +1794,13 @@ void *EffectDSPMain::threadingConvF(void *args)
 	arguments->conv[0]->process(arguments->conv[0], arguments->in[0], arguments->out[0], arguments->frameCount);
 	return 0;
 }
+void *EffectDSPMain::threadingConvF01(void *args)
+{
+	ptrThreadParamsFullStConv *arguments = (ptrThreadParamsFullStConv*)args;
+	arguments->conv[0]->process(arguments->conv[0], arguments->in[0], arguments->out[0], arguments->frameCount);
+	arguments->conv[1]->process(arguments->conv[1], arguments->in[0], arguments->out[1], arguments->frameCount);
+	return 0;
+}
 void *EffectDSPMain::threadingConvF1(void *args)
 {
 	ptrThreadParamsFullStConv *arguments = (ptrThreadParamsFullStConv*)args;
@@ -1147,6 +1824,7 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 
 	int i, framePos, framePos2x, actualFrameCount = in->frameCount;
 	int pos = inOutRWPosition;
+	applyEqDesign();
 	switch (formatFloatModeInt32Mode)
 	{
 	case 0:
@@ -1175,17 +1853,17 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				{
 					if (bassLpReady > 0)
 					{
-						bassBoostLp[0]->process(bassBoostLp[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						bassBoostLp[1]->process(bassBoostLp[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(bassBoostLp, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
 				}
 				if (equalizerEnabled)
 				{
 					if (eqFIRReady == 1)
 					{
-						FIREq[0]->process(FIREq[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						FIREq[1]->process(FIREq[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(FIREq, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
+					else if (eqIIRReady)
+						SOSCascadeProcess(&eqCascade, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (stereoWidenEnabled)
 				{
@@ -1200,15 +1878,16 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				}
 				if (reverbEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-						sf_reverb_process(&myreverb, inputBuffer[0][i], inputBuffer[1][i], &inputBuffer[0][i], &inputBuffer[1][i]);
+					if (reverbEngine)
+						FDNReverbProcess(&fdnReverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
+					else
+						sf_reverb_process_block(&myreverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (convolverEnabled)
 				{
 					if (convolverReady == 1)
 					{
-						convolver[0]->process(convolver[0], inputBuffer[0], outputBuffer[0], DSPbufferLength);
-						convolver[1]->process(convolver[1], inputBuffer[1], outputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(convolver, inputBuffer, outputBuffer, 2, DSPbufferLength);
 						memcpy(inputBuffer[0], outputBuffer[0], memSize);
 						memcpy(inputBuffer[1], outputBuffer[1], memSize);
 					}
@@ -1222,8 +1901,7 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					}
 					else if (convolverReady == 3)
 					{
-						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
-						fullStereoConvolver[1]->process(fullStereoConvolver[1], inputBuffer[0], tempBuf[1], DSPbufferLength);
+						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF01, (void*)&fullStconvparams);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
 						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
@@ -1237,10 +1915,22 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					{
 						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
 						pthread_create(&rightconv1, 0, EffectDSPMain::threadingConvF1, (void*)&fullStconvparams1);
+						pthread_create(&rightconv2, 0, EffectDSPMain::threadingConvF2, (void*)&fullStconvparams2);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
-						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
 						pthread_join(rightconv1, 0);
+						pthread_join(rightconv2, 0);
+						for (i = 0; i < DSPbufferLength; i++)
+						{
+							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
+							inputBuffer[1][i] = outputBuffer[1][i] + tempBuf[1][i];
+						}
+					}
+					else if (convolverReady == 5)
+					{
+						double *trueStereoIn[4] = { inputBuffer[0], inputBuffer[0], inputBuffer[1], inputBuffer[1] };
+						double *trueStereoOut[4] = { tempBuf[0], tempBuf[1], outputBuffer[0], outputBuffer[1] };
+						AutoConvolver1x1ProcessBatch(fullStereoConvolver, trueStereoIn, trueStereoOut, 4, DSPbufferLength);
 						for (i = 0; i < DSPbufferLength; i++)
 						{
 							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
@@ -1265,14 +1955,10 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					sf_compressor_process(&compressor, DSPbufferLength, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1]);
 				if (viperddcEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-					{
-						double sampleOutL = inputBuffer[0][i], sampleOutR = inputBuffer[1][i];
-						for (int j = 0; j < usedSOSCount; j++)
-							SOS_DF2_StereoProcess(sosPointer[j], sampleOutL, sampleOutR, &sampleOutL, &sampleOutR);
-						outputBuffer[0][i] = sampleOutL;
-						outputBuffer[1][i] = sampleOutR;
-					}
+					if (ddcFIRReady)
+						AutoConvolver1x1ProcessBatch(ddcFIR, inputBuffer, outputBuffer, 2, DSPbufferLength);
+					else
+						SOSCascadeProcess(&ddcCascade, inputBuffer[0], inputBuffer[1], outputBuffer[0], outputBuffer[1], DSPbufferLength);
 				}
 				else
 				{
@@ -1309,17 +1995,17 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				{
 					if (bassLpReady > 0)
 					{
-						bassBoostLp[0]->process(bassBoostLp[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						bassBoostLp[1]->process(bassBoostLp[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(bassBoostLp, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
 				}
 				if (equalizerEnabled)
 				{
 					if (eqFIRReady == 1)
 					{
-						FIREq[0]->process(FIREq[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						FIREq[1]->process(FIREq[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(FIREq, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
+					else if (eqIIRReady)
+						SOSCascadeProcess(&eqCascade, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (stereoWidenEnabled)
 				{
@@ -1334,15 +2020,16 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				}
 				if (reverbEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-						sf_reverb_process(&myreverb, inputBuffer[0][i], inputBuffer[1][i], &inputBuffer[0][i], &inputBuffer[1][i]);
+					if (reverbEngine)
+						FDNReverbProcess(&fdnReverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
+					else
+						sf_reverb_process_block(&myreverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (convolverEnabled)
 				{
 					if (convolverReady == 1)
 					{
-						convolver[0]->process(convolver[0], inputBuffer[0], outputBuffer[0], DSPbufferLength);
-						convolver[1]->process(convolver[1], inputBuffer[1], outputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(convolver, inputBuffer, outputBuffer, 2, DSPbufferLength);
 						memcpy(inputBuffer[0], outputBuffer[0], memSize);
 						memcpy(inputBuffer[1], outputBuffer[1], memSize);
 					}
@@ -1356,8 +2043,7 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					}
 					else if (convolverReady == 3)
 					{
-						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
-						fullStereoConvolver[1]->process(fullStereoConvolver[1], inputBuffer[0], tempBuf[1], DSPbufferLength);
+						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF01, (void*)&fullStconvparams);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
 						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
@@ -1371,10 +2057,22 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					{
 						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
 						pthread_create(&rightconv1, 0, EffectDSPMain::threadingConvF1, (void*)&fullStconvparams1);
+						pthread_create(&rightconv2, 0, EffectDSPMain::threadingConvF2, (void*)&fullStconvparams2);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
-						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
 						pthread_join(rightconv1, 0);
+						pthread_join(rightconv2, 0);
+						for (i = 0; i < DSPbufferLength; i++)
+						{
+							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
+							inputBuffer[1][i] = outputBuffer[1][i] + tempBuf[1][i];
+						}
+					}
+					else if (convolverReady == 5)
+					{
+						double *trueStereoIn[4] = { inputBuffer[0], inputBuffer[0], inputBuffer[1], inputBuffer[1] };
+						double *trueStereoOut[4] = { tempBuf[0], tempBuf[1], outputBuffer[0], outputBuffer[1] };
+						AutoConvolver1x1ProcessBatch(fullStereoConvolver, trueStereoIn, trueStereoOut, 4, DSPbufferLength);
 						for (i = 0; i < DSPbufferLength; i++)
 						{
 							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
@@ -1399,14 +2097,10 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					sf_compressor_process(&compressor, DSPbufferLength, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1]);
 				if (viperddcEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-					{
-						double sampleOutL = inputBuffer[0][i], sampleOutR = inputBuffer[1][i];
-						for (int j = 0; j < usedSOSCount; j++)
-							SOS_DF2_StereoProcess(sosPointer[j], sampleOutL, sampleOutR, &sampleOutL, &sampleOutR);
-						outputBuffer[0][i] = sampleOutL;
-						outputBuffer[1][i] = sampleOutR;
-					}
+					if (ddcFIRReady)
+						AutoConvolver1x1ProcessBatch(ddcFIR, inputBuffer, outputBuffer, 2, DSPbufferLength);
+					else
+						SOSCascadeProcess(&ddcCascade, inputBuffer[0], inputBuffer[1], outputBuffer[0], outputBuffer[1], DSPbufferLength);
 				}
 				else
 
@@ -1444,17 +2138,17 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				{
 					if (bassLpReady > 0)
 					{
-						bassBoostLp[0]->process(bassBoostLp[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						bassBoostLp[1]->process(bassBoostLp[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(bassBoostLp, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
 				}
 				if (equalizerEnabled)
 				{
 					if (eqFIRReady == 1)
 					{
-						FIREq[0]->process(FIREq[0], inputBuffer[0], inputBuffer[0], DSPbufferLength);
-						FIREq[1]->process(FIREq[1], inputBuffer[1], inputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(FIREq, inputBuffer, inputBuffer, 2, DSPbufferLength);
 					}
+					else if (eqIIRReady)
+						SOSCascadeProcess(&eqCascade, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (stereoWidenEnabled)
 				{
@@ -1469,15 +2163,16 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 				}
 				if (reverbEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-						sf_reverb_process(&myreverb, inputBuffer[0][i], inputBuffer[1][i], &inputBuffer[0][i], &inputBuffer[1][i]);
+					if (reverbEngine)
+						FDNReverbProcess(&fdnReverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
+					else
+						sf_reverb_process_block(&myreverb, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1], DSPbufferLength);
 				}
 				if (convolverEnabled)
 				{
 					if (convolverReady == 1)
 					{
-						convolver[0]->process(convolver[0], inputBuffer[0], outputBuffer[0], DSPbufferLength);
-						convolver[1]->process(convolver[1], inputBuffer[1], outputBuffer[1], DSPbufferLength);
+						AutoConvolver1x1ProcessBatch(convolver, inputBuffer, outputBuffer, 2, DSPbufferLength);
 						memcpy(inputBuffer[0], outputBuffer[0], memSize);
 						memcpy(inputBuffer[1], outputBuffer[1], memSize);
 					}
@@ -1491,8 +2186,7 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					}
 					else if (convolverReady == 3)
 					{
-						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
-						fullStereoConvolver[1]->process(fullStereoConvolver[1], inputBuffer[0], tempBuf[1], DSPbufferLength);
+						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF01, (void*)&fullStconvparams);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
 						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
@@ -1506,10 +2200,22 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					{
 						pthread_create(&rightconv, 0, EffectDSPMain::threadingConvF, (void*)&fullStconvparams);
 						pthread_create(&rightconv1, 0, EffectDSPMain::threadingConvF1, (void*)&fullStconvparams1);
+						pthread_create(&rightconv2, 0, EffectDSPMain::threadingConvF2, (void*)&fullStconvparams2);
 						fullStereoConvolver[2]->process(fullStereoConvolver[2], inputBuffer[1], outputBuffer[0], DSPbufferLength);
-						fullStereoConvolver[3]->process(fullStereoConvolver[3], inputBuffer[1], outputBuffer[1], DSPbufferLength);
 						pthread_join(rightconv, 0);
 						pthread_join(rightconv1, 0);
+						pthread_join(rightconv2, 0);
+						for (i = 0; i < DSPbufferLength; i++)
+						{
+							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
+							inputBuffer[1][i] = outputBuffer[1][i] + tempBuf[1][i];
+						}
+					}
+					else if (convolverReady == 5)
+					{
+						double *trueStereoIn[4] = { inputBuffer[0], inputBuffer[0], inputBuffer[1], inputBuffer[1] };
+						double *trueStereoOut[4] = { tempBuf[0], tempBuf[1], outputBuffer[0], outputBuffer[1] };
+						AutoConvolver1x1ProcessBatch(fullStereoConvolver, trueStereoIn, trueStereoOut, 4, DSPbufferLength);
 						for (i = 0; i < DSPbufferLength; i++)
 						{
 							inputBuffer[0][i] = outputBuffer[0][i] + tempBuf[0][i];
@@ -1534,14 +2240,10 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 					sf_compressor_process(&compressor, DSPbufferLength, inputBuffer[0], inputBuffer[1], inputBuffer[0], inputBuffer[1]);
 				if (viperddcEnabled)
 				{
-					for (i = 0; i < DSPbufferLength; i++)
-					{
-						double sampleOutL = inputBuffer[0][i], sampleOutR = inputBuffer[1][i];
-						for (int j = 0; j < usedSOSCount; j++)
-							SOS_DF2_StereoProcess(sosPointer[j], sampleOutL, sampleOutR, &sampleOutL, &sampleOutR);
-						outputBuffer[0][i] = sampleOutL;
-						outputBuffer[1][i] = sampleOutR;
-					}
+					if (ddcFIRReady)
+						AutoConvolver1x1ProcessBatch(ddcFIR, inputBuffer, outputBuffer, 2, DSPbufferLength);
+					else
+						SOSCascadeProcess(&ddcCascade, inputBuffer[0], inputBuffer[1], outputBuffer[0], outputBuffer[1], DSPbufferLength);
 				}
 				else
 				{
@@ -1558,50 +2260,56 @@ int32_t EffectDSPMain::process(audio_buffer_t *in, audio_buffer_t *out)
 }
 void EffectDSPMain::_loadDDC(char* ddc_str){
 
-    stringEq = (char*)calloc(strlen(ddc_str), sizeof(char));
-    strcpy(stringEq,ddc_str);
-    if (!viperddcEnabled)
-    {
-        if (sosCount)
-        {
-            for (int i = 0; i < sosCount; i++)
-            {
-                free(df441[i]);
-                free(df48[i]);
-            }
-            free(df441);
-            df441 = 0;
-            free(df48);
-            df48 = 0;
-            sosCount = 0;
-            if (resampledSOSCount)
-            {
-                for (int i = 0; i < resampledSOSCount; i++)
-                    free(dfResampled[i]);
-                free(dfResampled);
-                dfResampled = 0;
-                resampledSOSCount = 0;
-            }
-            sosPointer = 0;
-        }
-    }
+    // The cascade keeps its own copy, so the old sections can go even while the DDC is running
+    FreeDDC();
 
-    sosCount = DDCParser(stringEq, &df441, &df48);
+    sosCount = DDCParser(ddc_str, &df441, &df48);
 
 #ifdef DEBUG
     printf("[I] VDC num of SOS: %d\n", sosCount);
-	printf("VDC df48[0].b0: %1.14f\n", (float)df48[0]->b0);
 #endif
-    free(stringEq);
-    stringEq = 0;
+    if (sosCount && ddcContentHash)
+    {
+        // Compile the current rate's retarget into the entry too, command 1212 then finds it ready
+        if (mSamplingRate != 44100 && mSamplingRate != 48000)
+        {
+            resampledSOSCount = PeakingFilterResampler(df48, 48000.0, &dfResampled, mSamplingRate, sosCount);
+            resampledFs = mSamplingRate;
+        }
+        storeDDCCache();
+    }
+    ddcContentHash = 0;
     return;
 }
+int EffectDSPMain::_loadDDCCached(uint64_t contentHash){
+    ddcContentHash = contentHash;
+    if (!loadDDCCache())
+        return 0;
+    ddcContentHash = 0;
+    return 1;
+}
 void EffectDSPMain::_loadReverb(reverbdata_t *r2){
+    free(r);
     r = r2;
     refreshReverb();
     return;
 }
-void EffectDSPMain::_loadConv(int impulseCutted,int channels,float convGaindB,float* ir){
+int EffectDSPMain::_loadConvCached(uint64_t contentHash, int frames, int channels, float convGaindB, int noiseFloor){
+    impChannels = channels;
+    previousimpChannels = impChannels;
+    impulseLengthActual = frames;
+    impulseLengthSource = frames;
+    irNoiseFloor = noiseFloor;
+    if (convGaindB > 50.0)
+        convGaindB = 50.0;
+    this->convGaindB = convGaindB;
+    irContentHash = contentHash;
+    if (!loadConvolverCache(DSPbufferLength))
+        return 0;
+    irContentHash = 0;
+    return 1;
+}
+void EffectDSPMain::_loadConv(int impulseCutted,int channels,float convGaindB,float* ir,int noiseFloor){
 
     impChannels = channels;
 
@@ -1610,15 +2318,11 @@ void EffectDSPMain::_loadConv(int impulseCutted,int channels,float convGaindB,fl
     impulseLengthActual = impulseCutted / impChannels;
     if (convGaindB > 50.0)
         convGaindB = 50.0;
+    this->convGaindB = convGaindB;
+    irNoiseFloor = noiseFloor;
 
     //10004: COMPLETE
-    int i, j, tempbufValue;
-    tempbufValue = impulseLengthActual * impChannels;
-
-    double *finalIR = (double*)malloc(tempbufValue * sizeof(double));
-    for(int i=0;i<tempbufValue;i++){
-        finalIR[i] = (double)ir[i];
-    }
+    int i, j;
 
     if (finalImpulse)
     {
@@ -1630,26 +2334,24 @@ void EffectDSPMain::_loadConv(int impulseCutted,int channels,float convGaindB,fl
     if (!finalImpulse)
     {
 
-        finalImpulse = (double**)malloc(impChannels * sizeof(double*));
+        finalImpulse = (double**)calloc(impChannels, sizeof(double*));
         for (i = 0; i < impChannels; i++)
         {
             double* channelbuf = (double*)malloc(impulseLengthActual * sizeof(double));
             if (!channelbuf)
-            {
-                convolverReady = -1;
-                convolverEnabled = !convolverEnabled;
-                free(finalImpulse);
-                finalImpulse = 0;
-            }
-            double* p = finalIR + i;
+                break;
+            float* p = ir + i;
             for (j = 0; j < impulseLengthActual; j++)
-                channelbuf[j] = p[j * impChannels];
+                channelbuf[j] = (double)p[j * impChannels];
             finalImpulse[i] = channelbuf;
         }
-        if (!refreshConvolver(DSPbufferLength))
+        if (i == impChannels)
+            trimImpulse();
+        if (i < impChannels || !refreshConvolver(DSPbufferLength))
         {
             convolverReady = -1;
             convolverEnabled = !convolverEnabled;
+            irContentHash = 0;
             if (finalImpulse)
             {
                 for (i = 0; i < impChannels; i++)
@@ -1657,11 +2359,6 @@ void EffectDSPMain::_loadConv(int impulseCutted,int channels,float convGaindB,fl
                 free(finalImpulse);
                 finalImpulse = 0;
             }
-            if (finalIR)
-            {
-                free(finalIR);
-                finalIR = 0;
-            }
         }
     }
-}
\ No newline at end of file
+}
@@ -11,7 +11,9 @@ extern "C"
 #include "vdc.h"
 #include "compressor.h"
 #include "reverb.h"
+#include "FDNReverb.h"
 #include "AutoConvolver.h"
+#include "DiskCache.h"
 #include "valve/12ax7amp/Tube.h"
 #include "JLimiter.h"
 //#include "valve/wavechild670/wavechild670.h"
@@ -45,6 +47,12 @@ protected:
 	char *stringEq;
 	DirectForm2 **df441, **df48, **dfResampled, **sosPointer;
 	int sosCount, resampledSOSCount, usedSOSCount;
+	double resampledFs;
+	uint64_t ddcContentHash;
+	SOSCascade ddcCascade;
+	// Long DDCs whose impulse response is cheaper to convolve than to recurse run as a zero latency FIR instead
+	AutoConvolver1x1 **ddcFIR;
+	int ddcFIRReady;
 	typedef struct threadParamsConv {
 		AutoConvolver1x1 **conv;
 		double **in, **out;
@@ -56,12 +64,14 @@ protected:
 		size_t frameCount;
 	} ptrThreadParamsTube;
 	static void *threadingConvF(void *args);
+	static void *threadingConvF01(void *args);
 	static void *threadingConvF1(void *args);
 	static void *threadingConvF2(void *args);
 	static void *threadingTube(void *args);
-	ptrThreadParamsFullStConv fullStconvparams, fullStconvparams1;
+	static void *threadingEqDesign(void *args);
+	ptrThreadParamsFullStConv fullStconvparams, fullStconvparams1, fullStconvparams2;
 	ptrThreadParamsTube rightparams2;
-	pthread_t rightconv, rightconv1, righttube;
+	pthread_t rightconv, rightconv1, rightconv2, righttube;
 	int DSPbufferLength, inOutRWPosition;
 	size_t memSize;
 	// double buffer
@@ -73,8 +83,15 @@ protected:
 	JLimiter kLimiter;
 	sf_compressor_state_st compressor;
 	sf_reverb_state_st myreverb;
+	// Low CPU reverb on the same parameters, runs instead of myreverb while reverbEngine is 1
+	FDNReverb fdnReverb;
 	AutoConvolver1x1 **bassBoostLp;
 	AutoConvolver1x1 **convolver, **fullStereoConvolver;
+	ConvolverPlan convPlan;
+	uint64_t irContentHash;
+	DiskCacheMapping irCache;
+	int32_t impulseLengthSource, impulseDelay, irNoiseFloor;
+	int convolverSinglePrecision;
 	tubeFilter tubeP[2];
 	t_bs2bdp bs2b;
 //	Wavechild670 *compressor670;
@@ -82,10 +99,25 @@ protected:
 	double *xaxis, *yaxis;
 	int eqfilterLength;
 	AutoConvolver1x1 **FIREq;
+	// FIR EQ designs run on a worker, band updates in between are coalesced and only the latest one is designed
+	pthread_t eqDesignThread;
+	pthread_mutex_t eqDesignLock;
+	pthread_cond_t eqDesignCond;
+	int eqDesignRunning, eqDesignQuit, eqDesignPending, eqDesignDone, eqBandsValid;
+	double eqBands[NUM_BANDS];
+	// Convolvers the worker builds each design into, handed to FIREq whole the first time and swapped with it after that
+	AutoConvolver1x1 **eqDesignConv;
+	// Filter type 2, matched biquad cascade run in place of the FIR
+	DirectForm2 eqSOS[NUM_BANDS], *eqSOSPointer[NUM_BANDS];
+	int eqSOSCount, eqIIRReady;
+	SOSCascade eqCascade;
+	// Node list from tone-nodes, replaces the bands while set. Only the nodes of the struct are used
+	ArbitraryEq eqCustom;
+	char *eqCustomString;
 	// Variables
 	double pregain, threshold, knee, ratio, attack, release, tubedrive, bassBoostCentreFreq, convGaindB, mMatrixMCoeff, mMatrixSCoeff;
 	int16_t bassBoostStrength, bassBoostFilterType, eqFilterType, bs2bLv, compressionEnabled, bassBoostEnabled, equalizerEnabled, reverbEnabled,
-	stereoWidenEnabled, convolverEnabled, convolverReady, bassLpReady, eqFIRReady, analogModelEnable, bs2bEnabled, viperddcEnabled;
+	stereoWidenEnabled, reverbEngine, convolverEnabled, convolverReady, bassLpReady, eqFIRReady, analogModelEnable, bs2bEnabled, viperddcEnabled;
 	int16_t mPreset, samplesInc, stringIndex, impChannels, previousimpChannels;
 
 
@@ -98,14 +130,33 @@ protected:
 	double *benchmarkValue[2];
 	void FreeBassBoost();
 	void FreeEq();
+	void FreeDDC();
+	void FreeDDCFIR();
+	void refreshDDCStrategy();
+	int loadDDCCache();
+	void storeDDCCache();
 	void FreeConvolver();
 	void channel_splitFloat(const float *buffer, unsigned int num_frames, float **chan_buffers, unsigned int num_channels);
 	void refreshTubeAmp();
 	void refreshBassLinearPhase(uint32_t actualframeCount, uint32_t tapsLPFIR, double bassBoostCentreFreq);
 	int refreshConvolver(uint32_t actualframeCount);
+	void planConvolver(uint32_t actualframeCount);
+	int buildConvolvers(AutoConvolver1x1 **conv, int instances, uint32_t actualframeCount, const void *spectra, size_t spectraSize);
+	int allocateConvolver(uint32_t actualframeCount, const void *spectra, size_t spectraSize);
+	void trimImpulse();
+	void convolverCacheName(char *name, size_t nameSize, uint32_t actualframeCount);
+	void convolverCacheHeader(struct irCacheHeader_s *header, uint32_t actualframeCount);
+	int loadConvolverCache(uint32_t actualframeCount);
+	void storeConvolverCache(uint32_t actualframeCount);
 	void refreshStereoWiden(uint32_t m,uint32_t s);
 	void refreshCompressor();
-	void refreshEqBands(uint32_t actualframeCount, double *bands);
+	void refreshEqBands(double *bands);
+	void scheduleEqDesign();
+	void stopEqDesign();
+	void applyEqDesign();
+	void refreshEqIIR();
+	void initEq();
+	int eqLength();
 	void refreshReverb();
 	inline double map(double x, double in_min, double in_max, double out_min, double out_max)
 	{
@@ -117,8 +168,11 @@ public:
 	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
 	int32_t process(audio_buffer_t *in, audio_buffer_t *out);
 	void _loadDDC(char*);
+	int _loadDDCCached(uint64_t contentHash);
+	void _loadEqNodes(char *nodes);
     void _loadReverb(reverbdata_t *r2);
-    void _loadConv(int impulseCutted,int impChannels,float convGaindB,float* ir);
+    void _loadConv(int impulseCutted,int impChannels,float convGaindB,float* ir,int noiseFloor);
+    int _loadConvCached(uint64_t contentHash,int frames,int impChannels,float convGaindB,int noiseFloor);
 
     };
 typedef struct dsp_config_s
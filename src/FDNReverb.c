@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "FDNReverb.h"
+#include "VectorMath.h"
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+// Frames stepped per pass, never more than the shortest line so a pass only reads samples written before it
+#define FDN_BLOCK 128
+// Line lengths in ms at a room size of 1, ascending and spread over less than an octave
+static const double lineMs[FDN_LINES] = { 29.3, 31.9, 35.3, 38.9, 42.7, 46.3, 50.9, 55.1 };
+static const double erMs[2][FDN_ER_TAPS] = {
+	{ 4.3, 9.7, 14.9, 21.1, 27.7, 35.3 },
+	{ 5.1, 11.3, 16.7, 23.9, 30.1, 38.3 }
+};
+static const double erLevel[FDN_ER_TAPS] = { 0.84, 0.71, 0.59, 0.48, 0.38, 0.30 };
+// Input signs per vector keep the injection orthogonal to the output taps, which read the line outputs before the mix
+static const v2d inSign[FDN_LINES / 2] = { { 1.0, 1.0 }, { -1.0, -1.0 }, { 1.0, 1.0 }, { -1.0, -1.0 } };
+static const v2d outSign[FDN_LINES / 2] = { { 1.0, 1.0 }, { 1.0, 1.0 }, { -1.0, -1.0 }, { -1.0, -1.0 } };
+// Brings the late level to that of Progenitor2 at equal wet gain
+#define FDN_LATE_GAIN 0.24
+static int isPrime(int n)
+{
+	if (n < 2)
+		return 0;
+	for (int d = 2; d * d <= n; d++)
+		if (!(n % d))
+			return 0;
+	return 1;
+}
+static int nextPrime(int n)
+{
+	while (!isPrime(n))
+		n++;
+	return n;
+}
+static double clampd(double x, double lo, double hi)
+{
+	return x < lo ? lo : (x > hi ? hi : x);
+}
+static double onePoleCoef(double fc, int fs)
+{
+	return exp(-2.0 * M_PI * clampd(fc, 10.0, 0.45 * fs) / fs);
+}
+int FDNReverbInit(FDNReverb *fdn, int fs, double ertolate, double erefwet, double dry, double ereffactor, double erefwidth, double width, double wet,
+	double inputlpf, double damplpf, double outputlpf, double rt60, double delay)
+{
+	double size, erNorm = 0.0, *p;
+	size_t need;
+	int i, ch, maxTap = 0;
+	ereffactor = clampd(ereffactor, 0.5, 2.5);
+	rt60 = clampd(rt60, 0.1, 30.0);
+	delay = clampd(delay, -0.5, 0.5);
+	// Modal density falls with the line lengths, so the room size only scales them by its square root
+	size = sqrt(ereffactor);
+	need = 0;
+	for (i = 0; i < FDN_LINES; i++)
+	{
+		int length = nextPrime((int)(lineMs[i] * 0.001 * size * fs) + 1);
+		if (i && length <= fdn->length[i - 1])
+			length = nextPrime(fdn->length[i - 1] + 1);
+		fdn->length[i] = length;
+		fdn->gain[i] = pow(10.0, -3.0 * length / (rt60 * fs));
+		need += length;
+	}
+	fdn->minLength = fdn->length[0];
+	// Positive delays hold back the reverb, negative ones the dry signal
+	fdn->preDelay = delay > 0.0 ? (int)(delay * fs + 0.5) : 0;
+	fdn->dryDelay = delay < 0.0 ? (int)(-delay * fs + 0.5) : 0;
+	for (ch = 0; ch < 2; ch++)
+		for (i = 0; i < FDN_ER_TAPS; i++)
+		{
+			fdn->erTap[ch][i] = fdn->preDelay + (int)(erMs[ch][i] * 0.001 * ereffactor * fs);
+			if (fdn->erTap[ch][i] > maxTap)
+				maxTap = fdn->erTap[ch][i];
+		}
+	fdn->preLength = (maxTap > fdn->dryDelay ? maxTap : fdn->dryDelay) + 1;
+	need += 2 * (size_t)fdn->preLength;
+	if (!fdn->mem || fdn->memSize < need)
+	{
+		free(fdn->mem);
+		fdn->mem = (double*)malloc(need * sizeof(double));
+		fdn->memSize = fdn->mem ? need : 0;
+		if (!fdn->mem)
+			return 0;
+	}
+	memset(fdn->mem, 0, need * sizeof(double));
+	p = fdn->mem;
+	for (i = 0; i < FDN_LINES; i++)
+	{
+		fdn->line[i] = p;
+		p += fdn->length[i];
+		fdn->pos[i] = 0;
+		fdn->damp[i] = 0.0;
+	}
+	fdn->pre[0] = p;
+	fdn->pre[1] = p + fdn->preLength;
+	fdn->prePos = 0;
+	for (i = 0; i < FDN_ER_TAPS; i++)
+		erNorm += erLevel[i] * erLevel[i];
+	for (i = 0; i < FDN_ER_TAPS; i++)
+		fdn->erGain[i] = erLevel[i] / sqrt(erNorm);
+	fdn->dampCoef = onePoleCoef(damplpf, fs);
+	fdn->inputCoef = onePoleCoef(inputlpf, fs);
+	fdn->outputCoef = onePoleCoef(outputlpf, fs);
+	fdn->inputLp[0] = fdn->inputLp[1] = 0.0;
+	fdn->outputLp[0] = fdn->outputLp[1] = 0.0;
+	// Gains and widths as Progenitor2 maps them
+	erefwidth = clampd(erefwidth, -1.0, 1.0);
+	width = clampd(width, 0.0, 1.0);
+	erefwet = pow(10.0, erefwet / 20.0);
+	wet = pow(10.0, wet / 20.0) * FDN_LATE_GAIN;
+	fdn->erToLate = clampd(ertolate, 0.0, 1.0);
+	fdn->erWet1 = erefwet * (erefwidth / 2.0 + 0.5);
+	fdn->erWet2 = erefwet * ((1.0 - erefwidth) / 2.0);
+	fdn->wet1 = wet * (width / 2.0 + 0.5);
+	fdn->wet2 = wet * ((1.0 - width) / 2.0);
+	fdn->dry = pow(10.0, dry / 20.0);
+	return 1;
+}
+void FDNReverbFree(FDNReverb *fdn)
+{
+	free(fdn->mem);
+	fdn->mem = 0;
+	fdn->memSize = 0;
+}
+static inline int wrapBack(int pos, int back, int length)
+{
+	pos -= back;
+	return pos < 0 ? pos + length : pos;
+}
+void FDNReverbProcess(FDNReverb *fdn, const double *inputL, const double *inputR, double *outputL, double *outputR, int n)
+{
+	// One row per frame with a lane per line, the lines are transposed in and out of it around each pass
+	v2d lines[FDN_BLOCK][FDN_LINES / 2], tank[FDN_BLOCK], early[FDN_BLOCK], direct[FDN_BLOCK];
+	v2d damp[FDN_LINES / 2], gain[FDN_LINES / 2], inLp, outLp;
+	const double hh = -2.0 / FDN_LINES;
+	int s, t, i, k, m;
+	if (!fdn->mem)
+	{
+		if (outputL != inputL)
+			memmove(outputL, inputL, n * sizeof(double));
+		if (outputR != inputR)
+			memmove(outputR, inputR, n * sizeof(double));
+		return;
+	}
+	for (k = 0; k < FDN_LINES / 2; k++)
+	{
+		damp[k] = v2dLoad(fdn->damp + 2 * k);
+		gain[k] = v2dLoad(fdn->gain + 2 * k);
+	}
+	inLp = v2dLoad(fdn->inputLp);
+	outLp = v2dLoad(fdn->outputLp);
+	for (s = 0; s < n; s += m)
+	{
+		m = n - s;
+		if (m > FDN_BLOCK)
+			m = FDN_BLOCK;
+		if (m > fdn->minLength)
+			m = fdn->minLength;
+		// Input history, early reflections and the band limited feed of the network
+		for (t = 0; t < m; t++)
+		{
+			int pos = fdn->prePos;
+			double erL = 0.0, erR = 0.0;
+			fdn->pre[0][pos] = inputL[s + t];
+			fdn->pre[1][pos] = inputR[s + t];
+			for (i = 0; i < FDN_ER_TAPS; i++)
+			{
+				erL += fdn->erGain[i] * fdn->pre[0][wrapBack(pos, fdn->erTap[0][i], fdn->preLength)];
+				erR += fdn->erGain[i] * fdn->pre[1][wrapBack(pos, fdn->erTap[1][i], fdn->preLength)];
+			}
+			i = wrapBack(pos, fdn->preDelay, fdn->preLength);
+			v2d x = { fdn->pre[0][i], fdn->pre[1][i] };
+			early[t] = (v2d){ erL, erR };
+			x += early[t] * fdn->erToLate;
+			inLp = x + (inLp - x) * fdn->inputCoef;
+			tank[t] = inLp;
+			i = wrapBack(pos, fdn->dryDelay, fdn->preLength);
+			direct[t] = (v2d){ fdn->pre[0][i], fdn->pre[1][i] };
+			fdn->prePos = pos + 1 == fdn->preLength ? 0 : pos + 1;
+		}
+		// The next m outputs of every line were written at least m frames ago
+		for (i = 0; i < FDN_LINES; i++)
+		{
+			const double *src = fdn->line[i];
+			double *dst = (double*)lines + i;
+			int pos = fdn->pos[i];
+			for (t = 0; t < m; t++)
+			{
+				dst[t * FDN_LINES] = src[pos];
+				if (++pos == fdn->length[i])
+					pos = 0;
+			}
+		}
+		for (t = 0; t < m; t++)
+		{
+			v2d y[FDN_LINES / 2], sum, out;
+			double h;
+			for (k = 0; k < FDN_LINES / 2; k++)
+			{
+				damp[k] = lines[t][k] + (damp[k] - lines[t][k]) * fdn->dampCoef;
+				y[k] = damp[k] * gain[k];
+			}
+			out = y[0] * outSign[0] + y[1] * outSign[1] + y[2] * outSign[2] + y[3] * outSign[3];
+			sum = y[0] + y[1] + y[2] + y[3];
+			h = (sum[0] + sum[1]) * hh;
+			for (k = 0; k < FDN_LINES / 2; k++)
+				lines[t][k] = y[k] + h + tank[t] * inSign[k];
+			tank[t] = out;
+		}
+		for (i = 0; i < FDN_LINES; i++)
+		{
+			double *dst = fdn->line[i];
+			const double *src = (const double*)lines + i;
+			int pos = fdn->pos[i];
+			for (t = 0; t < m; t++)
+			{
+				dst[pos] = src[t * FDN_LINES];
+				if (++pos == fdn->length[i])
+					pos = 0;
+			}
+			fdn->pos[i] = pos;
+		}
+		for (t = 0; t < m; t++)
+		{
+			v2d late = tank[t], swapped, out;
+			outLp = late + (outLp - late) * fdn->outputCoef;
+			swapped = (v2d){ outLp[1], outLp[0] };
+			out = outLp * fdn->wet1 + swapped * fdn->wet2 + direct[t] * fdn->dry;
+			out += early[t] * fdn->erWet1 + (v2d){ early[t][1], early[t][0] } * fdn->erWet2;
+			outputL[s + t] = out[0];
+			outputR[s + t] = out[1];
+		}
+	}
+	for (k = 0; k < FDN_LINES / 2; k++)
+		v2dStore(fdn->damp + 2 * k, damp[k]);
+	v2dStore(fdn->inputLp, inLp);
+	v2dStore(fdn->outputLp, outLp);
+}
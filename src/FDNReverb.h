@@ -0,0 +1,32 @@
+#ifndef __FDNREVERB_H__
+#define __FDNREVERB_H__
+#include <stddef.h>
+// Feedback delay network reverb, a low CPU alternative to the Progenitor2 reverb of reverb.c driven by the same parameters.
+// Line 2k + l is lane l of vector k, left input feeds the first lane of every pair and right the second, a Householder reflection mixes all lines
+#define FDN_LINES 8
+#define FDN_ER_TAPS 6
+typedef struct str_FDNReverb
+{
+	int length[FDN_LINES], pos[FDN_LINES], minLength;
+	double *line[FDN_LINES];
+	double gain[FDN_LINES]; // Attenuation of one pass through each line, sets the decay time
+	double damp[FDN_LINES]; // In-loop lowpass state
+	double dampCoef, inputCoef, outputCoef;
+	double inputLp[2], outputLp[2];
+	double *pre[2]; // Input history the predelay, dry delay and early reflection taps read from
+	int preLength, prePos, preDelay, dryDelay;
+	int erTap[2][FDN_ER_TAPS];
+	double erGain[FDN_ER_TAPS];
+	double erToLate, erWet1, erWet2, wet1, wet2, dry;
+	double *mem; // All delay memory in one heap block
+	size_t memSize; // Its capacity in doubles
+} FDNReverb;
+// Parameters and ranges as sf_advancereverb, the LFO, bass and oversampling controls have no counterpart. The early reflection factor also
+// scales the late lines as a room size. The memory of an earlier call is reused when large enough. Returns 0 when it could not be allocated,
+// a reverb without memory passes audio through. A zeroed structure owns nothing
+int FDNReverbInit(FDNReverb *fdn, int fs, double ertolate, double erefwet, double dry, double ereffactor, double erefwidth, double width, double wet,
+	double inputlpf, double damplpf, double outputlpf, double rt60, double delay);
+// Outputs may alias the inputs
+void FDNReverbProcess(FDNReverb *fdn, const double *inputL, const double *inputR, double *outputL, double *outputR, int n);
+void FDNReverbFree(FDNReverb *fdn);
+#endif
@@ -0,0 +1,856 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "kissfft/kiss_fftr.h"
+#include "VectorMath.h"
+#include "FFTBackend.h"
+#ifdef HAVE_FFTW3
+#include "fftw3.h"
+#include "DiskCache.h"
+#define FFTW_WISDOM_NAME "fftw3-wisdom"
+#endif
+#define SIMD_FFT_MIN_POINTS 8 // Smallest complex transform of the vectorised path, smaller ones go to kissfft
+#define FFT_REGISTRY_IDLE_MAX 16 // Unreferenced cores kept around for the next IR or EQ reload
+// Read only after construction, shared by every handle of the same size, direction and backend
+typedef struct str_FFTCore
+{
+	int n, inverse, real, backend;
+	int points;		// complex points of the SIMD transform, n / 2 for real plans
+	double sign;		// +1 forward, -1 inverse
+	void *kiss;		// kiss_fftr_cfg or kiss_fft_cfg, only used through the stateless entry points
+	double *twiddle;	// per radix-4 stage: w^p, w^2p, w^3p as real and imaginary arrays of len / 4
+	double *post;		// real plans: W^k of the n point transform, real and imaginary arrays of n / 2
+	void *fftw;		// fftw_plan, executed on the handle's buffers
+	size_t bytes;
+	int refs;
+	unsigned long idleSince;	// release counter value when refs dropped to zero
+	struct str_FFTCore *next;
+} FFTCore;
+struct str_FFTPlan
+{
+	FFTCore *core;
+	double *work;		// SIMD: four split complex buffers of points each, kissfft real: n / 2 complex scratch points
+	double *fftwIn, *fftwOut;	// SIMD aligned, same alignment as the arrays the FFTW plan was measured on
+	size_t bytes;
+};
+// Guards the registry, and the FFTW planner which is global and not thread safe, unlike its execution
+static pthread_mutex_t fftRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+static FFTCore *fftRegistry = 0;
+static unsigned long fftReleaseCount = 0;
+static int fftBackend = -1;
+static int FFTBackendAvailable(int backend)
+{
+#ifndef HAVE_FFTW3
+	if (backend == FFT_BACKEND_FFTW)
+		return 0;
+#endif
+	return backend >= 0 && backend < FFT_BACKEND_COUNT;
+}
+int FFTSelectBackend(int backend)
+{
+	if (!FFTBackendAvailable(backend))
+		return 0;
+	fftBackend = backend;
+	return 1;
+}
+int FFTActiveBackend(void)
+{
+	if (fftBackend < 0)
+	{
+		const char *env = getenv("JDSP_FFT_BACKEND");
+		int i;
+#ifdef HAVE_FFTW3
+		fftBackend = FFT_BACKEND_FFTW;
+#else
+		fftBackend = FFT_BACKEND_SIMD;
+#endif
+		for (i = 0; env && i < FFT_BACKEND_COUNT; i++)
+		{
+			if (FFTBackendAvailable(i) && (!strncmp(env, FFTBackendName(i), 4) || (env[0] == '0' + i && !env[1])))
+				fftBackend = i;
+		}
+	}
+	return fftBackend;
+}
+const char* FFTBackendName(int backend)
+{
+	switch (backend)
+	{
+	case FFT_BACKEND_KISS:
+		return "kissfft";
+	case FFT_BACKEND_SIMD:
+		return "simd";
+	case FFT_BACKEND_FFTW:
+		return "fftw3";
+	}
+	return "unknown";
+}
+static int isPowerOfTwo(int n)
+{
+	return n > 0 && !(n & (n - 1));
+}
+static void SimdPlanTwiddles(FFTCore *core)
+{
+	int len, p, m4, points = core->points;
+	size_t count = 0;
+	double *tw, theta;
+	for (len = points; len >= 4; len >>= 2)
+		count += 6 * (len >> 2);
+	core->twiddle = (double*)malloc((count + 1) * sizeof(double));
+	tw = core->twiddle;
+	if (!tw)
+		return;
+	for (len = points; len >= 4; len >>= 2)
+	{
+		m4 = len >> 2;
+		for (p = 0; p < m4; p++)
+		{
+			theta = 2.0 * M_PI * (double)p / (double)len;
+			tw[p] = cos(theta);
+			tw[m4 + p] = -core->sign * sin(theta);
+			tw[2 * m4 + p] = cos(2.0 * theta);
+			tw[3 * m4 + p] = -core->sign * sin(2.0 * theta);
+			tw[4 * m4 + p] = cos(3.0 * theta);
+			tw[5 * m4 + p] = -core->sign * sin(3.0 * theta);
+		}
+		tw += 6 * m4;
+	}
+	core->bytes += (count + 1) * sizeof(double);
+}
+// Stockham autosort, radix-4 stages with a final radix-2 stage for odd powers of two. The first stage runs with unit
+// stride and is vectorised over p, the others over the contiguous q index. Returns the buffer that holds the result
+static double* SimdComplexCore(const FFTCore *core, double *xr, double *xi, double *yr, double *yi, double **resultImag)
+{
+	int len, s = 1, m4, p, q, i0, i1, i2, i3, o;
+	const double *tw = core->twiddle;
+	double *sr = xr, *si = xi, *dr = yr, *di = yi, *t;
+	const v2d sg = { core->sign, core->sign };
+	v2d ar, ai, br, bi, cr, ci, dr_, di_, apcr, apci, amcr, amci, bpdr, bpdi, jr, ji, tr, ti, wr, wi;
+	for (len = core->points; len >= 4; len >>= 2)
+	{
+		m4 = len >> 2;
+		if (s == 1)
+		{
+			for (p = 0; p < m4; p += 2)
+			{
+				ar = v2dLoad(sr + p); ai = v2dLoad(si + p);
+				br = v2dLoad(sr + p + m4); bi = v2dLoad(si + p + m4);
+				cr = v2dLoad(sr + p + 2 * m4); ci = v2dLoad(si + p + 2 * m4);
+				dr_ = v2dLoad(sr + p + 3 * m4); di_ = v2dLoad(si + p + 3 * m4);
+				apcr = ar + cr; apci = ai + ci; amcr = ar - cr; amci = ai - ci;
+				bpdr = br + dr_; bpdi = bi + di_;
+				jr = -sg * (bi - di_); ji = sg * (br - dr_);
+				o = 4 * p;
+				tr = apcr + bpdr; ti = apci + bpdi;
+				dr[o] = tr[0]; di[o] = ti[0]; dr[o + 4] = tr[1]; di[o + 4] = ti[1];
+				wr = v2dLoad(tw + p); wi = v2dLoad(tw + m4 + p);
+				tr = amcr - jr; ti = amci - ji;
+				br = tr * wr - ti * wi; bi = tr * wi + ti * wr;
+				dr[o + 1] = br[0]; di[o + 1] = bi[0]; dr[o + 5] = br[1]; di[o + 5] = bi[1];
+				wr = v2dLoad(tw + 2 * m4 + p); wi = v2dLoad(tw + 3 * m4 + p);
+				tr = apcr - bpdr; ti = apci - bpdi;
+				br = tr * wr - ti * wi; bi = tr * wi + ti * wr;
+				dr[o + 2] = br[0]; di[o + 2] = bi[0]; dr[o + 6] = br[1]; di[o + 6] = bi[1];
+				wr = v2dLoad(tw + 4 * m4 + p); wi = v2dLoad(tw + 5 * m4 + p);
+				tr = amcr + jr; ti = amci + ji;
+				br = tr * wr - ti * wi; bi = tr * wi + ti * wr;
+				dr[o + 3] = br[0]; di[o + 3] = bi[0]; dr[o + 7] = br[1]; di[o + 7] = bi[1];
+			}
+		}
+		else
+		{
+			for (p = 0; p < m4; p++)
+			{
+				const v2d w1r = { tw[p], tw[p] }, w1i = { tw[m4 + p], tw[m4 + p] };
+				const v2d w2r = { tw[2 * m4 + p], tw[2 * m4 + p] }, w2i = { tw[3 * m4 + p], tw[3 * m4 + p] };
+				const v2d w3r = { tw[4 * m4 + p], tw[4 * m4 + p] }, w3i = { tw[5 * m4 + p], tw[5 * m4 + p] };
+				for (q = 0; q < s; q += 2)
+				{
+					i0 = q + s * p; i1 = i0 + s * m4; i2 = i1 + s * m4; i3 = i2 + s * m4;
+					ar = v2dLoad(sr + i0); ai = v2dLoad(si + i0);
+					br = v2dLoad(sr + i1); bi = v2dLoad(si + i1);
+					cr = v2dLoad(sr + i2); ci = v2dLoad(si + i2);
+					dr_ = v2dLoad(sr + i3); di_ = v2dLoad(si + i3);
+					apcr = ar + cr; apci = ai + ci; amcr = ar - cr; amci = ai - ci;
+					bpdr = br + dr_; bpdi = bi + di_;
+					jr = -sg * (bi - di_); ji = sg * (br - dr_);
+					o = q + s * 4 * p;
+					v2dStore(dr + o, apcr + bpdr); v2dStore(di + o, apci + bpdi);
+					tr = amcr - jr; ti = amci - ji;
+					v2dStore(dr + o + s, tr * w1r - ti * w1i); v2dStore(di + o + s, tr * w1i + ti * w1r);
+					tr = apcr - bpdr; ti = apci - bpdi;
+					v2dStore(dr + o + 2 * s, tr * w2r - ti * w2i); v2dStore(di + o + 2 * s, tr * w2i + ti * w2r);
+					tr = amcr + jr; ti = amci + ji;
+					v2dStore(dr + o + 3 * s, tr * w3r - ti * w3i); v2dStore(di + o + 3 * s, tr * w3i + ti * w3r);
+				}
+			}
+		}
+		tw += 6 * m4;
+		t = sr; sr = dr; dr = t;
+		t = si; si = di; di = t;
+		s <<= 2;
+	}
+	if (len == 2)
+	{
+		for (q = 0; q < s; q += 2)
+		{
+			ar = v2dLoad(sr + q); ai = v2dLoad(si + q);
+			br = v2dLoad(sr + q + s); bi = v2dLoad(si + q + s);
+			v2dStore(dr + q, ar + br); v2dStore(di + q, ai + bi);
+			v2dStore(dr + q + s, ar - br); v2dStore(di + q + s, ai - bi);
+		}
+		sr = dr; si = di;
+	}
+	*resultImag = si;
+	return sr;
+}
+// Two transforms of the same core side by side, element e of transform l at index 2 * e + l. Every vector holds the
+// same element of both, so no stage needs shuffles and twiddles are broadcast
+static double* SimdComplexCoreX2(const FFTCore *core, double *xr, double *xi, double *yr, double *yi, double **resultImag)
+{
+	int len, s = 1, m4, p, q, i0, i1, i2, i3, o;
+	const double *tw = core->twiddle;
+	double *sr = xr, *si = xi, *dr = yr, *di = yi, *t;
+	const v2d sg = { core->sign, core->sign };
+	v2d ar, ai, br, bi, cr, ci, dr_, di_, apcr, apci, amcr, amci, bpdr, bpdi, jr, ji, tr, ti;
+	for (len = core->points; len >= 4; len >>= 2)
+	{
+		m4 = len >> 2;
+		for (p = 0; p < m4; p++)
+		{
+			const v2d w1r = { tw[p], tw[p] }, w1i = { tw[m4 + p], tw[m4 + p] };
+			const v2d w2r = { tw[2 * m4 + p], tw[2 * m4 + p] }, w2i = { tw[3 * m4 + p], tw[3 * m4 + p] };
+			const v2d w3r = { tw[4 * m4 + p], tw[4 * m4 + p] }, w3i = { tw[5 * m4 + p], tw[5 * m4 + p] };
+			for (q = 0; q < s; q++)
+			{
+				i0 = 2 * (q + s * p); i1 = i0 + 2 * s * m4; i2 = i1 + 2 * s * m4; i3 = i2 + 2 * s * m4;
+				ar = v2dLoad(sr + i0); ai = v2dLoad(si + i0);
+				br = v2dLoad(sr + i1); bi = v2dLoad(si + i1);
+				cr = v2dLoad(sr + i2); ci = v2dLoad(si + i2);
+				dr_ = v2dLoad(sr + i3); di_ = v2dLoad(si + i3);
+				apcr = ar + cr; apci = ai + ci; amcr = ar - cr; amci = ai - ci;
+				bpdr = br + dr_; bpdi = bi + di_;
+				jr = -sg * (bi - di_); ji = sg * (br - dr_);
+				o = 2 * (q + s * 4 * p);
+				v2dStore(dr + o, apcr + bpdr); v2dStore(di + o, apci + bpdi);
+				tr = amcr - jr; ti = amci - ji;
+				v2dStore(dr + o + 2 * s, tr * w1r - ti * w1i); v2dStore(di + o + 2 * s, tr * w1i + ti * w1r);
+				tr = apcr - bpdr; ti = apci - bpdi;
+				v2dStore(dr + o + 4 * s, tr * w2r - ti * w2i); v2dStore(di + o + 4 * s, tr * w2i + ti * w2r);
+				tr = amcr + jr; ti = amci + ji;
+				v2dStore(dr + o + 6 * s, tr * w3r - ti * w3i); v2dStore(di + o + 6 * s, tr * w3i + ti * w3r);
+			}
+		}
+		tw += 6 * m4;
+		t = sr; sr = dr; dr = t;
+		t = si; si = di; di = t;
+		s <<= 2;
+	}
+	if (len == 2)
+	{
+		for (q = 0; q < 2 * s; q += 2)
+		{
+			ar = v2dLoad(sr + q); ai = v2dLoad(si + q);
+			br = v2dLoad(sr + q + 2 * s); bi = v2dLoad(si + q + 2 * s);
+			v2dStore(dr + q, ar + br); v2dStore(di + q, ai + bi);
+			v2dStore(dr + q + 2 * s, ar - br); v2dStore(di + q + 2 * s, ai - bi);
+		}
+		sr = dr; si = di;
+	}
+	*resultImag = si;
+	return sr;
+}
+#ifdef HAVE_FFTW3
+static int fftwWisdomLoaded = 0;
+static fftw_plan FFTWPlanMake(FFTCore *core, double *in, double *out, unsigned flags)
+{
+	if (!core->real)
+		return fftw_plan_dft_1d(core->n, (fftw_complex*)in, (fftw_complex*)out, core->inverse ? FFTW_BACKWARD : FFTW_FORWARD, flags);
+	if (core->inverse)
+		return fftw_plan_dft_c2r_1d(core->n, (fftw_complex*)in, out, flags);
+	return fftw_plan_dft_r2c_1d(core->n, in, (fftw_complex*)out, flags);
+}
+static void FFTWBufferSizes(const FFTCore *core, size_t *inSize, size_t *outSize)
+{
+	if (!core->real)
+		*inSize = *outSize = sizeof(fftw_complex) * core->n;
+	else if (core->inverse)
+	{
+		*inSize = sizeof(fftw_complex) * (core->n / 2 + 1);
+		*outSize = sizeof(double) * core->n;
+	}
+	else
+	{
+		*inSize = sizeof(double) * core->n;
+		*outSize = sizeof(fftw_complex) * (core->n / 2 + 1);
+	}
+}
+// Called with the registry lock held
+static int FFTWCoreCreate(FFTCore *core)
+{
+	char path[4096], *wisdom = 0;
+	size_t inSize, outSize;
+	double *in, *out;
+	fftw_plan p = 0;
+	FFTWBufferSizes(core, &inSize, &outSize);
+	// FFTW_MEASURE overwrites the arrays it plans on
+	in = (double*)fftw_malloc(inSize);
+	out = (double*)fftw_malloc(outSize);
+	if (in && out)
+	{
+		if (!fftwWisdomLoaded)
+		{
+			if (DiskCachePath(FFTW_WISDOM_NAME, path, sizeof(path)))
+				fftw_import_wisdom_from_filename(path);
+			fftwWisdomLoaded = 1;
+		}
+		// Measuring a size takes far longer than the transform, only do it for sizes the wisdom file does not know yet
+		p = FFTWPlanMake(core, in, out, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+		if (!p)
+		{
+			p = FFTWPlanMake(core, in, out, FFTW_MEASURE);
+			if (p)
+				wisdom = fftw_export_wisdom_to_string();
+		}
+	}
+	fftw_free(in);
+	fftw_free(out);
+	if (wisdom)
+	{
+		DiskCacheStore(FFTW_WISDOM_NAME, wisdom, strlen(wisdom), 0, 0);
+		fftw_free(wisdom);
+	}
+	core->fftw = p;
+	return p != 0;
+}
+#endif
+static void FFTCoreFree(FFTCore *core)
+{
+#ifdef HAVE_FFTW3
+	if (core->fftw)
+		fftw_destroy_plan((fftw_plan)core->fftw);
+#endif
+	free(core->kiss);
+	free(core->twiddle);
+	free(core->post);
+	free(core);
+}
+static int FFTResolveBackend(int backend, int points)
+{
+	if (backend == FFT_BACKEND_SIMD && (!isPowerOfTwo(points) || points < SIMD_FFT_MIN_POINTS))
+		return FFT_BACKEND_KISS;
+	return backend;
+}
+// Called with the registry lock held
+static FFTCore* FFTCoreCreate(int n, int inverse, int real, int backend)
+{
+	FFTCore *core = (FFTCore*)calloc(1, sizeof(FFTCore));
+	if (!core)
+		return 0;
+	core->n = n;
+	core->inverse = inverse;
+	core->real = real;
+	core->sign = inverse ? -1.0 : 1.0;
+	core->points = real ? n / 2 : n;
+	core->backend = backend;
+	core->bytes = sizeof(FFTCore);
+#ifdef HAVE_FFTW3
+	if (backend == FFT_BACKEND_FFTW)
+	{
+		if (FFTWCoreCreate(core))
+			return core;
+		FFTCoreFree(core);
+		return 0;
+	}
+#endif
+	if (backend == FFT_BACKEND_KISS)
+	{
+		size_t size = 0;
+		if (real)
+		{
+			kiss_fftr_alloc(n, inverse, 0, &size);
+			core->kiss = kiss_fftr_alloc(n, inverse, 0, 0);
+		}
+		else
+		{
+			kiss_fft_alloc(n, inverse, 0, &size);
+			core->kiss = kiss_fft_alloc(n, inverse, 0, 0);
+		}
+		core->bytes += size;
+		if (!core->kiss)
+		{
+			FFTCoreFree(core);
+			return 0;
+		}
+		return core;
+	}
+	SimdPlanTwiddles(core);
+	if (real)
+	{
+		int k, half = core->points;
+		core->post = (double*)malloc(2 * half * sizeof(double));
+		for (k = 0; core->post && k < half; k++)
+		{
+			core->post[k] = cos(2.0 * M_PI * (double)k / (double)n);
+			core->post[half + k] = -core->sign * sin(2.0 * M_PI * (double)k / (double)n);
+		}
+		core->bytes += 2 * half * sizeof(double);
+	}
+	if (!core->twiddle || (real && !core->post))
+	{
+		FFTCoreFree(core);
+		return 0;
+	}
+	return core;
+}
+static FFTCore* FFTCoreAcquire(int n, int inverse, int real, int backend)
+{
+	FFTCore *core;
+	pthread_mutex_lock(&fftRegistryLock);
+	for (core = fftRegistry; core; core = core->next)
+	{
+		if (core->n == n && core->inverse == inverse && core->real == real && core->backend == backend)
+			break;
+	}
+	if (!core)
+	{
+		core = FFTCoreCreate(n, inverse, real, backend);
+		if (core)
+		{
+			core->next = fftRegistry;
+			fftRegistry = core;
+		}
+	}
+	if (core)
+		core->refs++;
+	pthread_mutex_unlock(&fftRegistryLock);
+	return core;
+}
+static void FFTCoreRelease(FFTCore *core)
+{
+	FFTCore **link, **oldest;
+	int idle = 0;
+	pthread_mutex_lock(&fftRegistryLock);
+	if (--core->refs == 0)
+		core->idleSince = ++fftReleaseCount;
+	// Evict the longest unused core once too many are idle
+	oldest = 0;
+	for (link = &fftRegistry; *link; link = &(*link)->next)
+	{
+		if ((*link)->refs)
+			continue;
+		idle++;
+		if (!oldest || (*link)->idleSince < (*oldest)->idleSince)
+			oldest = link;
+	}
+	if (idle > FFT_REGISTRY_IDLE_MAX)
+	{
+		core = *oldest;
+		*oldest = core->next;
+		FFTCoreFree(core);
+	}
+	pthread_mutex_unlock(&fftRegistryLock);
+}
+static FFTPlan* FFTPlanCreate(int n, int inverse, int real)
+{
+	int points = real ? n / 2 : n;
+	int backend = FFTResolveBackend(FFTActiveBackend(), points);
+	size_t size;
+	FFTPlan *plan = (FFTPlan*)calloc(1, sizeof(FFTPlan));
+	if (!plan)
+		return 0;
+	plan->core = FFTCoreAcquire(n, inverse, real, backend);
+	// FFTW may fail to plan, fall back to the in-tree transforms
+	if (!plan->core && backend == FFT_BACKEND_FFTW)
+		plan->core = FFTCoreAcquire(n, inverse, real, FFTResolveBackend(FFT_BACKEND_SIMD, points));
+	if (!plan->core)
+	{
+		free(plan);
+		return 0;
+	}
+	plan->bytes = sizeof(FFTPlan);
+	switch (plan->core->backend)
+	{
+#ifdef HAVE_FFTW3
+	case FFT_BACKEND_FFTW:
+	{
+		size_t outSize;
+		FFTWBufferSizes(plan->core, &size, &outSize);
+		plan->fftwIn = (double*)fftw_malloc(size);
+		plan->fftwOut = (double*)fftw_malloc(outSize);
+		plan->bytes += size + outSize;
+		if (!plan->fftwIn || !plan->fftwOut)
+		{
+			FFTPlanFree(plan);
+			return 0;
+		}
+		return plan;
+	}
+#endif
+	case FFT_BACKEND_KISS:
+		if (!real)
+			return plan;
+		// kiss_fftr scratch, then time and frequency staging for the split entry points
+		size = sizeof(double) * (3 * n + 2);
+		break;
+	default:
+		size = sizeof(double) * 4 * points;
+		break;
+	}
+	plan->work = (double*)malloc(size);
+	plan->bytes += size;
+	if (!plan->work)
+	{
+		FFTPlanFree(plan);
+		return 0;
+	}
+	return plan;
+}
+FFTPlan* FFTPlanReal(int n, int inverse)
+{
+	if (n < 2 || (n & 1))
+		return 0;
+	return FFTPlanCreate(n, inverse, 1);
+}
+FFTPlan* FFTPlanComplex(int n, int inverse)
+{
+	if (n < 1)
+		return 0;
+	return FFTPlanCreate(n, inverse, 0);
+}
+void FFTPlanFree(FFTPlan *plan)
+{
+	if (!plan)
+		return;
+#ifdef HAVE_FFTW3
+	fftw_free(plan->fftwIn);
+	fftw_free(plan->fftwOut);
+#endif
+	free(plan->work);
+	FFTCoreRelease(plan->core);
+	free(plan);
+}
+int FFTPlanBackend(const FFTPlan *plan)
+{
+	return plan->core->backend;
+}
+size_t FFTPlanMemory(const FFTPlan *plan)
+{
+	// Shared tables are split evenly among the handles referencing them
+	return plan->bytes + plan->core->bytes / (plan->core->refs ? plan->core->refs : 1);
+}
+// Spectra are addressed as re[k * stride], im[k * stride]: stride 2 over an FFTComplex array, 1 for split arrays.
+// Samples from length up to n are taken as zero
+static void FFTRealForwardStrided(FFTPlan *plan, const double *timeData, int length, double *re, double *im, int stride)
+{
+	const FFTCore *core = plan->core;
+	int k, half = core->points;
+	double *zr = plan->work, *zi = zr + half, *Zr, *Zi;
+	const double *wr = core->post, *wi = core->post + half;
+	double ar, ai, br, bi, fer, fei, for_, foi;
+	if (core->backend != FFT_BACKEND_SIMD)
+	{
+		double *stage;
+		FFTComplex *freq;
+#ifdef HAVE_FFTW3
+		// Copies keep the measured alignment, and c2r plans would otherwise destroy the caller's spectrum
+		if (core->backend == FFT_BACKEND_FFTW)
+		{
+			stage = plan->fftwIn;
+			freq = (FFTComplex*)plan->fftwOut;
+		}
+		else
+#endif
+		{
+			stage = plan->work + core->n;
+			freq = (FFTComplex*)(stage + core->n);
+		}
+		memcpy(stage, timeData, sizeof(double) * length);
+		memset(stage + length, 0, sizeof(double) * (core->n - length));
+#ifdef HAVE_FFTW3
+		if (core->backend == FFT_BACKEND_FFTW)
+			fftw_execute_dft_r2c((fftw_plan)core->fftw, stage, (fftw_complex*)freq);
+		else
+#endif
+			kiss_fftr_tmpbuf((kiss_fftr_cfg)core->kiss, stage, (kiss_fft_cpx*)freq, (kiss_fft_cpx*)plan->work);
+		for (k = 0; k < half + 1; k++)
+		{
+			re[k * stride] = freq[k].r;
+			im[k * stride] = freq[k].i;
+		}
+		return;
+	}
+	// Even samples form the real part, odd samples the imaginary part of a half length complex transform
+	for (k = 0; k < length >> 1; k++)
+	{
+		zr[k] = timeData[2 * k];
+		zi[k] = timeData[2 * k + 1];
+	}
+	if (length & 1)
+	{
+		zr[k] = timeData[2 * k];
+		zi[k++] = 0.0;
+	}
+	for (; k < half; k++)
+		zr[k] = zi[k] = 0.0;
+	Zr = SimdComplexCore(core, zr, zi, zi + half, zi + 2 * half, &Zi);
+	re[0] = Zr[0] + Zi[0];
+	im[0] = 0.0;
+	re[half * stride] = Zr[0] - Zi[0];
+	im[half * stride] = 0.0;
+	for (k = 1; k < half; k++)
+	{
+		ar = Zr[k]; ai = Zi[k];
+		br = Zr[half - k]; bi = -Zi[half - k];
+		fer = 0.5 * (ar + br); fei = 0.5 * (ai + bi);
+		for_ = 0.5 * (ai - bi); foi = -0.5 * (ar - br);
+		re[k * stride] = fer + wr[k] * for_ - wi[k] * foi;
+		im[k * stride] = fei + wr[k] * foi + wi[k] * for_;
+	}
+}
+// With clear set the spectrum is zeroed while it is read, saving a separate pass over overlap-add accumulators
+static void FFTRealInverseStrided(FFTPlan *plan, double *re, double *im, int stride, int clear, double *timeData)
+{
+	const FFTCore *core = plan->core;
+	int k, m, half = core->points;
+	double *zr = plan->work, *zi = zr + half, *Zr, *Zi;
+	const double *wr = core->post, *wi = core->post + half;
+	double ar, ai, br, bi, fer, fei, dr, di, for_, foi;
+	if (core->backend != FFT_BACKEND_SIMD)
+	{
+		FFTComplex *freq;
+#ifdef HAVE_FFTW3
+		if (core->backend == FFT_BACKEND_FFTW)
+			freq = (FFTComplex*)plan->fftwIn;
+		else
+#endif
+			freq = (FFTComplex*)(plan->work + 2 * core->n);
+		for (k = 0; k < half + 1; k++)
+		{
+			freq[k].r = re[k * stride];
+			freq[k].i = im[k * stride];
+			if (clear)
+				re[k * stride] = im[k * stride] = 0.0;
+		}
+#ifdef HAVE_FFTW3
+		if (core->backend == FFT_BACKEND_FFTW)
+		{
+			fftw_execute_dft_c2r((fftw_plan)core->fftw, (fftw_complex*)freq, plan->fftwOut);
+			memcpy(timeData, plan->fftwOut, sizeof(double) * core->n);
+			return;
+		}
+#endif
+		kiss_fftri_tmpbuf((kiss_fftr_cfg)core->kiss, (const kiss_fft_cpx*)freq, timeData, (kiss_fft_cpx*)plan->work);
+		return;
+	}
+	// DC and Nyquist imaginary parts are ignored, as kissfft does
+	zr[0] = re[0] + re[half * stride];
+	zi[0] = re[0] - re[half * stride];
+	if (clear)
+		re[0] = im[0] = re[half * stride] = im[half * stride] = 0.0;
+	// Bins k and half - k feed each other, both are consumed in the same iteration before clearing
+	for (k = 1; k <= half >> 1; k++)
+	{
+		m = half - k;
+		ar = re[k * stride]; ai = im[k * stride];
+		br = re[m * stride]; bi = -im[m * stride];
+		fer = ar + br; fei = ai + bi;
+		dr = ar - br; di = ai - bi;
+		for_ = dr * wr[k] - di * wi[k];
+		foi = dr * wi[k] + di * wr[k];
+		zr[k] = fer - foi;
+		zi[k] = fei + for_;
+		if (m != k)
+		{
+			fer = br + ar; fei = -bi - ai;
+			dr = br - ar; di = -bi + ai;
+			for_ = dr * wr[m] - di * wi[m];
+			foi = dr * wi[m] + di * wr[m];
+			zr[m] = fer - foi;
+			zi[m] = fei + for_;
+		}
+		if (clear)
+			re[k * stride] = im[k * stride] = re[m * stride] = im[m * stride] = 0.0;
+	}
+	Zr = SimdComplexCore(core, zr, zi, zi + half, zi + 2 * half, &Zi);
+	for (k = 0; k < half; k++)
+	{
+		timeData[2 * k] = Zr[k];
+		timeData[2 * k + 1] = Zi[k];
+	}
+}
+// Pairs use the scratch of both handles: interleaved input in the first, ping-pong buffers in the second
+static void SimdRealForwardX2(FFTPlan *plan0, FFTPlan *plan1, const double *t0, const double *t1, int length, double *re0, double *im0, double *re1, double *im1)
+{
+	const FFTCore *core = plan0->core;
+	int k, half = core->points;
+	double *zr = plan0->work, *zi = zr + 2 * half, *Zr, *Zi;
+	const double *wr = core->post, *wi = core->post + half;
+	v2d ar, ai, br, bi, fer, fei, for_, foi, xr, xi;
+	for (k = 0; k < length >> 1; k++)
+	{
+		zr[2 * k] = t0[2 * k]; zr[2 * k + 1] = t1[2 * k];
+		zi[2 * k] = t0[2 * k + 1]; zi[2 * k + 1] = t1[2 * k + 1];
+	}
+	if (length & 1)
+	{
+		zr[2 * k] = t0[2 * k]; zr[2 * k + 1] = t1[2 * k];
+		zi[2 * k] = zi[2 * k + 1] = 0.0;
+		k++;
+	}
+	memset(zr + 2 * k, 0, sizeof(double) * 2 * (half - k));
+	memset(zi + 2 * k, 0, sizeof(double) * 2 * (half - k));
+	Zr = SimdComplexCoreX2(core, zr, zi, plan1->work, plan1->work + 2 * half, &Zi);
+	re0[0] = Zr[0] + Zi[0]; re1[0] = Zr[1] + Zi[1];
+	re0[half] = Zr[0] - Zi[0]; re1[half] = Zr[1] - Zi[1];
+	im0[0] = im1[0] = im0[half] = im1[half] = 0.0;
+	for (k = 1; k < half; k++)
+	{
+		const v2d w_r = { wr[k], wr[k] }, w_i = { wi[k], wi[k] }, h = { 0.5, 0.5 };
+		ar = v2dLoad(Zr + 2 * k); ai = v2dLoad(Zi + 2 * k);
+		br = v2dLoad(Zr + 2 * (half - k)); bi = -v2dLoad(Zi + 2 * (half - k));
+		fer = h * (ar + br); fei = h * (ai + bi);
+		for_ = h * (ai - bi); foi = -h * (ar - br);
+		xr = fer + w_r * for_ - w_i * foi;
+		xi = fei + w_r * foi + w_i * for_;
+		re0[k] = xr[0]; re1[k] = xr[1];
+		im0[k] = xi[0]; im1[k] = xi[1];
+	}
+}
+static void SimdRealInverseX2(FFTPlan *plan0, FFTPlan *plan1, double *re0, double *im0, double *re1, double *im1, int clear, double *t0, double *t1)
+{
+	const FFTCore *core = plan0->core;
+	int k, m, half = core->points;
+	double *zr = plan0->work, *zi = zr + 2 * half, *Zr, *Zi;
+	const double *wr = core->post, *wi = core->post + half;
+	v2d ar, ai, br, bi, fer, fei, dr, di, for_, foi;
+	zr[0] = re0[0] + re0[half]; zr[1] = re1[0] + re1[half];
+	zi[0] = re0[0] - re0[half]; zi[1] = re1[0] - re1[half];
+	if (clear)
+		re0[0] = im0[0] = re0[half] = im0[half] = re1[0] = im1[0] = re1[half] = im1[half] = 0.0;
+	for (k = 1; k <= half >> 1; k++)
+	{
+		const v2d wkr = { wr[k], wr[k] }, wki = { wi[k], wi[k] };
+		m = half - k;
+		ar = (v2d){ re0[k], re1[k] }; ai = (v2d){ im0[k], im1[k] };
+		br = (v2d){ re0[m], re1[m] }; bi = -(v2d){ im0[m], im1[m] };
+		fer = ar + br; fei = ai + bi;
+		dr = ar - br; di = ai - bi;
+		for_ = dr * wkr - di * wki;
+		foi = dr * wki + di * wkr;
+		v2dStore(zr + 2 * k, fer - foi);
+		v2dStore(zi + 2 * k, fei + for_);
+		if (m != k)
+		{
+			const v2d wmr = { wr[m], wr[m] }, wmi = { wi[m], wi[m] };
+			fer = br + ar; fei = -bi - ai;
+			dr = br - ar; di = -bi + ai;
+			for_ = dr * wmr - di * wmi;
+			foi = dr * wmi + di * wmr;
+			v2dStore(zr + 2 * m, fer - foi);
+			v2dStore(zi + 2 * m, fei + for_);
+		}
+		if (clear)
+			re0[k] = im0[k] = re0[m] = im0[m] = re1[k] = im1[k] = re1[m] = im1[m] = 0.0;
+	}
+	Zr = SimdComplexCoreX2(core, zr, zi, plan1->work, plan1->work + 2 * half, &Zi);
+	for (k = 0; k < half; k++)
+	{
+		t0[2 * k] = Zr[2 * k]; t1[2 * k] = Zr[2 * k + 1];
+		t0[2 * k + 1] = Zi[2 * k]; t1[2 * k + 1] = Zi[2 * k + 1];
+	}
+}
+static int FFTPlansPairable(const FFTPlan *plan0, const FFTPlan *plan1)
+{
+	return plan0->core == plan1->core && plan0->core->backend == FFT_BACKEND_SIMD;
+}
+void FFTRealForward(FFTPlan *plan, const double *timeData, FFTComplex *freqData)
+{
+	if (plan->core->backend == FFT_BACKEND_KISS)
+	{
+		kiss_fftr_tmpbuf((kiss_fftr_cfg)plan->core->kiss, timeData, (kiss_fft_cpx*)freqData, (kiss_fft_cpx*)plan->work);
+		return;
+	}
+	FFTRealForwardStrided(plan, timeData, plan->core->n, &freqData[0].r, &freqData[0].i, 2);
+}
+void FFTRealInverse(FFTPlan *plan, const FFTComplex *freqData, double *timeData)
+{
+	if (plan->core->backend == FFT_BACKEND_KISS)
+	{
+		kiss_fftri_tmpbuf((kiss_fftr_cfg)plan->core->kiss, (const kiss_fft_cpx*)freqData, timeData, (kiss_fft_cpx*)plan->work);
+		return;
+	}
+	// Only written when clearing, which this path never asks for
+	FFTRealInverseStrided(plan, (double*)&freqData[0].r, (double*)&freqData[0].i, 2, 0, timeData);
+}
+void FFTRealForwardSplit(FFTPlan *plan, const double *timeData, int length, double *real, double *imag)
+{
+	FFTRealForwardStrided(plan, timeData, length, real, imag, 1);
+}
+void FFTRealInverseSplit(FFTPlan *plan, double *real, double *imag, int clear, double *timeData)
+{
+	FFTRealInverseStrided(plan, real, imag, 1, clear, timeData);
+}
+void FFTRealForwardBatch(FFTPlan **plans, int count, const double *const *timeData, int length, double **real, double **imag)
+{
+	int i = 0;
+	while (i < count)
+	{
+		if (i + 1 < count && FFTPlansPairable(plans[i], plans[i + 1]))
+		{
+			SimdRealForwardX2(plans[i], plans[i + 1], timeData[i], timeData[i + 1], length, real[i], imag[i], real[i + 1], imag[i + 1]);
+			i += 2;
+			continue;
+		}
+		FFTRealForwardStrided(plans[i], timeData[i], length, real[i], imag[i], 1);
+		i++;
+	}
+}
+void FFTRealInverseBatch(FFTPlan **plans, int count, double **real, double **imag, int clear, double **timeData)
+{
+	int i = 0;
+	while (i < count)
+	{
+		if (i + 1 < count && FFTPlansPairable(plans[i], plans[i + 1]))
+		{
+			SimdRealInverseX2(plans[i], plans[i + 1], real[i], imag[i], real[i + 1], imag[i + 1], clear, timeData[i], timeData[i + 1]);
+			i += 2;
+			continue;
+		}
+		FFTRealInverseStrided(plans[i], real[i], imag[i], 1, clear, timeData[i]);
+		i++;
+	}
+}
+void FFTComplexTransform(FFTPlan *plan, const FFTComplex *in, FFTComplex *out)
+{
+	const FFTCore *core = plan->core;
+	int k, n = core->points;
+	double *xr = plan->work, *xi = xr + n, *yr, *yi;
+	if (core->backend == FFT_BACKEND_KISS)
+	{
+		// Stateless as long as in and out differ, kissfft allocates its own scratch otherwise
+		kiss_fft((kiss_fft_cfg)core->kiss, (const kiss_fft_cpx*)in, (kiss_fft_cpx*)out);
+		return;
+	}
+#ifdef HAVE_FFTW3
+	if (core->backend == FFT_BACKEND_FFTW)
+	{
+		memcpy(plan->fftwIn, in, sizeof(FFTComplex) * n);
+		fftw_execute_dft((fftw_plan)core->fftw, (fftw_complex*)plan->fftwIn, (fftw_complex*)plan->fftwOut);
+		memcpy(out, plan->fftwOut, sizeof(FFTComplex) * n);
+		return;
+	}
+#endif
+	for (k = 0; k < n; k++)
+	{
+		xr[k] = in[k].r;
+		xi[k] = in[k].i;
+	}
+	yr = SimdComplexCore(core, xr, xi, xi + n, xi + 2 * n, &yi);
+	for (k = 0; k < n; k++)
+	{
+		out[k].r = yr[k];
+		out[k].i = yi[k];
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef __FFTBACKEND_H__
+#define __FFTBACKEND_H__
+#include <stddef.h>
+// Transforms are unnormalised, forward uses exp(-2*pi*i*k*n/N), same conventions as kissfft
+enum FFTBackends
+{
+    FFT_BACKEND_KISS = 0, // Portable, any even size
+    FFT_BACKEND_SIMD = 1, // Vectorised radix-4 Stockham, powers of two, falls back to kissfft otherwise
+    FFT_BACKEND_FFTW = 2, // Measured FFTW3 plans with wisdom kept in the disk cache, only when configured --with-fftw3. Default if present
+    FFT_BACKEND_COUNT
+};
+typedef struct str_FFTComplex
+{
+    double r, i;
+} FFTComplex;
+typedef struct str_FFTPlan FFTPlan;
+// Backend used by plans created afterwards, initially taken from JDSP_FFT_BACKEND ("kiss", "simd" or "fftw"). Returns 0 if unknown or not built in
+int FFTSelectBackend(int backend);
+int FFTActiveBackend(void);
+const char* FFTBackendName(int backend);
+// Real plans map n samples to n / 2 + 1 bins, n must be even
+FFTPlan* FFTPlanReal(int n, int inverse);
+FFTPlan* FFTPlanComplex(int n, int inverse);
+void FFTPlanFree(FFTPlan *plan);
+int FFTPlanBackend(const FFTPlan *plan);
+size_t FFTPlanMemory(const FFTPlan *plan);
+void FFTRealForward(FFTPlan *plan, const double *timeData, FFTComplex *freqData);
+void FFTRealInverse(FFTPlan *plan, const FFTComplex *freqData, double *timeData);
+// Split real/imaginary arrays of n / 2 + 1 bins. Input beyond length samples is zero. Clear zeroes the spectrum as it is consumed
+void FFTRealForwardSplit(FFTPlan *plan, const double *timeData, int length, double *real, double *imag);
+void FFTRealInverseSplit(FFTPlan *plan, double *real, double *imag, int clear, double *timeData);
+// Split transforms of several signals, one handle each. Neighbouring handles of the same size run two at a time across SIMD lanes
+void FFTRealForwardBatch(FFTPlan **plans, int count, const double *const *timeData, int length, double **real, double **imag);
+void FFTRealInverseBatch(FFTPlan **plans, int count, double **real, double **imag, int clear, double **timeData);
+void FFTComplexTransform(FFTPlan *plan, const FFTComplex *in, FFTComplex *out);
+#endif
@@ -5,7 +5,7 @@
 #include <samplerate.h>
 #include "AutoConvolver.h"
 SF_INFO sfiIRInfo;
-SNDFILE *sfIRFile;
+SNDFILE *sfIRFile = NULL;
 int *GetLoadImpulseResponseInfo(char *mIRFileName)
 {
     if (strlen(mIRFileName) <= 0) return 0;
@@ -40,58 +40,56 @@ int *GetLoadImpulseResponseInfo(char *mIRFileName)
     jImpInfo[3] = (int)sfiIRInfo.format;
     return jImpInfo;
 }
+int GetImpulseResponseFrames(int targetSampleRate)
+{
+    // Frame count per channel ReadImpulseResponseToFloat will return at targetSampleRate
+    if (sfiIRInfo.samplerate == targetSampleRate)
+        return (int)sfiIRInfo.frames;
+    return (int)((double)sfiIRInfo.frames * ((double)targetSampleRate / (double)sfiIRInfo.samplerate));
+}
+void CloseImpulseResponse()
+{
+    if (sfIRFile)
+        sf_close(sfIRFile);
+    sfIRFile = NULL;
+}
 float* ReadImpulseResponseToFloat
         (int targetSampleRate)
 {
     // Allocate memory block for reading
     float* outbuf;
-    int i;
-    float *final;
     int frameCountTotal = sfiIRInfo.channels * sfiIRInfo.frames;
     size_t bufferSize = frameCountTotal * sizeof(float);
-    outbuf = (float*)malloc(bufferSize);
 
     float *pFrameBuffer = (float*)malloc(bufferSize);
     if (!pFrameBuffer)
     {
         // Memory not enough
         printf("[E] Convolver: Insufficient Memory\n");
-        sf_close(sfIRFile);
+        CloseImpulseResponse();
         return 0;
     }
     sf_readf_float(sfIRFile, pFrameBuffer, sfiIRInfo.frames);
-    sf_close(sfIRFile);
+    CloseImpulseResponse();
     if (sfiIRInfo.samplerate == targetSampleRate)
+        return pFrameBuffer;
+    double convertionRatio = (double)targetSampleRate / (double)sfiIRInfo.samplerate;
+    int outFramesPerChannel = GetImpulseResponseFrames(targetSampleRate);
+    // Frames the resampler does not generate stay silent
+    outbuf = (float*)calloc(outFramesPerChannel * sfiIRInfo.channels, sizeof(float));
+    if (!outbuf)
     {
-        final = (float*)malloc(bufferSize);
-        memcpy(final, pFrameBuffer, bufferSize);
-        // Prepare return array
-        memcpy(outbuf, final, bufferSize);
-        free(final);
-    }
-    else
-    {
-        double convertionRatio = (double)targetSampleRate / (double)sfiIRInfo.samplerate;
-        int resampledframeCountTotal = (int)((double)frameCountTotal * convertionRatio);
-        int outFramesPerChannel = (int)((double)sfiIRInfo.frames * convertionRatio);
-        bufferSize = resampledframeCountTotal * sizeof(float);
-        float *out = (float*)malloc(bufferSize);
-        int error;
-        SRC_DATA data;
-        data.data_in = pFrameBuffer;
-        data.data_out = out;
-        data.input_frames = sfiIRInfo.frames;
-        data.output_frames = outFramesPerChannel;
-        data.src_ratio = convertionRatio;
-        error = src_simple(&data, 1, sfiIRInfo.channels);
-        final = (float*)malloc(bufferSize);
-        memcpy(final, out, bufferSize);
-
-        memcpy(outbuf, final, bufferSize);
-
-        free(out);
-        free(final);
+        printf("[E] Convolver: Insufficient Memory\n");
+        free(pFrameBuffer);
+        return 0;
     }
+    SRC_DATA data;
+    data.data_in = pFrameBuffer;
+    data.data_out = outbuf;
+    data.input_frames = sfiIRInfo.frames;
+    data.output_frames = outFramesPerChannel;
+    data.src_ratio = convertionRatio;
+    src_simple(&data, 1, sfiIRInfo.channels);
     free(pFrameBuffer);
     return outbuf;
 }
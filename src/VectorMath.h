@@ -0,0 +1,95 @@
+#ifndef VECTORMATH_H
+#define VECTORMATH_H
+// Two lane double vectors through GCC/Clang vector extensions. They map to SSE2/NEON registers
+// and fall back to scalar code on targets without SIMD, so no intrinsics or build flags are needed
+typedef double v2d __attribute__((vector_size(16)));
+// Same vector without the 16 byte alignment requirement, for loads and stores at arbitrary sample offsets
+typedef double v2du __attribute__((vector_size(16), aligned(8), may_alias));
+static inline v2d v2dLoad(const double *p)
+{
+	return *(const v2du*)p;
+}
+static inline void v2dStore(double *p, v2d v)
+{
+	*(v2du*)p = v;
+}
+// len must be a multiple of 4
+static inline double VecDotProduct(const double *a, const double *b, int len)
+{
+	v2d acc0 = { 0.0, 0.0 }, acc1 = { 0.0, 0.0 };
+	for (int i = 0; i < len; i += 4)
+	{
+		acc0 += v2dLoad(a + i) * v2dLoad(b + i);
+		acc1 += v2dLoad(a + i + 2) * v2dLoad(b + i + 2);
+	}
+	acc0 += acc1;
+	return acc0[0] + acc0[1];
+}
+// Elementary functions on both lanes, fdlibm kernels without the special cases. Within about one ulp of libm
+typedef long long v2l __attribute__((vector_size(16)));
+#define V2D_ROUND_MAGIC 6755399441055744.0 // 1.5 * 2^52, adding it rounds to an integer left in the low mantissa bits
+static inline v2d v2dSelect(v2l mask, v2d a, v2d b)
+{
+	return (v2d)(((v2l)a & mask) | ((v2l)b & ~mask));
+}
+// Clamped to [-708, 709] so the result stays finite and normal
+static inline v2d v2dExp(v2d x)
+{
+	const v2d lo = { -708.0, -708.0 }, hi = { 709.0, 709.0 }, magic = { V2D_ROUND_MAGIC, V2D_ROUND_MAGIC };
+	v2d t, k, r, rr, c;
+	v2l ki;
+	x = v2dSelect(x < lo, lo, x);
+	x = v2dSelect(x > hi, hi, x);
+	t = x * 1.44269504088896338700 + magic;
+	ki = (v2l)t - (v2l)magic;
+	k = t - magic;
+	// Cody-Waite reduction to |r| <= ln(2) / 2
+	t = x - k * 6.93147180369123816490e-01;
+	k = k * 1.90821492927058770002e-10;
+	r = t - k;
+	rr = r * r;
+	c = r - rr * (1.66666666666666019037e-01 + rr * (-2.77777777770155933842e-03 + rr * (6.61375632143793436117e-05 + rr * (-1.65339022054652515390e-06 + rr * 4.13813679705723846039e-08))));
+	r = 1.0 - ((k - (r * c) / (2.0 - c)) - t);
+	return r * (v2d)((ki + 1023) << 52);
+}
+// Natural logarithm of positive normal numbers
+static inline v2d v2dLog(v2d x)
+{
+	const v2d sqrt2 = { 1.41421356237309504880, 1.41421356237309504880 }, magic = { V2D_ROUND_MAGIC, V2D_ROUND_MAGIC };
+	v2l bits = (v2l)x, e, big;
+	v2d m, f, s, z, w, R, hfsq, k;
+	e = (bits >> 52) - 1023;
+	m = (v2d)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+	// Mantissa to [sqrt(2) / 2, sqrt(2)]
+	big = m > sqrt2;
+	m = v2dSelect(big, m * 0.5, m);
+	e -= big;
+	k = (v2d)(e + (v2l)magic) - magic;
+	f = m - 1.0;
+	s = f / (2.0 + f);
+	z = s * s;
+	w = z * z;
+	R = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+	R += z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+	hfsq = 0.5 * f * f;
+	return k * 6.93147180369123816490e-01 - ((hfsq - (s * (hfsq + R) + k * 1.90821492927058770002e-10)) - f);
+}
+// Reduction by multiples of pi / 2 stays exact for |x| < 2^20 * pi / 2
+static inline void v2dSinCos(v2d x, v2d *sinx, v2d *cosx)
+{
+	const v2d magic = { V2D_ROUND_MAGIC, V2D_ROUND_MAGIC };
+	v2d t, n, y, z, sn, cs;
+	v2l q, swap;
+	t = x * 6.36619772367581382433e-01 + magic;
+	q = (v2l)t - (v2l)magic;
+	n = t - magic;
+	y = ((x - n * 1.57079632673412561417e+00) - n * 6.07710050630396597660e-11) - n * 2.02226624871116645580e-21;
+	z = y * y;
+	sn = y + y * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+	cs = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+	// Quadrant: odd ones swap sine and cosine, the sign bits come from q and q + 1
+	swap = -(q & 1);
+	*sinx = (v2d)((v2l)v2dSelect(swap, cs, sn) ^ ((q & 2) << 62));
+	*cosx = (v2d)((v2l)v2dSelect(swap, sn, cs) ^ (((q + 1) & 2) << 62));
+}
+#endif
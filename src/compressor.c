@@ -3,7 +3,10 @@
 // Project Home: https://github.com/voidqk/sndfilter
 
 #include "compressor.h"
+#include "VectorMath.h"
 #include <math.h>
+#include <float.h>
+#include <stdint.h>
 #include <string.h>
 
 // core algorithm extracted from Chromium source, DynamicsCompressorKernel.cpp, here:
@@ -22,6 +25,111 @@ static inline double lin2db(double lin)  // linear to dB
     return 20.0 * log10(lin);
 }
 
+// polynomial approximations of the curves the gain computer evaluates per sample and per update,
+// fitted on Chebyshev nodes over the ranges below. max errors measured against libm:
+//   approxlog2    absolute 4e-10 (2e-9 dB)    approxexp2   relative 3e-9
+//   approxasin90  relative 3e-10 on [0, 1]     approxsin90  absolute 3e-11 on [-1, 1]
+// the scalar versions hand arguments outside those ranges (zero, denormals, infinities, NaN) to libm,
+// so the special values the fixf guards below rely on come out the same. define SF_COMPRESSOR_EXACT to
+// use libm throughout
+#define LOG2_10_20 0.16609640474436811 // log2(10) / 20
+#define DB_LOG2 6.0205999132796239      // 20 * log10(2)
+#define LOG2_E 1.4426950408889634       // log2(e)
+
+// positive normal numbers only
+static inline v2d approxlog2v(v2d x)
+{
+    // x = 2^e * m with m in [sqrt(1/2), sqrt(2)), log2(m) = s * P(s^2) with s = (m - 1) / (m + 1)
+    const v2d magic = { V2D_ROUND_MAGIC, V2D_ROUND_MAGIC };
+    v2l bits = (v2l)x;
+    v2l e = (bits >> 52) - 1023;
+    v2d m = (v2d)((bits & 0x000FFFFFFFFFFFFFll) | 0x3FF0000000000000ll);
+    v2l big = m > 1.4142135623730951;
+    m = v2dSelect(big, m * 0.5, m);
+    e -= big;
+    v2d s = (m - 1.0) / (m + 1.0);
+    v2d z = s * s;
+    return ((v2d)((v2l)magic + e) - magic) + s * (2.8853900797912018 + z * (0.96179884624827228 +
+        z * (0.57671451028007359 + z * 0.43173301737389536)));
+}
+
+// saturates outside (-1022, 1023)
+static inline v2d approxexp2v(v2d x)
+{
+    // 2^x = 2^n * 2^f with n the nearest integer and f in [-0.5, 0.5]
+    const v2d lo = { -1021.0, -1021.0 }, hi = { 1022.0, 1022.0 }, magic = { V2D_ROUND_MAGIC, V2D_ROUND_MAGIC };
+    x = v2dSelect(x < lo, lo, x);
+    x = v2dSelect(x > hi, hi, x);
+    v2d t = x + magic;
+    v2d f = x - (t - magic);
+    v2l n = (v2l)t - (v2l)magic;
+    return (v2d)((n + 1023) << 52) * (0.99999999995954825 + f * (0.69314720671061969 +
+        f * (0.24022651213593738 + f * (0.05550327214207524 + f * (0.0096180256031652787 +
+        f * (0.0013400432166054089 + f * 0.00015469731913299257))))));
+}
+
+static inline double approxlog2(double x)
+{
+#ifndef SF_COMPRESSOR_EXACT
+    if (x >= DBL_MIN && x <= DBL_MAX)
+        return approxlog2v((v2d){ x, x })[0];
+#endif
+    return log2(x);
+}
+
+static inline double approxexp2(double x)
+{
+#ifndef SF_COMPRESSOR_EXACT
+    if (x > -1022.0 && x < 1023.0)
+        return approxexp2v((v2d){ x, x })[0];
+#endif
+    return exp2(x);
+}
+
+static inline double approxdb2lin(double db)
+{
+    return approxexp2(db * LOG2_10_20);
+}
+
+static inline double approxlin2db(double lin)
+{
+    return approxlog2(lin) * DB_LOG2;
+}
+
+// asin(x) / (pi / 2), odd x * Q(x^2) up to 1/2 so small gains keep their relative accuracy through the
+// division by it, above as 1 - sqrt(1 - x) * P(x) to take up the square root singularity at 1
+static inline double approxasin90(double x)
+{
+#ifndef SF_COMPRESSOR_EXACT
+    if (x >= 0.0 && x <= 0.5)
+    {
+        double z = x * x;
+        return x * (0.63661977252374569 + z * (0.10610323521638725 + z * (0.047750248541989601 +
+            z * (0.028332917099289718 + z * (0.020298075436148793 + z * (0.0090392559726024009 +
+            z * 0.024068275559693576))))));
+    }
+    if (x > 0.5 && x <= 1.0)
+        return 1.0 - sqrt(1.0 - x) * (0.99995892979702572 + x * (-0.13618153825421744 +
+            x * (0.054645146586245724 + x * (-0.026816652354515608 + x * (0.011769106711026326 +
+            x * (-0.003590514819370583 + x * 0.00053183871175860992))))));
+#endif
+    return asin(x) * 0.636619772367581;
+}
+
+// sin(x * pi / 2), odd so x * Q(x^2)
+static inline double approxsin90(double x)
+{
+#ifndef SF_COMPRESSOR_EXACT
+    if (x >= -1.0 && x <= 1.0)
+    {
+        double z = x * x;
+        return x * (1.5707963267681437 + z * (-0.6459640955780438 + z * (0.079692603716958507 +
+            z * (-0.0046816577951921097 + z * (0.0001602546907378155 + z * -3.4318291989166029e-06)))));
+    }
+#endif
+    return sin(x * 1.570796326794897);
+}
+
 // for more information on the knee curve, check out the compressor-curve.html demo + source code
 // included in this repo
 static inline double kneecurve(double x, double k, double linearthreshold)
@@ -129,6 +237,7 @@ void sf_advancecomp(sf_compressor_state_st *state, int rate, double pregain, dou
     state->k                    = k;
     state->kneedboffset         = kneedboffset;
     state->linearthresholdknee  = linearthresholdknee;
+    state->attenuationoffsetdb  = knee > 0.0 ? kneedboffset - slope * (threshold + knee) : threshold * (1.0 - slope);
     state->mastergain           = mastergain;
     state->a                    = a;
     state->b                    = b;
@@ -169,6 +278,91 @@ static inline double fixf(double v, double def)
     return v;
 }
 
+// the detector's target for one input peak, compcurve(inputmax) / inputmax, and the rate it releases
+// towards it at. above the knee the curve is a line in dB, so a sample costs one log and two exps
+static inline void detectorcurve(const sf_compressor_state_st *state, double inputmax, double *attenuation,
+                                 double *releaserate)
+{
+    double attenuationdb;
+    if (!(inputmax <= DBL_MAX)) // infinity or NaN, left to the curve in linear terms like before
+    {
+        *attenuation = compcurve(inputmax, state->k, state->slope, state->linearthreshold, state->linearthresholdknee,
+                                 state->threshold, state->knee, state->kneedboffset) / inputmax;
+        attenuationdb = lin2db(*attenuation);
+    }
+    else if (inputmax < 0.0001 || inputmax < state->linearthreshold)
+    {
+        *attenuation = 1.0;
+        attenuationdb = 0.0;
+    }
+    else if (state->knee > 0.0 && inputmax < state->linearthresholdknee)
+    {
+        double k = state->k, linearthreshold = state->linearthreshold;
+        *attenuation = (linearthreshold + (1.0 - approxexp2(-k * (inputmax - linearthreshold) * LOG2_E)) / k) / inputmax;
+        attenuationdb = approxlin2db(*attenuation);
+    }
+    else
+    {
+        attenuationdb = state->attenuationoffsetdb + (state->slope - 1.0) * approxlin2db(inputmax);
+        *attenuation = approxdb2lin(attenuationdb);
+    }
+    attenuationdb = -attenuationdb;
+    if (attenuationdb < 2.0)
+        attenuationdb = 2.0;
+    double dbpersample = attenuationdb * state->satreleasesamplesinv;
+    *releaserate = approxdb2lin(dbpersample) - 1.0;
+}
+
+// detectorcurve for the SF_COMPRESSOR_SPU frames of one update. none of it depends on the detector
+// state, so it runs ahead of the serial envelope loop, two frames per vector. peaks that are not
+// finite go through the scalar version
+static inline void detectorcurves(const sf_compressor_state_st *state, const double *inputL, const double *inputR,
+                                  double *attenuation, double *releaserate)
+{
+#ifdef SF_COMPRESSOR_EXACT
+    for (int i = 0; i < SF_COMPRESSOR_SPU; i++)
+    {
+        double inL = absf(inputL[i] * state->linearpregain);
+        double inR = absf(inputR[i] * state->linearpregain);
+        detectorcurve(state, inL > inR ? inL : inR, attenuation + i, releaserate + i);
+    }
+#else
+    const v2d zero = { 0.0, 0.0 }, one = { 1.0, 1.0 }, two = { 2.0, 2.0 }, quiet = { 0.0001, 0.0001 };
+    const v2d linearthreshold = { state->linearthreshold, state->linearthreshold };
+    const v2d linearthresholdknee = { state->linearthresholdknee, state->linearthresholdknee };
+    const v2d dblmax = { DBL_MAX, DBL_MAX };
+    const v2l absmask = { 0x7FFFFFFFFFFFFFFFll, 0x7FFFFFFFFFFFFFFFll };
+    const v2l kneemask = { -(state->knee > 0.0), -(state->knee > 0.0) };
+    const double k = state->k, kinv = 1.0 / state->k, releasescale = state->satreleasesamplesinv * LOG2_10_20;
+    for (int i = 0; i < SF_COMPRESSOR_SPU; i += 2)
+    {
+        v2d inL = (v2d)((v2l)(v2dLoad(inputL + i) * state->linearpregain) & absmask);
+        v2d inR = (v2d)((v2l)(v2dLoad(inputR + i) * state->linearpregain) & absmask);
+        v2d inputmax = v2dSelect(inL > inR, inL, inR);
+        v2l below = (inputmax < quiet) | (inputmax < linearthreshold);
+        v2l inknee = ~below & kneemask & (inputmax < linearthresholdknee);
+        v2d attenuationdb = state->attenuationoffsetdb + (state->slope - 1.0) * DB_LOG2 * approxlog2v(inputmax);
+        v2d att = approxexp2v(attenuationdb * LOG2_10_20);
+        if (inknee[0] | inknee[1])
+        {
+            v2d kneeatt = (linearthreshold + (1.0 - approxexp2v((linearthreshold - inputmax) * (k * LOG2_E))) * kinv) / inputmax;
+            att = v2dSelect(inknee, kneeatt, att);
+            attenuationdb = v2dSelect(inknee, DB_LOG2 * approxlog2v(kneeatt), attenuationdb);
+        }
+        attenuationdb = v2dSelect(below, zero, attenuationdb);
+        v2dStore(attenuation + i, v2dSelect(below, one, att));
+        attenuationdb = -attenuationdb;
+        attenuationdb = v2dSelect(attenuationdb < two, two, attenuationdb);
+        v2dStore(releaserate + i, approxexp2v(attenuationdb * releasescale) - 1.0);
+        v2l special = ~(inputmax <= dblmax);
+        if (special[0] | special[1])
+            for (int j = 0; j < 2; j++)
+                if (special[j])
+                    detectorcurve(state, inputmax[j], attenuation + i + j, releaserate + i + j);
+    }
+#endif
+}
+
 void sf_compressor_process(sf_compressor_state_st *state, int size, double *inputL, double *inputR, double *outputL, double *outputR)
 {
     // pull out the state into local variables
@@ -176,16 +370,8 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, double *inpu
     double metergain            = state->metergain;
     double meterrelease         = state->meterrelease;
 #endif
-    double threshold            = state->threshold;
-    double knee                 = state->knee;
     double linearpregain        = state->linearpregain;
-    double linearthreshold      = state->linearthreshold;
-    double slope                = state->slope;
     double attacksamplesinv     = state->attacksamplesinv;
-    double satreleasesamplesinv = state->satreleasesamplesinv;
-    double k                    = state->k;
-    double kneedboffset         = state->kneedboffset;
-    double linearthresholdknee  = state->linearthresholdknee;
     double mastergain           = state->mastergain;
     double a                    = state->a;
     double b                    = state->b;
@@ -200,15 +386,13 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, double *inpu
     double *delaybufL           = state->delaybufL;
     double *delaybufR           = state->delaybufR;
     int chunks = size / SF_COMPRESSOR_SPU;
-    double ang90 = 1.570796326794897;
-    double ang90inv = 0.636619772367581;
     int samplepos = 0;
     for (int ch = 0; ch < chunks; ch++)
     {
         detectoravg = fixf(detectoravg, 1.0);
         double desiredgain = detectoravg;
-        double scaleddesiredgain = asin(desiredgain) * ang90inv;
-        double compdiffdb = lin2db(compgain / scaleddesiredgain);
+        double scaleddesiredgain = approxasin90(desiredgain);
+        double compdiffdb = approxlin2db(compgain / scaleddesiredgain);
         // calculate envelope rate based on whether we're attacking or releasing
         double enveloperate;
         if (compdiffdb < 0.0)  // compgain < scaleddesiredgain, so we're releasing
@@ -219,7 +403,7 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, double *inpu
             // scale compdiffdb between 0-3
             double x = (clampf(compdiffdb, -12.0, 0.0) + 12.0) * 0.25;
             double releasesamples = adaptivereleasecurve(x, a, b, c, d);
-            enveloperate = db2lin(SF_COMPRESSOR_SPACINGDB / releasesamples);
+            enveloperate = approxdb2lin(SF_COMPRESSOR_SPACINGDB / releasesamples);
         }
         else  // compresorgain > scaleddesiredgain, so we're attacking
         {
@@ -229,41 +413,21 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, double *inpu
             double attenuate = maxcompdiffdb;
             if (attenuate < 0.5)
                 attenuate = 0.5;
-            enveloperate = 1.0 - pow(0.25 / attenuate, attacksamplesinv);
+            enveloperate = 1.0 - approxexp2(attacksamplesinv * approxlog2(0.25 / attenuate));
         }
         // process the chunk
+        double attenuation[SF_COMPRESSOR_SPU], releaserate[SF_COMPRESSOR_SPU];
+        detectorcurves(state, inputL + samplepos, inputR + samplepos, attenuation, releaserate);
         for (int chi = 0; chi < SF_COMPRESSOR_SPU; chi++, samplepos++,
-                delayreadpos = (delayreadpos + 1) % delaybufsize,
-                delaywritepos = (delaywritepos + 1) % delaybufsize)
+                delayreadpos = delayreadpos + 1 == delaybufsize ? 0 : delayreadpos + 1,
+                delaywritepos = delaywritepos + 1 == delaybufsize ? 0 : delaywritepos + 1)
         {
             double inL = inputL[samplepos] * linearpregain;
             double inR = inputR[samplepos] * linearpregain;
             delaybufL[delaywritepos] = inL;
             delaybufR[delaywritepos] = inR;
-            inL = absf(inL);
-            inR = absf(inR);
-            double inputmax = inL > inR ? inL : inR;
-            double attenuation;
-            if (inputmax < 0.0001)
-                attenuation = 1.0;
-            else
-            {
-                double inputcomp = compcurve(inputmax, k, slope, linearthreshold,
-                                            linearthresholdknee, threshold, knee, kneedboffset);
-                attenuation = inputcomp / inputmax;
-            }
-            double rate;
-            if (attenuation > detectoravg)  // if releasing
-            {
-                double attenuationdb = -lin2db(attenuation);
-                if (attenuationdb < 2.0)
-                    attenuationdb = 2.0;
-                double dbpersample = attenuationdb * satreleasesamplesinv;
-                rate = db2lin(dbpersample) - 1.0;
-            }
-            else
-                rate = 1.0;
-            detectoravg += (attenuation - detectoravg) * rate;
+            double rate = attenuation[chi] > detectoravg ? releaserate[chi] : 1.0; // release or attack
+            detectoravg += (attenuation[chi] - detectoravg) * rate;
             if (detectoravg > 1.0)
                 detectoravg = 1.0;
             detectoravg = fixf(detectoravg, 1.0);
@@ -276,11 +440,11 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, double *inpu
                     compgain = 1.0;
             }
             // the final gain value!
-            double premixgain = sin(ang90 * compgain);
+            double premixgain = approxsin90(compgain);
             double gain = mastergain * premixgain;
 #ifdef METER
             // calculate metering (not used in core algo, but used to output a meter if desired)
-            double premixgaindb = lin2db(premixgain);
+            double premixgaindb = approxlin2db(premixgain);
             if (premixgaindb < metergain)
                 metergain = premixgaindb; // spike immediately
             else
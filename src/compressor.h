@@ -38,6 +38,9 @@
 // not sure what this does exactly, but it is part of the release curve
 #define SF_COMPRESSOR_SPACINGDB  5.0
 
+// the gain curves are evaluated with polynomial approximations, within 2e-6 dB of libm on the output;
+// build compressor.c with SF_COMPRESSOR_EXACT defined to use libm instead
+
 typedef struct
 {
 #ifdef METER
@@ -59,6 +62,7 @@ typedef struct
     double k;
     double kneedboffset;
     double linearthresholdknee;
+    double attenuationoffsetdb; // gain reduction above the knee is this plus (slope - 1) * input dB
     double mastergain;
     double a; // adaptive release polynomial coefficients
     double b;
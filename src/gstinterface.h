@@ -20,7 +20,6 @@
 #define NUM_BANDS 15
 
 char* memory_read_ascii(char *path);
-void helper_strreplace(char*,const char*,const char*);
 
 ///Sends 16bit int data
 void command_set_px4_vx2x1(EffectDSPMain *intf,int32_t cmd,int16_t value){
@@ -144,7 +143,7 @@ void command_set_buffercfg(EffectDSPMain *intf,int32_t samplerate,int32_t format
     intf->command(EFFECT_CMD_SET_CONFIG, sizeof(uint32_t)+sizeof(uint8_t),cep,NULL,NULL);
 }
 ///Prepare and send Convolver data
-void command_set_convolver(EffectDSPMain *intf,char* path,float gain,int quality,char* str_c0,char* str_c1,int32_t sr){
+void command_set_convolver(EffectDSPMain *intf,char* path,float gain,int quality,int noiseFloor,char* str_c0,char* str_c1,int32_t sr){
     if(!path || path == NULL){
         printf("[E] Convolver path is NULL\n");
         return;
@@ -195,14 +194,31 @@ void command_set_convolver(EffectDSPMain *intf,char* path,float gain,int quality
     command_set_px4_vx10x4(intf,1997,c0);
     command_set_px4_vx10x4(intf,1998,c1);
 
-    float* impulseResponse = ReadImpulseResponseToFloat(sr);
+    int frameCountTotal = impinfo[0]*GetImpulseResponseFrames(sr);
+    int impulseCutted = (int)(frameCountTotal * (quality/100.0));
+
+    //Partitions already transformed for this file, rate and plan are mapped from the cache without decoding the file
+    uint64_t contentHash;
+    if (DiskCacheHashFile(path, &contentHash) &&
+        intf->_loadConvCached(contentHash,impulseCutted/impinfo[0],impinfo[0],gain,noiseFloor)){
+        printf("---- Convolver spectra loaded from cache, Frames: %d, Channels: %d\n",impulseCutted/impinfo[0],impinfo[0]);
+        CloseImpulseResponse();
+        free(impinfo);
+        return;
+    }
 
-    int frameCountTotal = impinfo[0]*impinfo[1];
-    int impulseCutted = (int)(frameCountTotal * (quality/100));
+    float* impulseResponse = ReadImpulseResponseToFloat(sr);
+    if (impulseResponse == NULL){
+        printf("[E] Convolver: ReadImpulseResponseToFloat returned NULL\n");
+        free(impinfo);
+        return;
+    }
 
     printf("---- Format: %d, Frames: %d, ImpulseCutted: %d, Channels: %d, Gain: %f, Quality %d\n",impinfo[3],impinfo[1],impulseCutted,impinfo[0],gain,quality);
 
-    intf->_loadConv(impulseCutted,impinfo[0],gain,impulseResponse);
+    intf->_loadConv(impulseCutted,impinfo[0],gain,impulseResponse,noiseFloor);
+    free(impulseResponse);
+    free(impinfo);
 }
 ///Load and send DDC data
 void command_set_ddc(EffectDSPMain *intf,char* path,bool enabled){
@@ -210,36 +226,38 @@ void command_set_ddc(EffectDSPMain *intf,char* path,bool enabled){
         printf("[E] DDC path is NULL\n");
         return;
     }
-    int p = 0;
-    for (int i = 0; i < strlen(path); ++i) {
-        p |= path[i];
-    }
-    if (p == 0) {
+    if (path[0] == 0) {
         printf("[E] DDC path char array contains zero data\n");
         return;
     }
+
+    //Sections compiled from this file before are mapped from the cache without parsing the text
+    uint64_t contentHash;
+    if (DiskCacheHashFile(path, &contentHash) && intf->_loadDDCCached(contentHash)){
+        printf("---- DDC loaded from cache\n");
+        command_set_px4_vx2x1(intf,1212,enabled);
+        return;
+    }
+
     char *ddcString = memory_read_ascii(path);
     if(!ddcString || ddcString == NULL){
         printf("[E] File reader returned a null pointer. Probably unable to open DDC file\n");
         return;
     }
-    int d = 0;
-    for (int i = 0; i < strlen(ddcString); ++i) {
-        d |= ddcString[i];
-    }
-    if (d == 0) {
+    if (ddcString[0] == 0) {
         printf("[E] DDC coeffs char array contains zero data\n");
+        free(ddcString);
         return;
     }
     int begin = strcspn(ddcString,"S");
     if(strcspn(ddcString,"R")!=begin+1){ //check for 'SR' in the string
         printf("[E] Invalid DDC string\n");
+        free(ddcString);
         return;
     }
-    helper_strreplace(ddcString,"NaN","0"); //Prevent white noise at full blast caused by invalid SOS data
-    helper_strreplace(ddcString,"nan","0");
-    helper_strreplace(ddcString,"null","0");
+    //NaN and null coefficients are zeroed by the parser
     intf->_loadDDC(ddcString);
+    free(ddcString);
     command_set_px4_vx2x1(intf,1212,enabled);
 }
 ///Prepare and send limiter data as 32-bit float array
@@ -284,6 +302,10 @@ void command_set_eq(EffectDSPMain *intf,char* eq){
     command_set_px4_vx4x60(intf,115,(float*)data);
 
 }
+///Send a frequency/gain node list for the equalizer, empty or NULL returns to the 15 bands
+void command_set_eq_nodes(EffectDSPMain *intf,char* nodes){
+    intf->_loadEqNodes(nodes);
+}
 ///Sends command-codes without parameters
 void config_set_px0_vx0x0(EffectDSPMain *intf,uint32_t param){
     intf->command(param,NULL,NULL,NULL,NULL);
@@ -310,56 +332,24 @@ void command_set_reverb(EffectDSPMain *intf,Gstjdspfx * self){
     r->delay = (double)(self->headset_delay/1000);
     intf->_loadReverb(r);
 }
-///Read ascii-data from file
+///Read ascii-data from file, NUL-terminated
 char* memory_read_ascii(char *path){
-    int c; long size; FILE *file;
-    int i = 0;
-    file = fopen(path, "r");
+    long size; FILE *file;
+    file = fopen(path, "rb");
     if (file) {
         fseek(file, 0, SEEK_END);
         size = ftell(file);
         fseek(file, 0, SEEK_SET);
-        char *buffer = (char*)malloc(size*sizeof(char));
-        while ((c = getc(file)) != EOF) {
-            buffer[i] = (char)c;
-            i++;
+        if (size < 0) {
+            fclose(file);
+            return NULL;
         }
+        char *buffer = (char*)malloc(size + 1);
+        if (buffer)
+            buffer[fread(buffer, 1, size, file)] = 0;
         fclose(file);
         return buffer;
     }
     return NULL;
 }
-///Replace all occurrences of 'str' with 'rep' in 'src'
-void helper_strreplace(char *target, const char *needle, const char *replacement)
-{
-    char buffer[strlen(target)] = { 0 };
-    char *insert_point = &buffer[0];
-    const char *tmp = target;
-    size_t needle_len = strlen(needle);
-    size_t repl_len = strlen(replacement);
-
-    while (1) {
-        const char *p = strstr(tmp, needle);
-
-        // walked past last occurrence of needle; copy remaining part
-        if (p == NULL) {
-            strcpy(insert_point, tmp);
-            break;
-        }
-
-        // copy part before needle
-        memcpy(insert_point, tmp, p - tmp);
-        insert_point += p - tmp;
-
-        // copy replacement string
-        memcpy(insert_point, replacement, repl_len);
-        insert_point += repl_len;
-
-        // adjust pointers, move on
-        tmp = p + needle_len;
-    }
-
-    // write altered string back to target
-    strcpy(target, buffer);
-}
 #endif //GST_PLUGIN_JAMESDSP_GSTINTERFACE_H
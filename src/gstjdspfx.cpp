@@ -68,6 +68,7 @@ enum {
     PROP_HEADSET_LPF_OUTPUT,
     PROP_HEADSET_DECAY,
     PROP_HEADSET_DELAY,
+    PROP_HEADSET_ENGINE,
    /* stereo wide */
     PROP_STEREOWIDE_MCOEFF,
     PROP_STEREOWIDE_SCOEFF,
@@ -88,6 +89,7 @@ enum {
     PROP_TONE_ENABLE,
     PROP_TONE_FILTERTYPE,
     PROP_TONE_EQ,
+    PROP_TONE_NODES,
     /* limiter */
     PROP_MASTER_LIMTHRESHOLD,
     PROP_MASTER_LIMRELEASE,
@@ -100,6 +102,8 @@ enum {
     PROP_CONVOLVER_BENCH_C0,
     PROP_CONVOLVER_BENCH_C1,
     PROP_CONVOLVER_FILE,
+    PROP_CONVOLVER_NOISE_FLOOR,
+    PROP_CONVOLVER_SINGLE_PRECISION,
 };
 
 #define ALLOWED_CAPS \
@@ -248,6 +252,10 @@ gst_jdspfx_class_init(GstjdspfxClass *klass) {
                                     g_param_spec_int("headset-delay", "ReverbDelay", "Delay in milliseconds",
                                                      -500, 500, 0,
                                                      (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
+    g_object_class_install_property(gobject_class, PROP_HEADSET_ENGINE,
+                                    g_param_spec_int("headset-engine", "ReverbEngine", "Reverb algorithm, 0: Progenitor2, 1: Feedback delay network (low CPU)",
+                                                     0, 1, 0,
+                                                     (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
     g_object_class_install_property(gobject_class, PROP_HEADSET_LPF_INPUT,
                                     g_param_spec_int("headset-lpf-input", "ReverbLPFInput", "Lowpass cutoff for input (Hz)",
                                                       200, 18000, 200,
@@ -336,13 +344,16 @@ gst_jdspfx_class_init(GstjdspfxClass *klass) {
                                                          FALSE,
                                                          (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
     g_object_class_install_property(gobject_class, PROP_TONE_FILTERTYPE,
-                                    g_param_spec_int("tone-filtertype", "EqFilter", "Equalizer filter type (Minimum/Linear phase)",
-                                                     0, 1, 0,
+                                    g_param_spec_int("tone-filtertype", "EqFilter", "Equalizer filter type (Minimum/Linear phase FIR, IIR biquad cascade)",
+                                                     0, 2, 0,
                                                      (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
 
     g_object_class_install_property (gobject_class, PROP_TONE_EQ,
                                      g_param_spec_string ("tone-eq", "EQCustom", "15-band EQ data (ex: 1200;50;-200;-500;-500;-500;-500;-450;-250;0;-300;-50;0;0;50) 100=1dB; min: -12dB, max: 12dB",
                                                           "0;0;0;0;0;0;0;0;0;0;0;0;0;0;0", (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
+    g_object_class_install_property (gobject_class, PROP_TONE_NODES,
+                                     g_param_spec_string ("tone-nodes", "EQNodes", "Arbitrary EQ as frequency (Hz) and gain (dB) pairs, any length (ex: GraphicEQ: 20 -1.5; 31 0.5; 10000 -3). Replaces tone-eq while not empty",
+                                                          "", (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
 
 
     /* limiter */
@@ -387,6 +398,15 @@ gst_jdspfx_class_init(GstjdspfxClass *klass) {
     g_object_class_install_property (gobject_class, PROP_CONVOLVER_FILE,
                                      g_param_spec_string ("convolver-file", "ConvFile", "Impulse response file",
                                                           "", (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
+    g_object_class_install_property(gobject_class, PROP_CONVOLVER_NOISE_FLOOR,
+                                    g_param_spec_int("convolver-noise-floor", "ConvNoiseFloor", "Impulse response tail and leading silence below this level are trimmed (dB, 0 disables)",
+                                                     -200, 0, -90,
+                                                     (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
+    g_object_class_install_property(gobject_class, PROP_CONVOLVER_SINGLE_PRECISION,
+                                    g_param_spec_boolean("convolver-single-precision", "ConvSinglePrecision",
+                                                         "Store impulse response spectra in single precision, halving their memory (applies to the next loaded file)",
+                                                         FALSE,
+                                                         (GParamFlags)(G_PARAM_WRITABLE | GST_PARAM_CONTROLLABLE)));
 
 
 
@@ -438,6 +458,9 @@ static void sync_all_parameters(Gstjdspfx * self) {
                           1201, self->bass_enabled);
 
     // reverb
+    command_set_px4_vx2x1(self->effectDspMain,
+                          129, self->headset_engine);
+
     command_set_reverb(self->effectDspMain, self);
 
     command_set_px4_vx2x1(self->effectDspMain,
@@ -477,6 +500,7 @@ static void sync_all_parameters(Gstjdspfx * self) {
 
     // mixed equalizer
     command_set_eq (self->effectDspMain, self->tone_eq);
+    command_set_eq_nodes (self->effectDspMain, self->tone_nodes);
     command_set_px4_vx2x1(self->effectDspMain,
                           151, (int16_t)self->tone_filtertype);
     command_set_px4_vx2x1(self->effectDspMain,
@@ -491,7 +515,9 @@ static void sync_all_parameters(Gstjdspfx * self) {
                           1212, self->ddc_enabled);
 
     // convolver
-    command_set_convolver(self->effectDspMain, self->convolver_file,self->convolver_gain,self->convolver_quality,
+    command_set_px4_vx2x1(self->effectDspMain,
+                          160, self->convolver_single_precision);
+    command_set_convolver(self->effectDspMain, self->convolver_file,self->convolver_gain,self->convolver_quality,self->convolver_noise_floor,
                           self->convolver_bench_c0,self->convolver_bench_c1,self->samplerate);
     command_set_px4_vx2x1(self->effectDspMain,
                           1205, self->convolver_enabled);
@@ -520,6 +546,7 @@ gst_jdspfx_init(Gstjdspfx * self) {
 
     self->headset_osf=1;
     self->headset_delay=0;
+    self->headset_engine=0;
     self->headset_inputlpf=200;
     self->headset_basslpf=50;
     self->headset_damplpf=200;
@@ -553,6 +580,7 @@ gst_jdspfx_init(Gstjdspfx * self) {
     self->tone_enabled = FALSE;
     memset (self->tone_eq, 0,
             sizeof(self->tone_eq));
+    self->tone_nodes = NULL;
     self->lim_threshold = 0;
     self->lim_release = 60;
     self->ddc_enabled = FALSE;
@@ -572,6 +600,8 @@ gst_jdspfx_init(Gstjdspfx * self) {
             sizeof(self->convolver_file));
     self->convolver_gain = 0;
     self->convolver_quality = 100;
+    self->convolver_noise_floor = -90;
+    self->convolver_single_precision = FALSE;
 
     /* initialize private resources */
     self->effectDspMain = NULL;
@@ -594,6 +624,7 @@ gst_jdspfx_finalize(GObject *object) {
     if (self->effectDspMain != NULL) {
         delete self->effectDspMain;
     }
+    g_free(self->tone_nodes);
 
     g_mutex_clear(&self->lock);
 
@@ -685,6 +716,14 @@ gst_jdspfx_set_property(GObject *object, guint prop_id,
             g_mutex_unlock(&self->lock);
         }
             break;
+        case PROP_HEADSET_ENGINE: {
+            g_mutex_lock(&self->lock);
+            self->headset_engine = g_value_get_int(value);
+            command_set_px4_vx2x1(self->effectDspMain,
+                                  129, self->headset_engine);
+            g_mutex_unlock(&self->lock);
+        }
+            break;
         case PROP_HEADSET_LPF_INPUT: {
             g_mutex_lock(&self->lock);
             self->headset_inputlpf = g_value_get_int(value);
@@ -932,6 +971,15 @@ gst_jdspfx_set_property(GObject *object, guint prop_id,
             g_mutex_unlock (&self->lock);
         }
             break;
+        case PROP_TONE_NODES:
+        {
+            g_mutex_lock (&self->lock);
+            g_free(self->tone_nodes);
+            self->tone_nodes = g_value_dup_string (value);
+            command_set_eq_nodes (self->effectDspMain, self->tone_nodes);
+            g_mutex_unlock (&self->lock);
+        }
+            break;
         case PROP_MASTER_LIMTHRESHOLD:
         {
             g_mutex_lock (&self->lock);
@@ -1008,6 +1056,21 @@ gst_jdspfx_set_property(GObject *object, guint prop_id,
             g_mutex_unlock (&self->lock);
         }
             break;
+        case PROP_CONVOLVER_NOISE_FLOOR:
+        {
+            g_mutex_lock (&self->lock);
+            self->convolver_noise_floor = g_value_get_int(value);
+            g_mutex_unlock (&self->lock);
+        }
+            break;
+        case PROP_CONVOLVER_SINGLE_PRECISION: {
+            g_mutex_lock(&self->lock);
+            self->convolver_single_precision = g_value_get_boolean(value);
+            command_set_px4_vx2x1(self->effectDspMain,
+                                  160, self->convolver_single_precision);
+            g_mutex_unlock(&self->lock);
+        }
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
             break;
@@ -1079,7 +1142,7 @@ gst_jdspfx_transform_ip(GstBaseTransform *base, GstBuffer *buf) {
         filter->samplerate = GST_AUDIO_FILTER_RATE(filter);
         g_mutex_lock(&filter->lock);
         command_set_buffercfg(filter->effectDspMain,filter->samplerate,filter->format);
-        command_set_convolver(filter->effectDspMain, filter->convolver_file,filter->convolver_gain,filter->convolver_quality,
+        command_set_convolver(filter->effectDspMain, filter->convolver_file,filter->convolver_gain,filter->convolver_quality,filter->convolver_noise_floor,
                               filter->convolver_bench_c0,filter->convolver_bench_c1,filter->samplerate);
         g_mutex_unlock(&filter->lock);
     }
@@ -51,6 +51,7 @@ struct _Gstjdspfx {
     gboolean headset_enabled;
     gint32 headset_osf;
     gint32 headset_delay;
+    gint32 headset_engine;
     gint32 headset_inputlpf;
     gint32 headset_basslpf;
     gint32 headset_damplpf;
@@ -91,6 +92,7 @@ struct _Gstjdspfx {
     gboolean tone_enabled;
     gint32 tone_filtertype;
     gchar tone_eq[64];
+    gchar *tone_nodes;
 
     // master
     gfloat lim_threshold;
@@ -103,6 +105,8 @@ struct _Gstjdspfx {
     // convolver
     gboolean convolver_enabled;
     gint32 convolver_quality;
+    gint32 convolver_noise_floor;
+    gboolean convolver_single_precision;
     gfloat convolver_gain;
     gchar convolver_bench_c0[128];
     gchar convolver_bench_c1[128];
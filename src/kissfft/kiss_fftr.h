@@ -46,6 +46,13 @@ void kiss_fftri(kiss_fftr_cfg cfg,const kiss_fft_cpx *freqdata,kiss_fft_scalar *
  output timedata has nfft scalar points
 */
 
+void kiss_fftr_tmpbuf(kiss_fftr_cfg cfg,const kiss_fft_scalar *timedata,kiss_fft_cpx *freqdata,kiss_fft_cpx *tmpbuf);
+void kiss_fftri_tmpbuf(kiss_fftr_cfg cfg,const kiss_fft_cpx *freqdata,kiss_fft_scalar *timedata,kiss_fft_cpx *tmpbuf);
+/*
+ Same as above with caller owned scratch of nfft/2 complex points, so one cfg can be
+ shared by concurrent callers
+*/
+
 #define kiss_fftr_free KISS_FFT_FREE
 
 #ifdef __cplusplus
@@ -8,9 +8,12 @@
 // Using in: JamesDSPManager
 
 #include "reverb.h"
+#include "VectorMath.h"
 #include <math.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 
 // utility functions
 static inline double db2lin(double db){ // dB to linear
@@ -25,6 +28,31 @@ static inline double clampf(double v, double min, double max){
 	return v < min ? min : (v > max ? max : v);
 }
 
+// advances a circular buffer position, cheaper than a modulo
+static inline int wrapinc(int pos, int size){
+	return ++pos == size ? 0 : pos;
+}
+
+// bump allocator over the state's delay memory. building the reverb runs twice, first without a
+// base to add up the sizes, then with the allocated block to hand out zeroed slices
+typedef struct
+{
+    double *base;
+    size_t used;
+} rv_arena;
+
+static double *arena_take(rv_arena *arena, int count)
+{
+    double *p = NULL;
+    if (arena->base)
+    {
+        p = arena->base + arena->used;
+        memset(p, 0, sizeof(double) * count);
+    }
+    arena->used += count;
+    return p;
+}
+
 static int isprime(int v)
 {
     if (v < 0)
@@ -51,23 +79,6 @@ static inline int nextprime(int v)
     return v;
 }
 
-// generate a random double [0, 1) using a simple (but good quality) RNG
-static inline double randdouble()
-{
-    static uint32_t seed = 123; // doesn't matter
-    static uint32_t i = 456; // doesn't matter
-    uint32_t m = 0x5bd1e995;
-    uint32_t k = i++ * m;
-    seed = (k ^ (k >> 24) ^ (seed * m)) * m;
-    uint32_t R = (seed ^ (seed >> 13)) & 0x007FFFFF; // get 23 random bits
-    union
-    {
-        uint32_t i;
-        double f;
-    } u = { u.i = 0x3F800000 | R };
-    return u.f - 1.0;
-}
-
 //
 //
 // component implementation
@@ -80,18 +91,18 @@ static inline double randdouble()
 //
 // delay
 //
-static inline void delay_make(sf_rv_delay_st *delay, int size)
+static inline void delay_make(sf_rv_delay_st *delay, rv_arena *arena, int size)
 {
     delay->pos = 0;
-    delay->size = clampi(size, 1, SF_REVERB_DS);
-    memset(delay->buf, 0, sizeof(double) * delay->size);
+    delay->size = size < 1 ? 1 : size;
+    delay->buf = arena_take(arena, delay->size);
 }
 
 static inline double delay_step(sf_rv_delay_st *delay, double v)
 {
     double out = delay->buf[delay->pos];
     delay->buf[delay->pos] = v;
-    delay->pos = (delay->pos + 1) % delay->size;
+    delay->pos = wrapinc(delay->pos, delay->size);
     return out;
 }
 
@@ -170,24 +181,6 @@ static inline void biquad_makeLPF(sf_rv_biquad_st *biquad, int rate, double freq
     biquad->yn2 = 0;
 }
 
-static inline void biquad_makeLPFQ(sf_rv_biquad_st *biquad, int rate, double freq, double bw)
-{
-    freq = clampf(freq, 0, rate / 2);
-    double omega = 2.0 * 3.14159265358979323846264338327950288 * freq / (double)rate;
-    double cs = cos(omega);
-    double alpha = sin(omega) * 2.0 * bw; // different alpha calculation than makeLPF above
-    double a0inv = 1.0 / (1.0 + alpha);
-    biquad->b0 = a0inv * (1.0 - cs) * 0.5;
-    biquad->b1 = 2.0 * biquad->b0;
-    biquad->b2 = biquad->b0;
-    biquad->a1 = a0inv * -2.0 * cs;
-    biquad->a2 = a0inv * (1.0 - alpha);
-    biquad->xn1 = 0;
-    biquad->xn2 = 0;
-    biquad->yn1 = 0;
-    biquad->yn2 = 0;
-}
-
 static inline void biquad_makeAPF(sf_rv_biquad_st *biquad, int rate, double freq, double bw)
 {
     freq = clampf(freq, 0, rate / 2);
@@ -220,15 +213,15 @@ static inline double biquad_step(sf_rv_biquad_st *biquad, double v)
 //
 // earlyref
 //
-static inline void earlyref_make(sf_rv_earlyref_st *earlyref, int rate, double factor, double width)
+static inline void earlyref_make(sf_rv_earlyref_st *earlyref, rv_arena *arena, int rate, double factor, double width)
 {
     static const double delaytblLc[18] = { 0.0043, 0.0215, 0.0225, 0.0268, 0.0270, 0.0298, 0.0458, 0.0485, 0.0572, 0.0587, 0.0595, 0.0612, 0.0707, 0.0708, 0.0726, 0.0741, 0.0753, 0.0797 };
     static const double delaytblRc[18] = { 0.0053, 0.0225, 0.0235, 0.0278, 0.0290, 0.0288, 0.0468, 0.0475, 0.0582, 0.0577, 0.0575, 0.0622, 0.0697, 0.0718, 0.0736, 0.0751, 0.0763, 0.0817 };
     earlyref->wet1 = width * 0.5 + 0.5;
     earlyref->wet2 = (1.0 - width) * 0.5;
     int lrdelay = 0.0002 * (double)rate;
-    delay_make(&earlyref->delayRL, lrdelay);
-    delay_make(&earlyref->delayLR, lrdelay);
+    delay_make(&earlyref->delayRL, arena, lrdelay);
+    delay_make(&earlyref->delayLR, arena, lrdelay);
     biquad_makeAPF(&earlyref->allpassXL, rate, 740.0, 4.0);
     earlyref->allpassXR = earlyref->allpassXL;
     biquad_makeAPF(&earlyref->allpassL, rate, 150.0, 4.0);
@@ -239,8 +232,8 @@ static inline void earlyref_make(sf_rv_earlyref_st *earlyref, int rate, double f
         earlyref->delaytblL[i] = delaytblLc[i] * factor;
         earlyref->delaytblR[i] = delaytblRc[i] * factor;
     }
-    delay_make(&earlyref->delayPWL, earlyref->delaytblL[17] + 10);
-    delay_make(&earlyref->delayPWR, earlyref->delaytblR[17] + 10);
+    delay_make(&earlyref->delayPWL, arena, earlyref->delaytblL[17] + 10);
+    delay_make(&earlyref->delayPWR, arena, earlyref->delaytblR[17] + 10);
     iir1_makeLPF(&earlyref->lpfL, rate, 20000.0);
     earlyref->lpfR = earlyref->lpfL;
     iir1_makeHPF(&earlyref->hpfL, rate, 4.0);
@@ -276,34 +269,133 @@ static inline void earlyref_step(sf_rv_earlyref_st *earlyref, double inputL, dou
 //
 // oversample
 //
+// polyphase half-band FIR stages, x2 or x4 in cascade. every other tap of a half-band filter is zero
+// and the centre tap is 1/2, so each output only costs a symmetric dot product over one phase
+// the first stage passes 0.8 of the input band and rejects images and aliases by 70dB, the second
+// stage only has to clear the band the first one left empty
+#define SF_REVERB_HBT0      12
+#define SF_REVERB_HBT1      5
+// frames handled per pass of the block processor, bounds the scratch space below
+#define SF_REVERB_BLOCK     128
+
+static double besseli0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 40; k++)
+    {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+    }
+    return sum;
+}
+
+static void halfband_make(sf_rv_halfband_st *hb, int taps, double beta)
+{
+    // kaiser windowed sinc, normalised for unity gain at DC
+    double sum = 0.0;
+    hb->taps = taps;
+    for (int k = 0; k < taps; k++)
+    {
+        int j = 2 * k + 1;
+        double r = j / (2.0 * taps);
+        double w = besseli0(beta * sqrt(1.0 - r * r)) / besseli0(beta);
+        hb->coef[k] = 2.0 * sin(3.14159265358979323846264338327950288 * 0.5 * j) /
+                      (3.14159265358979323846264338327950288 * j) * w;
+        sum += hb->coef[k];
+    }
+    for (int k = 0; k < taps; k++)
+        hb->coef[k] *= 0.5 / sum;
+    memset(hb->up, 0, sizeof(hb->up));
+    memset(hb->down, 0, sizeof(hb->down));
+    memset(hb->downc, 0, sizeof(hb->downc));
+}
+
+static inline v2d halfband_dot(const sf_rv_halfband_st *hb, const v2d *w)
+{
+    // w holds the 2 * taps latest frames of one phase
+    const int taps = hb->taps;
+    v2d acc = { 0.0, 0.0 };
+    for (int k = 0; k < taps; k++)
+    {
+        v2d c = { hb->coef[k], hb->coef[k] };
+        acc += c * (w[taps + k] + w[taps - 1 - k]);
+    }
+    return acc;
+}
+
+// n frames in, 2n frames out. w is scratch for 2 * SF_REVERB_HBT + n frames
+static void halfband_up(sf_rv_halfband_st *hb, const v2d *x, v2d *y, int n, v2d *w)
+{
+    const int hl = 2 * hb->taps;
+    memcpy(w, hb->up, hl * sizeof(v2d));
+    memcpy(w + hl, x, n * sizeof(v2d));
+    for (int m = 0; m < n; m++)
+    {
+        y[2 * m] = halfband_dot(hb, w + m + 1);
+        y[2 * m + 1] = w[m + 1 + hb->taps];
+    }
+    memcpy(hb->up, w + n, hl * sizeof(v2d));
+}
+
+// 2n frames in, n frames out, may run in place. w is scratch for 3 * SF_REVERB_HBT + 2n frames
+static void halfband_down(sf_rv_halfband_st *hb, const v2d *x, v2d *y, int n, v2d *w)
+{
+    const int taps = hb->taps, hl = 2 * taps;
+    const v2d half = { 0.5, 0.5 };
+    v2d *we = w + hl + n;
+    memcpy(w, hb->down, hl * sizeof(v2d));
+    memcpy(we, hb->downc, taps * sizeof(v2d));
+    for (int m = 0; m < n; m++)
+    {
+        w[hl + m] = x[2 * m];
+        we[taps + m] = x[2 * m + 1];
+    }
+    for (int m = 0; m < n; m++)
+        y[m] = half * (we[m] + halfband_dot(hb, w + m + 1));
+    memcpy(hb->down, w + n, hl * sizeof(v2d));
+    memcpy(hb->downc, we + n, taps * sizeof(v2d));
+}
+
 static inline void oversample_make(sf_rv_oversample_st *oversample, int factor)
 {
-    oversample->factor = clampi(factor, 1, SF_REVERB_OF);
-    biquad_makeLPFQ(&oversample->lpfU, 2 * oversample->factor, 1.0, 0.5773502691896258); // 1/sqrt(3)
-    oversample->lpfD = oversample->lpfU;
+    oversample->factor = factor >= SF_REVERB_OF ? SF_REVERB_OF : (factor >= 2 ? 2 : 1);
+    oversample->stages = oversample->factor >> 1;
+    halfband_make(&oversample->hb[0], SF_REVERB_HBT0, 7.5);
+    halfband_make(&oversample->hb[1], SF_REVERB_HBT1, 7.0);
+    // up and down through one stage delays by 2 * taps - 1 frames at its input rate
+    oversample->latency = 0;
+    if (oversample->stages > 0)
+        oversample->latency += (2 * SF_REVERB_HBT0 - 1) * oversample->factor;
+    if (oversample->stages > 1)
+        oversample->latency += (2 * SF_REVERB_HBT1 - 1) * 2;
 }
 
-// output length must be oversample->factor
-static inline void oversample_stepup(sf_rv_oversample_st *oversample, double input, double *output)
+// n frames in, n * oversample->factor frames out, n at most SF_REVERB_BLOCK
+static void oversample_up(sf_rv_oversample_st *oversample, const v2d *x, v2d *y, int n)
 {
-    if (oversample->factor == 1)
+    v2d mid[2 * SF_REVERB_BLOCK], w[2 * SF_REVERB_HBT + 2 * SF_REVERB_BLOCK];
+    if (oversample->stages == 0)
+        memcpy(y, x, n * sizeof(v2d));
+    else if (oversample->stages == 1)
+        halfband_up(&oversample->hb[0], x, y, n, w);
+    else
     {
-        output[0] = input;
-        return;
+        halfband_up(&oversample->hb[0], x, mid, n, w);
+        halfband_up(&oversample->hb[1], mid, y, 2 * n, w);
     }
-    output[0] = biquad_step(&oversample->lpfU, input * oversample->factor);
-    for (int i = 1; i < oversample->factor; i++)
-        output[i] = biquad_step(&oversample->lpfU, 0);
 }
 
-// input length must be oversample->factor
-static inline double oversample_stepdown(sf_rv_oversample_st *oversample, double *input)
+// n * oversample->factor frames in, n frames out, in place
+static void oversample_down(sf_rv_oversample_st *oversample, v2d *x, int n)
 {
-    if (oversample->factor == 1)
-        return input[0];
-    for (int i = 0; i < oversample->factor; i++)
-        biquad_step(&oversample->lpfD, input[i]);
-    return input[0];
+    v2d w[3 * SF_REVERB_HBT + SF_REVERB_OF * SF_REVERB_BLOCK];
+    if (oversample->stages == 2)
+    {
+        halfband_down(&oversample->hb[1], x, x, 2 * n, w);
+        halfband_down(&oversample->hb[0], x, x, n, w);
+    }
+    else if (oversample->stages == 1)
+        halfband_down(&oversample->hb[0], x, x, n, w);
 }
 
 //
@@ -331,16 +423,53 @@ static inline double dccut_step(sf_rv_dccut_st *dccut, double v)
 //
 // noise
 //
-static inline void noise_make(sf_rv_noise_st *noise)
+// random numbers come from four xorshift32 generators in the lanes of one vector, seeded per instance,
+// so reverbs on different threads share no state and a block is drawn four at a time with shifts and
+// xors only, which every SIMD target has
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef int32_t v4i __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+
+static inline void noise_make(sf_rv_noise_st *noise, uint32_t seed)
 {
     noise->pos = SF_REVERB_NS;
+    // splitmix32 spreads the seed over the lanes, xorshift needs nonzero states
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t z = seed + (uint32_t)(i + 1) * 0x9E3779B9u;
+        z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+        z ^= z >> 16;
+        noise->state[i] = z ? z : 0x6D2B79F5u;
+    }
+}
+
+// fill out with n uniform doubles in [-1, 1), n a multiple of 4
+static void noise_draw(sf_rv_noise_st *noise, double *out, int n)
+{
+    v4u x;
+    memcpy(&x, noise->state, sizeof(x));
+    for (int i = 0; i < n; i += 4)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        // top 23 bits, as many as the float based generator this replaces
+        v4d d = __builtin_convertvector((v4i)(x >> 9), v4d) * (2.0 / 8388608.0) - 1.0;
+        v2dStore(out + i, (v2d){ d[0], d[1] });
+        v2dStore(out + i + 2, (v2d){ d[2], d[3] });
+    }
+    memcpy(noise->state, &x, sizeof(x));
 }
 
 static inline double noise_step(sf_rv_noise_st *noise)
 {
     if (noise->pos >= SF_REVERB_NS)
     {
-        // need to generate more noise
+        // need to generate more noise, one random displacement per midpoint
+        double rnd[SF_REVERB_NS];
+        const double *rp = rnd;
+        noise_draw(noise, rnd, SF_REVERB_NS);
         noise->pos = 0;
         int len = SF_REVERB_NS;
         int tot = 1;
@@ -349,15 +478,15 @@ static inline double noise_step(sf_rv_noise_st *noise)
         noise->buf[0] = 0;
         while (len > 1)
         {
-            double left = 0;
-            for (int i = tot - 1; i >= 0; i--)
+            // the last segment ends on 0
+            int i;
+            for (i = 0; i < tot - 1; i++)
             {
-                double right = left;
-                left = noise->buf[i * len];
-                double midpoint = (left + right) * 0.5;
-                double newv = midpoint + r * (2.0 * randdouble() - 1.0); // displace by random amt
+                double newv = (noise->buf[i * len] + noise->buf[(i + 1) * len]) * 0.5 + r * rp[i]; // displace midpoint by random amt
                 noise->buf[i * len + (len / 2)] = clampf(newv, -1.0, 1.0);
             }
+            noise->buf[i * len + (len / 2)] = clampf(noise->buf[i * len] * 0.5 + r * rp[i], -1.0, 1.0);
+            rp += tot;
             len /= 2;
             tot *= 2;
             r *= rmul;
@@ -401,13 +530,13 @@ static inline double lfo_step(sf_rv_lfo_st *lfo)
 //
 // allpass
 //
-static inline void allpass_make(sf_rv_allpass_st *allpass, int size, double feedback, double decay)
+static inline void allpass_make(sf_rv_allpass_st *allpass, rv_arena *arena, int size, double feedback, double decay)
 {
     allpass->pos = 0;
-    allpass->size = clampi(size, 1, SF_REVERB_APS);
+    allpass->size = size < 1 ? 1 : size;
     allpass->feedback = feedback;
     allpass->decay = decay;
-    memset(allpass->buf, 0, sizeof(double) * allpass->size);
+    allpass->buf = arena_take(arena, allpass->size);
 }
 
 static inline double allpass_step(sf_rv_allpass_st *allpass, double v)
@@ -415,26 +544,26 @@ static inline double allpass_step(sf_rv_allpass_st *allpass, double v)
     v += allpass->feedback * allpass->buf[allpass->pos];
     double out = allpass->decay * allpass->buf[allpass->pos] - allpass->feedback * v;
     allpass->buf[allpass->pos] = v;
-    allpass->pos = (allpass->pos + 1) % allpass->size;
+    allpass->pos = wrapinc(allpass->pos, allpass->size);
     return out;
 }
 
 //
 // allpass2
 //
-static inline void allpass2_make(sf_rv_allpass2_st *allpass2, int size1, int size2, double feedback1,
+static inline void allpass2_make(sf_rv_allpass2_st *allpass2, rv_arena *arena, int size1, int size2, double feedback1,
                                  double feedback2, double decay1, double decay2)
 {
     allpass2->pos1 = 0;
     allpass2->pos2 = 0;
-    allpass2->size1 = clampi(size1, 1, SF_REVERB_AP2S1);
-    allpass2->size2 = clampi(size2, 1, SF_REVERB_AP2S2);
+    allpass2->size1 = size1 < 1 ? 1 : size1;
+    allpass2->size2 = size2 < 1 ? 1 : size2;
     allpass2->feedback1 = feedback1;
     allpass2->feedback2 = feedback2;
     allpass2->decay1 = decay1;
     allpass2->decay2 = decay2;
-    memset(allpass2->buf1, 0, sizeof(double) * allpass2->size1);
-    memset(allpass2->buf2, 0, sizeof(double) * allpass2->size2);
+    allpass2->buf1 = arena_take(arena, allpass2->size1);
+    allpass2->buf2 = arena_take(arena, allpass2->size2);
 }
 
 static inline double allpass2_step(sf_rv_allpass2_st *allpass2, double v)
@@ -445,8 +574,8 @@ static inline double allpass2_step(sf_rv_allpass2_st *allpass2, double v)
     allpass2->buf2[allpass2->pos2] = allpass2->decay1 * allpass2->buf1[allpass2->pos1] -
                                      v * allpass2->feedback1;
     allpass2->buf1[allpass2->pos1] = v;
-    allpass2->pos1 = (allpass2->pos1 + 1) % allpass2->size1;
-    allpass2->pos2 = (allpass2->pos2 + 1) % allpass2->size2;
+    allpass2->pos1 = wrapinc(allpass2->pos1, allpass2->size1);
+    allpass2->pos2 = wrapinc(allpass2->pos2, allpass2->size2);
     return out;
 }
 
@@ -477,12 +606,12 @@ static inline double allpass2_get2(sf_rv_allpass2_st *allpass2, int offset)
 //
 // allpass3
 //
-static inline void allpass3_make(sf_rv_allpass3_st *allpass3, int size1, int msize1, int size2,
+static inline void allpass3_make(sf_rv_allpass3_st *allpass3, rv_arena *arena, int size1, int msize1, int size2,
                                  int size3, double feedback1, double feedback2, double feedback3, double decay1, double decay2,
                                  double decay3)
 {
-    size1 = clampi(size1, 1, SF_REVERB_AP3S1);
-    msize1 = clampi(msize1, 1, SF_REVERB_AP3M1);
+    size1 = size1 < 1 ? 1 : size1;
+    msize1 = msize1 < 1 ? 1 : msize1;
     if (msize1 > size1)
         msize1 = size1;
     int newsize = size1 + msize1;
@@ -492,17 +621,17 @@ static inline void allpass3_make(sf_rv_allpass3_st *allpass3, int size1, int msi
     allpass3->pos3 = 0;
     allpass3->size1 = newsize;
     allpass3->msize1 = msize1;
-    allpass3->size2 = clampi(size2, 1, SF_REVERB_AP3S2);
-    allpass3->size3 = clampi(size3, 1, SF_REVERB_AP3S3);
+    allpass3->size2 = size2 < 1 ? 1 : size2;
+    allpass3->size3 = size3 < 1 ? 1 : size3;
     allpass3->feedback1 = feedback1;
     allpass3->feedback2 = feedback2;
     allpass3->feedback3 = feedback3;
     allpass3->decay1 = decay1;
     allpass3->decay2 = decay2;
     allpass3->decay3 = decay3;
-    memset(allpass3->buf1, 0, sizeof(double) * allpass3->size1);
-    memset(allpass3->buf2, 0, sizeof(double) * allpass3->size2);
-    memset(allpass3->buf3, 0, sizeof(double) * allpass3->size3);
+    allpass3->buf1 = arena_take(arena, allpass3->size1);
+    allpass3->buf2 = arena_take(arena, allpass3->size2);
+    allpass3->buf3 = arena_take(arena, allpass3->size3);
 }
 
 static inline double allpass3_step(sf_rv_allpass3_st *allpass3, double v, double mod)
@@ -525,10 +654,10 @@ static inline double allpass3_step(sf_rv_allpass3_st *allpass3, double v, double
     v += allpass3->feedback1 * tmp;
     allpass3->buf2[allpass3->pos2] = allpass3->decay1 * tmp - allpass3->feedback1 * v;
     allpass3->buf1[allpass3->wpos1] = v;
-    allpass3->wpos1 = (allpass3->wpos1 + 1) % allpass3->size1;
-    allpass3->rpos1 = (allpass3->rpos1 + 1) % allpass3->size1;
-    allpass3->pos2 = (allpass3->pos2 + 1) % allpass3->size2;
-    allpass3->pos3 = (allpass3->pos3 + 1) % allpass3->size3;
+    allpass3->wpos1 = wrapinc(allpass3->wpos1, allpass3->size1);
+    allpass3->rpos1 = wrapinc(allpass3->rpos1, allpass3->size1);
+    allpass3->pos2 = wrapinc(allpass3->pos2, allpass3->size2);
+    allpass3->pos3 = wrapinc(allpass3->pos3, allpass3->size3);
     return out;
 }
 
@@ -571,11 +700,11 @@ static inline double allpass3_get3(sf_rv_allpass3_st *allpass3, int offset)
 //
 // allpassm
 //
-static inline void allpassm_make(sf_rv_allpassm_st *allpassm, int size, int msize, double feedback,
+static inline void allpassm_make(sf_rv_allpassm_st *allpassm, rv_arena *arena, int size, int msize, double feedback,
                                  double decay)
 {
-    size = clampi(size, 1, SF_REVERB_APMS);
-    msize = clampi(msize, 1, SF_REVERB_APMM);
+    size = size < 1 ? 1 : size;
+    msize = msize < 1 ? 1 : msize;
     if (msize > size)
         msize = size;
     int newsize = size + msize;
@@ -586,7 +715,7 @@ static inline void allpassm_make(sf_rv_allpassm_st *allpassm, int size, int msiz
     allpassm->feedback = feedback;
     allpassm->decay = decay;
     allpassm->z1 = 0;
-    memset(allpassm->buf, 0, sizeof(double) * allpassm->size);
+    allpassm->buf = arena_take(arena, allpassm->size);
 }
 
 static inline double allpassm_step(sf_rv_allpassm_st *allpassm, double v, double mod, double fbmod)
@@ -602,28 +731,248 @@ static inline double allpassm_step(sf_rv_allpassm_st *allpassm, double v, double
     if (rpos2 < 0)
         rpos2 += allpassm->size;
     allpassm->z1 = allpassm->buf[rpos2] + mfrac * (allpassm->buf[rpos1] - allpassm->z1);
-    allpassm->rpos = (allpassm->rpos + 1) % allpassm->size;
+    allpassm->rpos = wrapinc(allpassm->rpos, allpassm->size);
     allpassm->buf[allpassm->wpos] = v + allpassm->z1 * mfeedback;
     v = allpassm->decay * allpassm->z1 - allpassm->buf[allpassm->wpos] * mfeedback;
-    allpassm->wpos = (allpassm->wpos + 1) % allpassm->size;
+    allpassm->wpos = wrapinc(allpassm->wpos, allpassm->size);
     return v;
 }
 
 //
 // comb
 //
-static inline void comb_make(sf_rv_comb_st *comb, int size)
+static inline void comb_make(sf_rv_comb_st *comb, rv_arena *arena, int size)
 {
     comb->pos = 0;
-    comb->size = clampi(size, 1, SF_REVERB_CS);
-    memset(comb->buf, 0, sizeof(double) * comb->size);
+    comb->size = size < 1 ? 1 : size;
+    comb->buf = arena_take(arena, comb->size);
 }
 
 static inline double comb_step(sf_rv_comb_st *comb, double v, double feedback)
 {
     v = comb->buf[comb->pos] * feedback + v;
     comb->buf[comb->pos] = v;
-    comb->pos = (comb->pos + 1) % comb->size;
+    comb->pos = wrapinc(comb->pos, comb->size);
+    return v;
+}
+
+//
+// stereo pairs
+//
+
+// the left and right networks are built from the same components with different sizes, so the
+// block processor below runs them side by side: buffer positions stay per channel, the arithmetic
+// goes through one 2 lane vector in the same order as the scalar steps, giving identical results
+static inline v2d pair(double l, double r)
+{
+    v2d v = { l, r };
+    return v;
+}
+
+static inline v2d swaplr(v2d v)
+{
+    v2d s = { v[1], v[0] };
+    return s;
+}
+
+// filter coefficients and states of both channels, held in registers for a whole block
+typedef struct
+{
+    v2d a2, b1, b2, y1;
+} rv_iir1_lr;
+
+typedef struct
+{
+    v2d b0, b1, b2, a1, a2, xn1, xn2, yn1, yn2;
+} rv_biquad_lr;
+
+typedef struct
+{
+    v2d gain, y1, y2;
+} rv_dccut_lr;
+
+static inline void iir1_load_lr(rv_iir1_lr *lr, const sf_rv_iir1_st *l, const sf_rv_iir1_st *r)
+{
+    lr->a2 = pair(l->a2, r->a2);
+    lr->b1 = pair(l->b1, r->b1);
+    lr->b2 = pair(l->b2, r->b2);
+    lr->y1 = pair(l->y1, r->y1);
+}
+
+static inline void iir1_save_lr(const rv_iir1_lr *lr, sf_rv_iir1_st *l, sf_rv_iir1_st *r)
+{
+    l->y1 = lr->y1[0];
+    r->y1 = lr->y1[1];
+}
+
+static inline v2d iir1_step_lr(rv_iir1_lr *lr, v2d v)
+{
+    v2d out = v * lr->b1 + lr->y1;
+    lr->y1 = out * lr->a2 + v * lr->b2;
+    return out;
+}
+
+static inline void biquad_load_lr(rv_biquad_lr *lr, const sf_rv_biquad_st *l, const sf_rv_biquad_st *r)
+{
+    lr->b0 = pair(l->b0, r->b0);
+    lr->b1 = pair(l->b1, r->b1);
+    lr->b2 = pair(l->b2, r->b2);
+    lr->a1 = pair(l->a1, r->a1);
+    lr->a2 = pair(l->a2, r->a2);
+    lr->xn1 = pair(l->xn1, r->xn1);
+    lr->xn2 = pair(l->xn2, r->xn2);
+    lr->yn1 = pair(l->yn1, r->yn1);
+    lr->yn2 = pair(l->yn2, r->yn2);
+}
+
+static inline void biquad_save_lr(const rv_biquad_lr *lr, sf_rv_biquad_st *l, sf_rv_biquad_st *r)
+{
+    l->xn1 = lr->xn1[0];
+    r->xn1 = lr->xn1[1];
+    l->xn2 = lr->xn2[0];
+    r->xn2 = lr->xn2[1];
+    l->yn1 = lr->yn1[0];
+    r->yn1 = lr->yn1[1];
+    l->yn2 = lr->yn2[0];
+    r->yn2 = lr->yn2[1];
+}
+
+static inline v2d biquad_step_lr(rv_biquad_lr *lr, v2d v)
+{
+    v2d out = v * lr->b0 + lr->xn1 * lr->b1 + lr->xn2 * lr->b2 - lr->yn1 * lr->a1 - lr->yn2 * lr->a2;
+    lr->xn2 = lr->xn1;
+    lr->xn1 = v;
+    lr->yn2 = lr->yn1;
+    lr->yn1 = out;
+    return out;
+}
+
+static inline v2d dccut_step_lr(rv_dccut_lr *lr, v2d v)
+{
+    v2d out = v - lr->y1 + lr->gain * lr->y2;
+    lr->y1 = v;
+    lr->y2 = out;
+    return out;
+}
+
+static inline v2d delay_step_lr(sf_rv_delay_st *l, sf_rv_delay_st *r, v2d v)
+{
+    v2d out = { l->buf[l->pos], r->buf[r->pos] };
+    l->buf[l->pos] = v[0];
+    r->buf[r->pos] = v[1];
+    l->pos = wrapinc(l->pos, l->size);
+    r->pos = wrapinc(r->pos, r->size);
+    return out;
+}
+
+static inline v2d allpass_step_lr(sf_rv_allpass_st *l, sf_rv_allpass_st *r, v2d v)
+{
+    v2d buf = { l->buf[l->pos], r->buf[r->pos] }, feedback = { l->feedback, r->feedback };
+    v += feedback * buf;
+    v2d out = pair(l->decay, r->decay) * buf - feedback * v;
+    l->buf[l->pos] = v[0];
+    r->buf[r->pos] = v[1];
+    l->pos = wrapinc(l->pos, l->size);
+    r->pos = wrapinc(r->pos, r->size);
+    return out;
+}
+
+static inline v2d allpass2_step_lr(sf_rv_allpass2_st *l, sf_rv_allpass2_st *r, v2d v)
+{
+    v2d buf1 = { l->buf1[l->pos1], r->buf1[r->pos1] }, buf2 = { l->buf2[l->pos2], r->buf2[r->pos2] };
+    v2d feedback1 = { l->feedback1, r->feedback1 }, feedback2 = { l->feedback2, r->feedback2 };
+    v += feedback2 * buf2;
+    v2d out = pair(l->decay2, r->decay2) * buf2 - v * feedback2;
+    v += feedback1 * buf1;
+    buf2 = pair(l->decay1, r->decay1) * buf1 - v * feedback1;
+    l->buf2[l->pos2] = buf2[0];
+    r->buf2[r->pos2] = buf2[1];
+    l->buf1[l->pos1] = v[0];
+    r->buf1[r->pos1] = v[1];
+    l->pos1 = wrapinc(l->pos1, l->size1);
+    r->pos1 = wrapinc(r->pos1, r->size1);
+    l->pos2 = wrapinc(l->pos2, l->size2);
+    r->pos2 = wrapinc(r->pos2, r->size2);
+    return out;
+}
+
+// read positions of a modulated line, mod is already scaled to samples
+static inline void modtaps(int rpos, int size, double floormod, int *rpos1, int *rpos2)
+{
+    int p1 = rpos - (int)floormod;
+    if (p1 < 0)
+        p1 += size;
+    int p2 = p1 - 1;
+    if (p2 < 0)
+        p2 += size;
+    *rpos1 = p1;
+    *rpos2 = p2;
+}
+
+static inline v2d allpass3_step_lr(sf_rv_allpass3_st *l, sf_rv_allpass3_st *r, v2d v, v2d mod)
+{
+    int l1, l2, r1, r2;
+    mod = (mod + 1.0) * pair((double)l->msize1, (double)r->msize1);
+    v2d floormod = { floorf(mod[0]), floorf(mod[1]) };
+    v2d mfrac = mod - floormod;
+    modtaps(l->rpos1, l->size1, floormod[0], &l1, &l2);
+    modtaps(r->rpos1, r->size1, floormod[1], &r1, &r2);
+    v2d buf2 = { l->buf2[l->pos2], r->buf2[r->pos2] }, buf3 = { l->buf3[l->pos3], r->buf3[r->pos3] };
+    v2d feedback1 = { l->feedback1, r->feedback1 }, feedback2 = { l->feedback2, r->feedback2 }, feedback3 = { l->feedback3, r->feedback3 };
+    v += feedback3 * buf3;
+    v2d out = pair(l->decay3, r->decay3) * buf3 - feedback3 * v;
+    v += feedback2 * buf2;
+    buf3 = pair(l->decay2, r->decay2) * buf2 - feedback2 * v;
+    l->buf3[l->pos3] = buf3[0];
+    r->buf3[r->pos3] = buf3[1];
+    v2d tmp = pair(l->buf1[l2], r->buf1[r2]) * mfrac + pair(l->buf1[l1], r->buf1[r1]) * (1.0 - mfrac);
+    v += feedback1 * tmp;
+    buf2 = pair(l->decay1, r->decay1) * tmp - feedback1 * v;
+    l->buf2[l->pos2] = buf2[0];
+    r->buf2[r->pos2] = buf2[1];
+    l->buf1[l->wpos1] = v[0];
+    r->buf1[r->wpos1] = v[1];
+    l->wpos1 = wrapinc(l->wpos1, l->size1);
+    r->wpos1 = wrapinc(r->wpos1, r->size1);
+    l->rpos1 = wrapinc(l->rpos1, l->size1);
+    r->rpos1 = wrapinc(r->rpos1, r->size1);
+    l->pos2 = wrapinc(l->pos2, l->size2);
+    r->pos2 = wrapinc(r->pos2, r->size2);
+    l->pos3 = wrapinc(l->pos3, l->size3);
+    r->pos3 = wrapinc(r->pos3, r->size3);
+    return out;
+}
+
+static inline v2d allpassm_step_lr(sf_rv_allpassm_st *l, sf_rv_allpassm_st *r, v2d v, v2d mod, v2d fbmod)
+{
+    int l1, l2, r1, r2;
+    v2d mfeedback = pair(l->feedback, r->feedback) + fbmod;
+    mod = (mod + 1.0) * pair((double)l->msize, (double)r->msize);
+    v2d floormod = { floorf(mod[0]), floorf(mod[1]) };
+    v2d mfrac = 1.0 - mod + floormod;
+    modtaps(l->rpos, l->size, floormod[0], &l1, &l2);
+    modtaps(r->rpos, r->size, floormod[1], &r1, &r2);
+    v2d z1 = pair(l->buf[l2], r->buf[r2]) + mfrac * (pair(l->buf[l1], r->buf[r1]) - pair(l->z1, r->z1));
+    l->z1 = z1[0];
+    r->z1 = z1[1];
+    l->rpos = wrapinc(l->rpos, l->size);
+    r->rpos = wrapinc(r->rpos, r->size);
+    v2d w = v + z1 * mfeedback;
+    l->buf[l->wpos] = w[0];
+    r->buf[r->wpos] = w[1];
+    v = pair(l->decay, r->decay) * z1 - w * mfeedback;
+    l->wpos = wrapinc(l->wpos, l->size);
+    r->wpos = wrapinc(r->wpos, r->size);
+    return v;
+}
+
+static inline v2d comb_step_lr(sf_rv_comb_st *l, sf_rv_comb_st *r, v2d v, v2d feedback)
+{
+    v = pair(l->buf[l->pos], r->buf[r->pos]) * feedback + v;
+    l->buf[l->pos] = v[0];
+    r->buf[r->pos] = v[1];
+    l->pos = wrapinc(l->pos, l->size);
+    r->pos = wrapinc(r->pos, r->size);
     return v;
 }
 
@@ -635,41 +984,42 @@ static inline double comb_step(sf_rv_comb_st *comb, double v, double feedback)
 
 // now that all the components are done (thank god), we can start on the actual reverb effect
 
-void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset)
+// sorry for the bad formatting, I've tried to cram this in as best as I could
+static const struct
+{
+    int osf;
+    double p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16;
+} presets[] =
 {
-    // sorry for the bad formatting, I've tried to cram this in as best as I could
-    struct
-    {
-        int osf;
-        double p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16;
-    } ps[] =
-    {
 
-        //OSF ERtoLt ERWet Dry ERFac ERWdth Wdth Wet Wander BassB Spin InpLP BasLP DmpLP OutLP RT60  Delay
-        { 1, 0.4, -9.0,-7, 1.6, 0.7, 1.0, -0, 0.25, 0.15, 0.7,17000, 500, 7000,10000, 3.2,0.02 },
-        { 1, 0.3, -9.0, -7, 1.0, 0.7, 1.0, -8, 0.3, 0.25, 0.7,18000, 600, 9000,17000, 2.1,0.01 },
-        { 1, 0.3, -9.0, -7, 1.0, 0.7, 1.0, -8, 0.25, 0.2, 0.5,18000, 600, 7000, 9000, 2.3,0.01 },
-        { 1, 0.3, -9.0, -7, 1.2, 0.7, 1.0, -8, 0.25, 0.2, 0.7,18000, 500, 8000,16000, 2.8,0.01 },
-        { 1, 0.3, -9.0, -7, 1.2, 0.7, 1.0, -8, 0.2, 0.15, 0.5,18000, 500, 6000, 8000, 2.9,0.01 },
-        { 1, 0.2, -9.0, -7, 1.4, 0.7, 1.0, -8, 0.15, 0.2, 1.0,18000, 400, 9000,14000, 3.8,0.018 },
-        { 1, 0.2, -9.0, -7, 1.5, 0.7, 1.0, -8, 0.2, 0.2, 0.5,18000, 400, 5000, 7000, 4.2,0.018 },
-        { 1, 0.7, -8.0, -7, 0.7,-0.4, 0.8, -8, 0.2, 0.3, 1.6,18000,1000,18000,18000, 0.5,0.005 },
-        { 1, 0.7, -8.0, -7, 0.8, 0.6, 0.9, -8, 0.3, 0.3, 0.4,18000, 300,10000,18000, 0.5,0.005 },
-        { 1, 0.5, -8.0, -7, 1.2,-0.4, 0.8, -8, 0.2, 0.1, 1.6,18000,1000,18000,18000, 0.8,0.008 },
-        { 1, 0.5, -8.0, -7, 1.2, 0.6, 0.9, -8, 0.3, 0.1, 0.4,18000, 300,10000,18000, 1.2,0.016 },
-        { 1, 0.2, -8.0, -7, 2.2,-0.4, 0.9, -8, 0.2, 0.1, 1.6,18000,1000,16000,18000, 1.8,0.01 },
-        { 1, 0.2, -8.0, -7, 2.2, 0.6, 0.9, -8, 0.3, 0.1, 0.4,18000, 500, 9000,18000, 1.9,0.02 },
-        { 1, 0.5, -7.0, -6, 1.2,-0.4, 0.8,-70, 0.2, 0.1, 1.6,18000,1000,18000,18000, 0.8,0.008 },
-        { 1, 0.5, -7.0, -6, 1.2, 0.6, 0.9,-70, 0.3, 0.1, 0.4,18000, 300,10000,18000, 1.2,0.016 },
-        { 2, 0.0,-30.0,-12, 1.0, 1.0, 1.0, -8, 0.2, 0.1, 1.6,18000,1000,16000,18000, 1.8,0.0 },
-        { 2, 0.0,-30.0,-12, 1.0, 1.0, 1.0, -8, 0.3, 0.2, 0.4,18000, 500, 9000,18000, 1.9,0.0 },
-        { 2, 0.1,-16.0,-14, 1.0, 0.1, 1.0, -5, 0.35, 0.05, 1.0,18000, 100,10000,18000,12.0,0.0 },
-        { 2, 0.1,-16.0,-14, 1.0, 0.1, 1.0, -5, 0.4, 0.05, 1.0,18000, 100, 9000,18000,30.0,0.0 }
-    };
+    //OSF ERtoLt ERWet Dry ERFac ERWdth Wdth Wet Wander BassB Spin InpLP BasLP DmpLP OutLP RT60  Delay
+    { 1, 0.4, -9.0,-7, 1.6, 0.7, 1.0, -0, 0.25, 0.15, 0.7,17000, 500, 7000,10000, 3.2,0.02 },
+    { 1, 0.3, -9.0, -7, 1.0, 0.7, 1.0, -8, 0.3, 0.25, 0.7,18000, 600, 9000,17000, 2.1,0.01 },
+    { 1, 0.3, -9.0, -7, 1.0, 0.7, 1.0, -8, 0.25, 0.2, 0.5,18000, 600, 7000, 9000, 2.3,0.01 },
+    { 1, 0.3, -9.0, -7, 1.2, 0.7, 1.0, -8, 0.25, 0.2, 0.7,18000, 500, 8000,16000, 2.8,0.01 },
+    { 1, 0.3, -9.0, -7, 1.2, 0.7, 1.0, -8, 0.2, 0.15, 0.5,18000, 500, 6000, 8000, 2.9,0.01 },
+    { 1, 0.2, -9.0, -7, 1.4, 0.7, 1.0, -8, 0.15, 0.2, 1.0,18000, 400, 9000,14000, 3.8,0.018 },
+    { 1, 0.2, -9.0, -7, 1.5, 0.7, 1.0, -8, 0.2, 0.2, 0.5,18000, 400, 5000, 7000, 4.2,0.018 },
+    { 1, 0.7, -8.0, -7, 0.7,-0.4, 0.8, -8, 0.2, 0.3, 1.6,18000,1000,18000,18000, 0.5,0.005 },
+    { 1, 0.7, -8.0, -7, 0.8, 0.6, 0.9, -8, 0.3, 0.3, 0.4,18000, 300,10000,18000, 0.5,0.005 },
+    { 1, 0.5, -8.0, -7, 1.2,-0.4, 0.8, -8, 0.2, 0.1, 1.6,18000,1000,18000,18000, 0.8,0.008 },
+    { 1, 0.5, -8.0, -7, 1.2, 0.6, 0.9, -8, 0.3, 0.1, 0.4,18000, 300,10000,18000, 1.2,0.016 },
+    { 1, 0.2, -8.0, -7, 2.2,-0.4, 0.9, -8, 0.2, 0.1, 1.6,18000,1000,16000,18000, 1.8,0.01 },
+    { 1, 0.2, -8.0, -7, 2.2, 0.6, 0.9, -8, 0.3, 0.1, 0.4,18000, 500, 9000,18000, 1.9,0.02 },
+    { 1, 0.5, -7.0, -6, 1.2,-0.4, 0.8,-70, 0.2, 0.1, 1.6,18000,1000,18000,18000, 0.8,0.008 },
+    { 1, 0.5, -7.0, -6, 1.2, 0.6, 0.9,-70, 0.3, 0.1, 0.4,18000, 300,10000,18000, 1.2,0.016 },
+    { 2, 0.0,-30.0,-12, 1.0, 1.0, 1.0, -8, 0.2, 0.1, 1.6,18000,1000,16000,18000, 1.8,0.0 },
+    { 2, 0.0,-30.0,-12, 1.0, 1.0, 1.0, -8, 0.3, 0.2, 0.4,18000, 500, 9000,18000, 1.9,0.0 },
+    { 2, 0.1,-16.0,-14, 1.0, 0.1, 1.0, -5, 0.35, 0.05, 1.0,18000, 100,10000,18000,12.0,0.0 },
+    { 2, 0.1,-16.0,-14, 1.0, 0.1, 1.0, -5, 0.4, 0.05, 1.0,18000, 100, 9000,18000,30.0,0.0 }
+};
+
+int sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset)
+{
 #define CASE(prs, i)                                                                        \
-		case prs: sf_advancereverb(rv, rate, ps[i].osf, ps[i].p1, ps[i].p2, ps[i].p3, ps[i].p4, \
-			ps[i].p5, ps[i].p6, ps[i].p7, ps[i].p8, ps[i].p9, ps[i].p10, ps[i].p11, ps[i].p12,  \
-			ps[i].p13, ps[i].p14, ps[i].p15, ps[i].p16); return;
+		case prs: return sf_advancereverb(rv, rate, presets[i].osf, presets[i].p1, presets[i].p2, presets[i].p3, presets[i].p4, \
+			presets[i].p5, presets[i].p6, presets[i].p7, presets[i].p8, presets[i].p9, presets[i].p10, presets[i].p11, presets[i].p12,  \
+			presets[i].p13, presets[i].p14, presets[i].p15, presets[i].p16);
     switch (preset)
     {
         CASE(SF_REVERB_PRESET_DEFAULT, 0)
@@ -693,12 +1043,13 @@ void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset)
         CASE(SF_REVERB_PRESET_LONGREVERB2, 18)
     }
 #undef CASE
+    return 0;
 }
 
-void sf_advancereverb(sf_reverb_state_st *rv, int rate,
-                      int oversamplefactor, double ertolate, double erefwet, double dry, double ereffactor,
-                      double erefwidth, double width, double wet, double wander, double bassb, double spin, double inputlpf,
-                      double basslpf, double damplpf, double outputlpf, double rt60, double delay)
+static void reverb_make(sf_reverb_state_st *rv, rv_arena *arena, int rate,
+                        int oversamplefactor, double ertolate, double erefwet, double dry, double ereffactor,
+                        double erefwidth, double width, double wet, double wander, double bassb, double spin, double inputlpf,
+                        double basslpf, double damplpf, double outputlpf, double rt60, double delay)
 {
     rv->ertolate = ertolate;
     rv->erefwet = db2lin(erefwet);
@@ -708,13 +1059,12 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
     rv->wet2 = wet * ((1.0 - width) * 0.5);
     rv->wander = wander;
     rv->bassb = bassb;
-    earlyref_make(&rv->earlyref, rate, ereffactor, erefwidth);
-    oversample_make(&rv->oversampleL, oversamplefactor);
-    rv->oversampleR = rv->oversampleL;
-    int osrate = rate * rv->oversampleL.factor;
+    earlyref_make(&rv->earlyref, arena, rate, ereffactor, erefwidth);
+    oversample_make(&rv->oversample, oversamplefactor);
+    int osrate = rate * rv->oversample.factor;
     dccut_make(&rv->dccutL, osrate, 5.0);
     rv->dccutR = rv->dccutL;
-    noise_make(&rv->noise);
+    noise_make(&rv->noise, 123); // doesn't matter
     lfo_make(&rv->lfo1, osrate, spin);
     iir1_makeLPF(&rv->lfo1_lpf, osrate, 20.0);
     lfo_make(&rv->lfo2, osrate, sqrt(100.0 - (10.0 - spin) * (10.0 - spin)) * 0.5);
@@ -725,26 +1075,26 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
     int msize = nextprime(10 * osrate / 34125);
     for (int i = 0; i < 10; i++)
     {
-        allpassm_make(&rv->diffL[i], nextprime(diffLc[i] * totfactor), msize, -0.78, 1);
-        allpassm_make(&rv->diffR[i], nextprime(diffRc[i] * totfactor), msize, -0.78, 1);
+        allpassm_make(&rv->diffL[i], arena, nextprime(diffLc[i] * totfactor), msize, -0.78, 1);
+        allpassm_make(&rv->diffR[i], arena, nextprime(diffRc[i] * totfactor), msize, -0.78, 1);
     }
     static const int crossLc[4] = { 430, 341, 264, 174 };
     static const int crossRc[4] = { 447, 324, 247, 191 };
     for (int i = 0; i < 4; i++)
     {
-        allpass_make(&rv->crossL[i], nextprime(crossLc[i] * totfactor), 0.78, 1);
-        allpass_make(&rv->crossR[i], nextprime(crossRc[i] * totfactor), 0.78, 1);
+        allpass_make(&rv->crossL[i], arena, nextprime(crossLc[i] * totfactor), 0.78, 1);
+        allpass_make(&rv->crossR[i], arena, nextprime(crossRc[i] * totfactor), 0.78, 1);
     }
     iir1_makeLPF(&rv->clpfL, osrate, inputlpf);
     rv->clpfR = rv->clpfL;
-    delay_make(&rv->cdelayL, nextprime(1572 * totfactor));
-    delay_make(&rv->cdelayR, nextprime(16 * totfactor));
-    delay_make(&rv->dampdL, nextprime(2 * totfactor));
-    delay_make(&rv->dampdR, nextprime(totfactor));
-    delay_make(&rv->cbassd1L, nextprime(1055 * totfactor));
-    delay_make(&rv->cbassd1R, nextprime(1460 * totfactor));
-    delay_make(&rv->cbassd2L, nextprime(344 * totfactor));
-    delay_make(&rv->cbassd2R, nextprime(500 * totfactor));
+    delay_make(&rv->cdelayL, arena, nextprime(1572 * totfactor));
+    delay_make(&rv->cdelayR, arena, nextprime(16 * totfactor));
+    delay_make(&rv->dampdL, arena, nextprime(2 * totfactor));
+    delay_make(&rv->dampdR, arena, nextprime(totfactor));
+    delay_make(&rv->cbassd1L, arena, nextprime(1055 * totfactor));
+    delay_make(&rv->cbassd1R, arena, nextprime(1460 * totfactor));
+    delay_make(&rv->cbassd2L, arena, nextprime(344 * totfactor));
+    delay_make(&rv->cbassd2R, arena, nextprime(500 * totfactor));
     biquad_makeAPF(&rv->bassapL, osrate, 150.0, 4.0);
     rv->bassapR = rv->bassapL;
     biquad_makeLPF(&rv->basslpL, osrate, basslpf, 2.0);
@@ -757,21 +1107,21 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
     double decay3 = pow(10.0, log10(0.906) / rt60);
     rv->loopdecay = decay0;
     msize = nextprime(32 * totfactor);
-    allpassm_make(&rv->dampap1L, nextprime(239 * totfactor), msize, 0.375, decay2);
-    allpassm_make(&rv->dampap1R, nextprime(205 * totfactor), msize, 0.375, decay2);
-    allpassm_make(&rv->dampap2L, nextprime(392 * totfactor), msize, 0.312, decay3);
-    allpassm_make(&rv->dampap2R, nextprime(329 * totfactor), msize, 0.312, decay3);
-    allpass2_make(&rv->cbassap1L, nextprime(1944 * totfactor), nextprime(612 * totfactor),
+    allpassm_make(&rv->dampap1L, arena, nextprime(239 * totfactor), msize, 0.375, decay2);
+    allpassm_make(&rv->dampap1R, arena, nextprime(205 * totfactor), msize, 0.375, decay2);
+    allpassm_make(&rv->dampap2L, arena, nextprime(392 * totfactor), msize, 0.312, decay3);
+    allpassm_make(&rv->dampap2R, arena, nextprime(329 * totfactor), msize, 0.312, decay3);
+    allpass2_make(&rv->cbassap1L, arena, nextprime(1944 * totfactor), nextprime(612 * totfactor),
                   0.250, 0.406, decay1, decay2);
-    allpass2_make(&rv->cbassap1R, nextprime(2032 * totfactor), nextprime(368 * totfactor),
+    allpass2_make(&rv->cbassap1R, arena, nextprime(2032 * totfactor), nextprime(368 * totfactor),
                   0.250, 0.406, decay1, decay2);
-    allpass3_make(&rv->cbassap2L,
+    allpass3_make(&rv->cbassap2L, arena,
                   nextprime(1212 * totfactor),
                   nextprime(121 * totfactor),
                   nextprime(816 * totfactor),
                   nextprime(1264 * totfactor),
                   0.250, 0.250, 0.406, decay1, decay1, decay2);
-    allpass3_make(&rv->cbassap2R,
+    allpass3_make(&rv->cbassap2R, arena,
                   nextprime(1452 * totfactor),
                   nextprime(5 * totfactor),
                   nextprime(688 * totfactor),
@@ -784,48 +1134,87 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
     };
     for (int i = 0; i < 32; i++)
         rv->outco[i] = outco[i] * totfactor;
-    comb_make(&rv->combL, nextprime(22 * osrate / 1000));
-    rv->combR = rv->combL;
+    comb_make(&rv->combL, arena, nextprime(22 * osrate / 1000));
+    comb_make(&rv->combR, arena, rv->combL.size);
     biquad_makeLPF(&rv->lastlpfL, osrate, outputlpf, 1.0);
     rv->lastlpfR = rv->lastlpfL;
+    // the dry tap runs at the input rate, around the resampling filters, whose latency the wet
+    // delay absorbs where it can
     int delaysamp = osrate * delay;
     if (delaysamp >= 0)
     {
-        delay_make(&rv->inpdelayL, 0);
-        delay_make(&rv->inpdelayR, 0);
-        delay_make(&rv->lastdelayL, delaysamp);
-        delay_make(&rv->lastdelayR, delaysamp);
+        delay_make(&rv->inpdelayL, arena, 0);
+        delay_make(&rv->inpdelayR, arena, 0);
+        delay_make(&rv->lastdelayL, arena, delaysamp - rv->oversample.latency);
+        delay_make(&rv->lastdelayR, arena, delaysamp - rv->oversample.latency);
     }
     else
     {
-        delay_make(&rv->inpdelayL, -delaysamp);
-        delay_make(&rv->inpdelayR, -delaysamp);
-        delay_make(&rv->lastdelayL, 0);
-        delay_make(&rv->lastdelayR, 0);
+        delaysamp = (rv->oversample.latency - delaysamp) / rv->oversample.factor;
+        delay_make(&rv->inpdelayL, arena, delaysamp);
+        delay_make(&rv->inpdelayR, arena, delaysamp);
+        delay_make(&rv->lastdelayL, arena, 0);
+        delay_make(&rv->lastdelayR, arena, 0);
+    }
+}
+int sf_advancereverb(sf_reverb_state_st *rv, int rate,
+                     int oversamplefactor, double ertolate, double erefwet, double dry, double ereffactor,
+                     double erefwidth, double width, double wet, double wander, double bassb, double spin, double inputlpf,
+                     double basslpf, double damplpf, double outputlpf, double rt60, double delay)
+{
+    rv_arena arena = { NULL, 0 };
+    reverb_make(rv, &arena, rate, oversamplefactor, ertolate, erefwet, dry, ereffactor, erefwidth, width, wet,
+                wander, bassb, spin, inputlpf, basslpf, damplpf, outputlpf, rt60, delay);
+    if (arena.used > rv->memsize)
+    {
+        sf_reverb_free(rv);
+        rv->mem = (double*)malloc(arena.used * sizeof(double));
+        if (!rv->mem)
+            return 0;
+        rv->memsize = arena.used;
     }
+    arena.base = rv->mem;
+    arena.used = 0;
+    reverb_make(rv, &arena, rate, oversamplefactor, ertolate, erefwet, dry, ereffactor, erefwidth, width, wet,
+                wander, bassb, spin, inputlpf, basslpf, damplpf, outputlpf, rt60, delay);
+    return 1;
+}
+
+void sf_reverb_free(sf_reverb_state_st *rv)
+{
+    free(rv->mem);
+    rv->mem = NULL;
+    rv->memsize = 0;
 }
+
 void sf_reverb_process(sf_reverb_state_st *rv, double inputL, double inputR, double *outputL, double *outputR)
 {
+    if (!rv->mem)
+    {
+        *outputL = inputL;
+        *outputR = inputR;
+        return;
+    }
     // extra hardcoded constants
     const double modnoise1 = 0.09;
     const double modnoise2 = 0.06;
     const double crossfeed = 0.4;
     // oversample buffer
-    double osL[SF_REVERB_OF], osR[SF_REVERB_OF];
+    v2d os[SF_REVERB_OF];
     double outLRef, outRRef;
     // early reflection
     earlyref_step(&rv->earlyref, inputL, inputR, &outLRef, &outRRef);
     double erL = outLRef * rv->ertolate + inputL;
     double erR = outRRef * rv->ertolate + inputR;
     // oversample the single input into multiple outputs
-    oversample_stepup(&rv->oversampleL, erL, osL);
-    oversample_stepup(&rv->oversampleR, erR, osR);
+    v2d er = { erL, erR };
+    oversample_up(&rv->oversample, &er, os, 1);
     // for each oversampled sample...
-    for (int i2 = 0; i2 < rv->oversampleL.factor; i2++)
+    for (int i2 = 0; i2 < rv->oversample.factor; i2++)
     {
         // dc cut
-        double outL = dccut_step(&rv->dccutL, osL[i2]);
-        double outR = dccut_step(&rv->dccutR, osR[i2]);
+        double outL = dccut_step(&rv->dccutL, os[i2][0]);
+        double outR = dccut_step(&rv->dccutR, os[i2][1]);
         // noise
         double mnoise = noise_step(&rv->noise);
         double lfo = (lfo_step(&rv->lfo1) + modnoise1 * mnoise) * rv->wander;
@@ -925,15 +1314,213 @@ void sf_reverb_process(sf_reverb_state_st *rv, double inputL, double inputR, dou
         outR = comb_step(&rv->combR, B, -lfo);
         outL = delay_step(&rv->lastdelayL, biquad_step(&rv->lastlpfL, outL));
         outR = delay_step(&rv->lastdelayR, biquad_step(&rv->lastlpfR, outR));
-        osL[i2] = outL * rv->wet1 + outR * rv->wet2 +
-                  delay_step(&rv->inpdelayL, osL[i2]) * rv->dry;
-        osR[i2] = outR * rv->wet1 + outL * rv->wet2 +
-                  delay_step(&rv->inpdelayR, osR[i2]) * rv->dry;
+        os[i2][0] = outL * rv->wet1 + outR * rv->wet2;
+        os[i2][1] = outR * rv->wet1 + outL * rv->wet2;
     }
-    double outL = oversample_stepdown(&rv->oversampleL, osL);
-    double outR = oversample_stepdown(&rv->oversampleR, osR);
+    oversample_down(&rv->oversample, os, 1);
+    double outL = os[0][0] + delay_step(&rv->inpdelayL, erL) * rv->dry;
+    double outR = os[0][1] + delay_step(&rv->inpdelayR, erR) * rv->dry;
     outL += outLRef * rv->erefwet + inputL * rv->dry;
     outR += outRRef * rv->erefwet + inputR * rv->dry;
     *outputL = outL;
     *outputR = outR;
 }
+
+void sf_reverb_process_block(sf_reverb_state_st *rv, const double *inputL, const double *inputR, double *outputL, double *outputR, int n)
+{
+    static const double gaintblL[18] = { 0.841, 0.504, 0.491, 0.379, 0.380, 0.346, 0.289, 0.272, 0.192, 0.193, 0.217, 0.181, 0.180, 0.181, 0.176, 0.142, 0.167, 0.134 };
+    static const double gaintblR[18] = { 0.842, 0.506, 0.489, 0.382, 0.300, 0.346, 0.290, 0.271, 0.193, 0.192, 0.217, 0.195, 0.192, 0.166, 0.186, 0.131, 0.168, 0.133 };
+    const double modnoise1 = 0.09;
+    const double modnoise2 = 0.06;
+    const double crossfeed = 0.4;
+    if (!rv->mem)
+    {
+        memmove(outputL, inputL, n * sizeof(double));
+        memmove(outputR, inputR, n * sizeof(double));
+        return;
+    }
+    sf_rv_earlyref_st *er = &rv->earlyref;
+    const int *oc = rv->outco;
+    const int factor = rv->oversample.factor;
+    // small filters and LFOs live in registers for the block and are written back at the end
+    rv_iir1_lr erhpf, erlpf, clpf, damplp;
+    rv_biquad_lr erapx, erap, bassap, basslp, lastlpf;
+    rv_dccut_lr dccut;
+    sf_rv_lfo_st lfo1 = rv->lfo1, lfo2 = rv->lfo2;
+    sf_rv_iir1_st lfo1_lpf = rv->lfo1_lpf, lfo2_lpf = rv->lfo2_lpf;
+    iir1_load_lr(&erhpf, &er->hpfL, &er->hpfR);
+    iir1_load_lr(&erlpf, &er->lpfL, &er->lpfR);
+    iir1_load_lr(&clpf, &rv->clpfL, &rv->clpfR);
+    iir1_load_lr(&damplp, &rv->damplpL, &rv->damplpR);
+    biquad_load_lr(&erapx, &er->allpassXL, &er->allpassXR);
+    biquad_load_lr(&erap, &er->allpassL, &er->allpassR);
+    biquad_load_lr(&bassap, &rv->bassapL, &rv->bassapR);
+    biquad_load_lr(&basslp, &rv->basslpL, &rv->basslpR);
+    biquad_load_lr(&lastlpf, &rv->lastlpfL, &rv->lastlpfR);
+    dccut.gain = pair(rv->dccutL.gain, rv->dccutR.gain);
+    dccut.y1 = pair(rv->dccutL.y1, rv->dccutR.y1);
+    dccut.y2 = pair(rv->dccutL.y2, rv->dccutR.y2);
+    const v2d erwet1 = pair(er->wet1, er->wet1), erwet2 = pair(er->wet2, er->wet2);
+    const v2d wet1 = pair(rv->wet1, rv->wet1), wet2 = pair(rv->wet2, rv->wet2), dry = pair(rv->dry, rv->dry);
+    const double ertolate = rv->ertolate, erefwet = rv->erefwet, loopdecay = rv->loopdecay, bassb = rv->bassb, wander = rv->wander;
+    // the early reflections only depend on the input, so each chunk gets them first, is resampled in
+    // one go and the network then steps over the oversampled frames
+    v2d ref[SF_REVERB_BLOCK], erin[SF_REVERB_BLOCK], os[SF_REVERB_OF * SF_REVERB_BLOCK];
+    for (int c = 0; c < n; c += SF_REVERB_BLOCK)
+    {
+        const int cn = n - c < SF_REVERB_BLOCK ? n - c : SF_REVERB_BLOCK;
+        for (int s = 0; s < cn; s++)
+        {
+            v2d in = { inputL[c + s], inputR[c + s] };
+            // early reflection
+            delay_step(&er->delayPWL, in[0]);
+            delay_step(&er->delayPWR, in[1]);
+            v2d wet = { 0.0, 0.0 };
+            for (int i = 0; i < 18; i++)
+                wet += pair(gaintblL[i], gaintblR[i]) * pair(delay_get(&er->delayPWL, er->delaytblL[i]), delay_get(&er->delayPWR, er->delaytblR[i]));
+            v2d r = delay_step_lr(&er->delayRL, &er->delayLR, swaplr(in + wet));
+            r = biquad_step_lr(&erapx, r);
+            r = biquad_step_lr(&erap, erwet1 * wet + erwet2 * r);
+            r = iir1_step_lr(&erhpf, r);
+            r = iir1_step_lr(&erlpf, r);
+            ref[s] = r;
+            erin[s] = r * ertolate + in;
+        }
+        oversample_up(&rv->oversample, erin, os, cn);
+        for (int i = 0; i < cn * factor; i++)
+        {
+            // dc cut
+            v2d out = dccut_step_lr(&dccut, os[i]);
+            // noise
+            double mnoise = noise_step(&rv->noise);
+            double lfo = (lfo_step(&lfo1) + modnoise1 * mnoise) * wander;
+            lfo = iir1_step(&lfo1_lpf, lfo);
+            mnoise *= modnoise2;
+            // diffusion
+            for (int j = 0, sg = -1; j < 10; j++, sg = -sg)
+                out = allpassm_step_lr(&rv->diffL[j], &rv->diffR[j], out, pair(lfo * sg, lfo), pair(mnoise, mnoise * sg));
+            // cross fade
+            v2d cross = out;
+            for (int j = 0; j < 4; j++)
+                cross = allpass_step_lr(&rv->crossL[j], &rv->crossR[j], cross);
+            out = iir1_step_lr(&clpf, out + crossfeed * swaplr(cross));
+            // bass boost
+            cross = swaplr(pair(delay_getlast(&rv->cdelayL), delay_getlast(&rv->cdelayR)));
+            out += loopdecay * (cross + bassb * biquad_step_lr(&basslp, biquad_step_lr(&bassap, cross)));
+            // dampening
+            out = iir1_step_lr(&damplp, out);
+            out = allpassm_step_lr(&rv->dampap1L, &rv->dampap1R, out, pair(lfo, -lfo), pair(mnoise, -mnoise));
+            out = delay_step_lr(&rv->dampdL, &rv->dampdR, out);
+            out = allpassm_step_lr(&rv->dampap2L, &rv->dampap2R, out, pair(-lfo, lfo), pair(-mnoise, mnoise));
+            // update cross fade bass boost delay
+            v2d bass = delay_step_lr(&rv->cbassd1L, &rv->cbassd1R, out);
+            bass = allpass2_step_lr(&rv->cbassap1L, &rv->cbassap1R, bass);
+            bass = delay_step_lr(&rv->cbassd2L, &rv->cbassd2R, bass);
+            bass = allpass3_step_lr(&rv->cbassap2L, &rv->cbassap2R, bass, pair(lfo, -lfo));
+            delay_step_lr(&rv->cdelayL, &rv->cdelayR, bass);
+            // output taps, the right channel mirrors the left with the lines swapped
+            v2d t1 = pair(delay_get(&rv->cbassd1L, oc[0]), delay_get(&rv->cbassd1R, oc[16]));
+            v2d t2 =
+                pair(delay_get(&rv->cbassd2L, oc[1]), delay_get(&rv->cbassd2R, oc[17])) -
+                pair(delay_get(&rv->cbassd2R, oc[2]), delay_get(&rv->cbassd2L, oc[18])) +
+                pair(delay_get(&rv->cbassd2L, oc[3]), delay_get(&rv->cbassd2R, oc[19])) -
+                pair(delay_get(&rv->cdelayR, oc[4]), delay_get(&rv->cdelayL, oc[20])) -
+                pair(delay_get(&rv->cbassd1R, oc[5]), delay_get(&rv->cbassd1L, oc[21])) -
+                pair(delay_get(&rv->cbassd2R, oc[6]), delay_get(&rv->cbassd2L, oc[22]));
+            v2d t3 =
+                pair(delay_get(&rv->cdelayL, oc[7]), delay_get(&rv->cdelayR, oc[23])) +
+                pair(allpass2_get1(&rv->cbassap1L, oc[8]), allpass2_get1(&rv->cbassap1R, oc[24])) +
+                pair(allpass2_get2(&rv->cbassap1L, oc[9]), allpass2_get2(&rv->cbassap1R, oc[25])) -
+                pair(allpass2_get2(&rv->cbassap1R, oc[10]), allpass2_get2(&rv->cbassap1L, oc[26])) +
+                pair(allpass3_get1(&rv->cbassap2L, oc[11]), allpass3_get1(&rv->cbassap2R, oc[27])) +
+                pair(allpass3_get2(&rv->cbassap2L, oc[12]), allpass3_get2(&rv->cbassap2R, oc[28])) +
+                pair(allpass3_get3(&rv->cbassap2L, oc[13]), allpass3_get3(&rv->cbassap2R, oc[29])) -
+                pair(allpass3_get2(&rv->cbassap2R, oc[14]), allpass3_get2(&rv->cbassap2L, oc[30]));
+            v2d t4 = pair(delay_get(&rv->cdelayL, oc[15]), delay_get(&rv->cdelayR, oc[31]));
+            v2d taps = t1 * 0.469 + t2 * 0.219 + t3 * 0.064 + t4 * 0.045;
+            lfo = iir1_step(&lfo2_lpf, lfo_step(&lfo2) * wander);
+            out = comb_step_lr(&rv->combL, &rv->combR, taps, pair(lfo, -lfo));
+            out = delay_step_lr(&rv->lastdelayL, &rv->lastdelayR, biquad_step_lr(&lastlpf, out));
+            os[i] = out * wet1 + swaplr(out) * wet2;
+        }
+        oversample_down(&rv->oversample, os, cn);
+        for (int s = 0; s < cn; s++)
+        {
+            v2d in = { inputL[c + s], inputR[c + s] };
+            v2d out = os[s] + delay_step_lr(&rv->inpdelayL, &rv->inpdelayR, erin[s]) * dry;
+            out += ref[s] * erefwet + in * dry;
+            outputL[c + s] = out[0];
+            outputR[c + s] = out[1];
+        }
+    }
+    iir1_save_lr(&erhpf, &er->hpfL, &er->hpfR);
+    iir1_save_lr(&erlpf, &er->lpfL, &er->lpfR);
+    iir1_save_lr(&clpf, &rv->clpfL, &rv->clpfR);
+    iir1_save_lr(&damplp, &rv->damplpL, &rv->damplpR);
+    biquad_save_lr(&erapx, &er->allpassXL, &er->allpassXR);
+    biquad_save_lr(&erap, &er->allpassL, &er->allpassR);
+    biquad_save_lr(&bassap, &rv->bassapL, &rv->bassapR);
+    biquad_save_lr(&basslp, &rv->basslpL, &rv->basslpR);
+    biquad_save_lr(&lastlpf, &rv->lastlpfL, &rv->lastlpfR);
+    rv->dccutL.y1 = dccut.y1[0];
+    rv->dccutR.y1 = dccut.y1[1];
+    rv->dccutL.y2 = dccut.y2[0];
+    rv->dccutR.y2 = dccut.y2[1];
+    rv->lfo1 = lfo1;
+    rv->lfo2 = lfo2;
+    rv->lfo1_lpf = lfo1_lpf;
+    rv->lfo2_lpf = lfo2_lpf;
+}
+
+static double benchmark_clock(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int sf_reverb_benchmark(int rate, sf_reverb_preset preset, double seconds, double *load)
+{
+    const int frames = 1024;
+    if ((unsigned)preset >= sizeof(presets) / sizeof(presets[0]))
+        return 0;
+    sf_reverb_state_st *rv = (sf_reverb_state_st*)calloc(1, sizeof(sf_reverb_state_st));
+    double *bufL = (double*)malloc(frames * sizeof(double));
+    double *bufR = (double*)malloc(frames * sizeof(double));
+    if (!rv || !bufL || !bufR)
+    {
+        free(rv);
+        free(bufL);
+        free(bufR);
+        return 0;
+    }
+    int blocks = (int)(seconds * rate / frames) + 1, count = 0;
+    for (int factor = 1; factor <= SF_REVERB_OF; factor <<= 1, count++)
+    {
+        const int i = preset;
+        if (!sf_advancereverb(rv, rate, factor, presets[i].p1, presets[i].p2, presets[i].p3, presets[i].p4,
+                              presets[i].p5, presets[i].p6, presets[i].p7, presets[i].p8, presets[i].p9, presets[i].p10,
+                              presets[i].p11, presets[i].p12, presets[i].p13, presets[i].p14, presets[i].p15, presets[i].p16))
+            break;
+        uint32_t seed = 1;
+        double elapsed = 0.0;
+        for (int b = 0; b < blocks; b++)
+        {
+            for (int j = 0; j < frames; j++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                bufL[j] = (double)(int32_t)seed * (0.25 / 2147483648.0);
+                bufR[j] = -bufL[j];
+            }
+            double start = benchmark_clock();
+            sf_reverb_process_block(rv, bufL, bufR, bufL, bufR, frames);
+            elapsed += benchmark_clock() - start;
+        }
+        load[count] = 100.0 * elapsed * rate / ((double)blocks * frames);
+    }
+    sf_reverb_free(rv);
+    free(rv);
+    free(bufL);
+    free(bufR);
+    return count;
+}
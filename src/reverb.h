@@ -7,16 +7,20 @@
 
 #ifndef SNDFILTER_REVERB__H
 #define SNDFILTER_REVERB__H
+#include <stddef.h>
+#include <stdint.h>
 // this API works by first initializing an sf_reverb_state_st structure, then using it to process a
 // sample in chunks
 //
-//   sf_reverb_state_st rv;
+//   sf_reverb_state_st rv = { 0 };
 //   sf_presetreverb(&rv, 44100, SF_REVERB_PRESET_DEFAULT);
 //
 //   for each abitrary length sample:
 //   double outputL, outputR;
 //   sf_reverb_process(&rv, inputL, inputR, &outputL, &outputR);
 //
+//   sf_reverb_free(&rv);
+//
 // notice that sf_reverb_process will change a lot of the member variables inside of the state
 // structure, since these values must be carried over across chunk boundaries
 //
@@ -49,13 +53,12 @@
 // in one pass
 
 // delay
-// delay buffer size; maximum size allowed for a delay
-#define SF_REVERB_DS        3000
+// the buffers of all delay based components are slices of the state's arena, see below
 typedef struct
 {
     int pos;                 // current write position
     int size;                // delay size
-    double buf[SF_REVERB_DS]; // delay buffer
+    double *buf;             // delay buffer
 } sf_rv_delay_st;
 
 // 1st order IIR filter
@@ -98,12 +101,25 @@ typedef struct
 
 // oversampling
 // maximum oversampling factor
-#define SF_REVERB_OF        2
+#define SF_REVERB_OF        4
+// maximum number of nonzero taps on each side of a half-band filter's centre tap
+#define SF_REVERB_HBT       12
+// one polyphase half-band stage, doubling or halving the rate of both channels at once
+// histories hold the last input frames with left and right interleaved, oldest first
+typedef struct
+{
+    int taps;                        // nonzero taps on each side of the centre
+    double coef[SF_REVERB_HBT];      // twice the odd taps h[1], h[3], ... moving away from the centre
+    double up[4 * SF_REVERB_HBT];    // interpolator input
+    double down[4 * SF_REVERB_HBT];  // decimator odd phase input
+    double downc[2 * SF_REVERB_HBT]; // decimator even phase input, delayed onto the centre tap
+} sf_rv_halfband_st;
 typedef struct
 {
-    int factor;           // oversampling factor [1 to SF_REVERB_OF]
-    sf_rv_biquad_st lpfU; // lowpass filter used for upsampling
-    sf_rv_biquad_st lpfD; // lowpass filter used for downsampling
+    int factor;   // oversampling factor, 1, 2 or SF_REVERB_OF
+    int stages;   // cascaded half-band stages, log2(factor)
+    int latency;  // delay of a round trip through the stages, in oversampled frames
+    sf_rv_halfband_st hb[2]; // first stage runs at the input rate
 } sf_rv_oversample_st;
 
 // dc cut
@@ -120,6 +136,7 @@ typedef struct
 typedef struct
 {
     int pos;                 // current read position in the buffer
+    uint32_t state[4];       // random generator of this instance, one per SIMD lane
     double buf[SF_REVERB_NS]; // buffer filled with noise
 } sf_rv_noise_st;
 
@@ -134,21 +151,16 @@ typedef struct
 } sf_rv_lfo_st;
 
 // all-pass filter
-// maximum size
-#define SF_REVERB_APS       3400
 typedef struct
 {
     int pos;
     int size;
     double feedback;
     double decay;
-    double buf[SF_REVERB_APS];
+    double *buf;
 } sf_rv_allpass_st;
 
 // 2nd order all-pass filter
-// maximum sizes of the two buffers
-#define SF_REVERB_AP2S1     4200
-#define SF_REVERB_AP2S2     3000
 typedef struct
 {
     //    line 1                 line 2
@@ -156,15 +168,10 @@ typedef struct
     int   size1, size2;
     double feedback1, feedback2;
     double decay1, decay2;
-    double buf1[SF_REVERB_AP2S1], buf2[SF_REVERB_AP2S2];
+    double *buf1, *buf2;
 } sf_rv_allpass2_st;
 
 // 3rd order all-pass filter with modulation
-// maximum sizes of the three buffers and maximum mod size of the first line
-#define SF_REVERB_AP3S1     4000
-#define SF_REVERB_AP3M1     600
-#define SF_REVERB_AP3S2     2000
-#define SF_REVERB_AP3S3     3000
 typedef struct
 {
     //    line 1 (with modulation)                 line 2                 line 3
@@ -172,13 +179,10 @@ typedef struct
     int   size1, msize1, size2, size3;
     double feedback1, feedback2, feedback3;
     double decay1, decay2, decay3;
-    double buf1[SF_REVERB_AP3S1 + SF_REVERB_AP3M1], buf2[SF_REVERB_AP3S2], buf3[SF_REVERB_AP3S3];
+    double *buf1, *buf2, *buf3;
 } sf_rv_allpass3_st;
 
 // modulated all-pass filter
-// maximum size and maximum mod size
-#define SF_REVERB_APMS      3600
-#define SF_REVERB_APMM      137
 typedef struct
 {
     int rpos, wpos;
@@ -186,27 +190,26 @@ typedef struct
     double feedback;
     double decay;
     double z1;
-    double buf[SF_REVERB_APMS + SF_REVERB_APMM];
+    double *buf;
 } sf_rv_allpassm_st;
 
 // comb filter
-// maximum size of the buffer
-#define SF_REVERB_CS        1500
 typedef struct
 {
     int pos;
     int size;
-    double buf[SF_REVERB_CS];
+    double *buf;
 } sf_rv_comb_st;
 
 //
 // the final reverb state structure
 //
-// note: this struct is about 1Mb
+// note: the delay lines are sized from the sample rate and oversampling factor and live in one heap
+// block, which sf_advancereverb (re)allocates and sf_reverb_free releases. a zeroed state owns none
 typedef struct
 {
     sf_rv_earlyref_st   earlyref;
-    sf_rv_oversample_st oversampleL, oversampleR;
+    sf_rv_oversample_st oversample;
     sf_rv_dccut_st      dccutL, dccutR;
     sf_rv_noise_st      noise;
     sf_rv_lfo_st        lfo1;
@@ -239,6 +242,8 @@ typedef struct
     double ertolate; // early reflection mix parameters
     double erefwet;
     double dry;
+    double *mem;     // arena holding every delay buffer above
+    size_t memsize;  // its capacity in doubles
 } sf_reverb_state_st;
 
 typedef enum
@@ -265,12 +270,15 @@ typedef enum
 } sf_reverb_preset;
 
 // populate a reverb state with a preset
-void sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
+// returns 0 when the preset is unknown or the delay memory could not be allocated, a state without
+// memory passes audio through
+int sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
 
-// populate a reverb state with advanced parameters
-void sf_advancereverb(sf_reverb_state_st *rv,
+// populate a reverb state with advanced parameters, the arena of an earlier call is reused when it
+// is large enough. returns 0 like sf_presetreverb
+int sf_advancereverb(sf_reverb_state_st *rv,
                       int rate,             // input sample rate (samples per second)
-                      int oversamplefactor, // how much to oversample [1 to 4]
+                      int oversamplefactor, // how much to oversample [1 to 4], 3 runs at 2
                       double ertolate,       // early reflection amount [0 to 1]
                       double erefwet,        // dB, final wet mix [-70 to 10]
                       double dry,            // dB, final dry mix [-70 to 10]
@@ -289,7 +297,19 @@ void sf_advancereverb(sf_reverb_state_st *rv,
                       double delay          // seconds, amount of delay [-0.5 to 0.5]
                      );
 
+// release the delay memory of a state, it has to be populated again before processing
+void sf_reverb_free(sf_reverb_state_st *rv);
+
 // this function will process the input sound based on the state passed
 // the input and output buffers should be the same size
 void sf_reverb_process(sf_reverb_state_st *rv, double inputL, double inputR, double *outputL, double *outputR);
+
+// same as calling sf_reverb_process on each sample, with both channels stepped together in SIMD
+// lanes; the outputs may alias the inputs
+void sf_reverb_process_block(sf_reverb_state_st *rv, const double *inputL, const double *inputR, double *outputL, double *outputR, int n);
+
+// times the block processor on noise at every oversampling factor, 1, 2 up to SF_REVERB_OF, with
+// the rest of the preset unchanged. load receives the share of one core in % that each factor
+// takes to run in real time. returns the number of factors measured
+int sf_reverb_benchmark(int rate, sf_reverb_preset preset, double seconds, double *load);
 #endif // SNDFILTER_REVERB__H
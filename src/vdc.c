@@ -3,6 +3,8 @@
 #include <errno.h>
 #include <math.h>
 #include <float.h>
+#include <limits.h>
+#include "VectorMath.h"
 #include "vdc.h"
 double SOS_DF2Process(DirectForm2 *df2, double x1)
 {
@@ -25,148 +27,197 @@ void SOS_DF2_StereoProcess(DirectForm2 *df2, double x1, double x2, double *Out_y
 	df2->v1R = w2;
 	*Out_y2 = y2;
 }
-int countChars(char* s, char c)
+// Sections are packed next to each other with every coefficient repeated for both lanes, left and right run together
+void SOSCascadeLoad(SOSCascade *cascade, DirectForm2 **sos, int sosCount)
 {
-    int res = 0;
-    if(s==NULL){
-        printf("[E] CountChars/DDCParser: input buffer is null\n");
-        return;
-    }
-    for (int i=0;i<strlen(s);i++)
-        if (s[i] == c)
-            res++;
-    return res;
-}
-int get_doubleVDC(char *val, double *F)
-{
-	char *eptr;
-	errno = 0;
-	double f = strtod(val, &eptr);
-	if (eptr != val && errno != ERANGE)
+	int j, kept = cascade->sections < sosCount ? cascade->sections : sosCount;
+	if (sosCount > cascade->allocated)
 	{
-		*F = f;
-		return 1;
+		cascade->coeffs = (double*)realloc(cascade->coeffs, sosCount * 10 * sizeof(double));
+		cascade->state = (double*)realloc(cascade->state, sosCount * 4 * sizeof(double));
+		cascade->allocated = sosCount;
 	}
-	return 0;
-}
-int DDCParser(char *DDCString, DirectForm2 ***ptrdf441, DirectForm2 ***ptrdf48)
-{
-
-	char *fs44_1 = strstr(DDCString, "SR_44100");
-	char *fs48 = strstr(DDCString, "SR_48000");
-
-	int numberCount = (countChars(fs48, ',') + 1);
-	int sosCount = numberCount / 5;
-	DirectForm2 **df441 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
-	DirectForm2 **df48 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
-	int i;
-	for (i = 0; i < sosCount; i++)
+	for (j = 0; j < sosCount; j++)
 	{
-		df441[i] = (DirectForm2*)malloc(sizeof(DirectForm2));
-		memset(df441[i], 0, sizeof(DirectForm2));
-		df48[i] = (DirectForm2*)malloc(sizeof(DirectForm2));
-		memset(df48[i], 0, sizeof(DirectForm2));
+		v2dStore(cascade->coeffs + j * 10, (v2d){ sos[j]->b0, sos[j]->b0 });
+		v2dStore(cascade->coeffs + j * 10 + 2, (v2d){ sos[j]->b1, sos[j]->b1 });
+		v2dStore(cascade->coeffs + j * 10 + 4, (v2d){ sos[j]->b2, sos[j]->b2 });
+		v2dStore(cascade->coeffs + j * 10 + 6, (v2d){ sos[j]->a1, sos[j]->a1 });
+		v2dStore(cascade->coeffs + j * 10 + 8, (v2d){ sos[j]->a2, sos[j]->a2 });
 	}
-	double number;
-	i = 0;
-	int counter = 0;
-	int b0b1b2a1a2 = 0;
-	char *startingPoint = fs44_1 + 9;
-	while (counter < numberCount)
+	if (sosCount > kept)
+		memset(cascade->state + kept * 4, 0, (sosCount - kept) * 4 * sizeof(double));
+	cascade->sections = sosCount;
+}
+void SOSCascadeFree(SOSCascade *cascade)
+{
+	free(cascade->coeffs);
+	free(cascade->state);
+	memset(cascade, 0, sizeof(SOSCascade));
+}
+typedef struct
+{
+	v2d b0, b1, b2, a1, a2, v1, v2;
+} SOSLanes;
+static inline v2d SOSLanesStep(SOSLanes *s, v2d x)
+{
+	// Same operation order as SOS_DF2_StereoProcess
+	v2d w = x - s->a1 * s->v1 - s->a2 * s->v2;
+	v2d y = s->b0 * w + s->b1 * s->v1 + s->b2 * s->v2;
+	s->v2 = s->v1;
+	s->v1 = w;
+	return y;
+}
+static inline void SOSLanesLoad(SOSLanes *s, const double *coeffs, const double *state)
+{
+	s->b0 = v2dLoad(coeffs);
+	s->b1 = v2dLoad(coeffs + 2);
+	s->b2 = v2dLoad(coeffs + 4);
+	s->a1 = v2dLoad(coeffs + 6);
+	s->a2 = v2dLoad(coeffs + 8);
+	s->v1 = v2dLoad(state);
+	s->v2 = v2dLoad(state + 2);
+}
+static inline void SOSLanesSave(const SOSLanes *s, double *state)
+{
+	v2dStore(state, s->v1);
+	v2dStore(state + 2, s->v2);
+}
+#define SOS_CASCADE_CHUNK 256
+#define SOS_CASCADE_SKEW 4
+// Section k of a group works on sample t - k, so the group's recursions are independent and overlap in the pipeline
+static inline void SOSCascadeSkewed(SOSLanes *s, int sections, v2d *buf, int t, int m)
+{
+	for (int k = 0; k < sections; k++)
+		if (t - k >= 0 && t - k < m)
+			buf[t - k] = SOSLanesStep(&s[k], buf[t - k]);
+}
+void SOSCascadeProcess(SOSCascade *cascade, const double *x1, const double *x2, double *y1, double *y2, int n)
+{
+	v2d buf[SOS_CASCADE_CHUNK];
+	SOSLanes s[SOS_CASCADE_SKEW];
+	int done, i, j, k, m, t, group;
+	for (done = 0; done < n; done += m)
 	{
-		if (get_doubleVDC(startingPoint, &number))
+		m = n - done < SOS_CASCADE_CHUNK ? n - done : SOS_CASCADE_CHUNK;
+		for (i = 0; i < m; i++)
+			buf[i] = (v2d){ x1[done + i], x2[done + i] };
+		for (j = 0; j < cascade->sections; j += group)
 		{
-			double val = strtod(startingPoint, &startingPoint);
-			counter++;
-			if (!b0b1b2a1a2)
-				df441[i]->b0 = val;
-			else if (b0b1b2a1a2 == 1)
-				df441[i]->b1 = val;
-			else if (b0b1b2a1a2 == 2)
-				df441[i]->b2 = val;
-			else if (b0b1b2a1a2 == 3)
-				df441[i]->a1 = -val;
-			else if (b0b1b2a1a2 == 4)
+			group = cascade->sections - j < SOS_CASCADE_SKEW ? cascade->sections - j : SOS_CASCADE_SKEW;
+			for (k = 0; k < group; k++)
+				SOSLanesLoad(&s[k], cascade->coeffs + (j + k) * 10, cascade->state + (j + k) * 4);
+			// Ramp up and down with bounds checks, every section busy in between
+			for (t = 0; t < group - 1; t++)
+				SOSCascadeSkewed(s, group, buf, t, m);
+			if (group == 4)
 			{
-				df441[i]->a2 = -val;
-				i++;
+				for (; t < m; t++)
+				{
+					buf[t] = SOSLanesStep(&s[0], buf[t]);
+					buf[t - 1] = SOSLanesStep(&s[1], buf[t - 1]);
+					buf[t - 2] = SOSLanesStep(&s[2], buf[t - 2]);
+					buf[t - 3] = SOSLanesStep(&s[3], buf[t - 3]);
+				}
 			}
-			b0b1b2a1a2++;
-			if (b0b1b2a1a2 == 5)
-				b0b1b2a1a2 = 0;
-		}
-		else
-			startingPoint++;
-	}
-	i = 0;
-	counter = 0;
-	b0b1b2a1a2 = 0;
-	startingPoint = fs48 + 9;
-	while (counter < numberCount)
-	{
-		if (get_doubleVDC(startingPoint, &number))
-		{
-			double val = strtod(startingPoint, &startingPoint);
-			counter++;
-			if (!b0b1b2a1a2)
-				df48[i]->b0 = val;
-			else if (b0b1b2a1a2 == 1)
-				df48[i]->b1 = val;
-			else if (b0b1b2a1a2 == 2)
-				df48[i]->b2 = val;
-			else if (b0b1b2a1a2 == 3)
-				df48[i]->a1 = -val;
-			else if (b0b1b2a1a2 == 4)
+			else if (group == 3)
+			{
+				for (; t < m; t++)
+				{
+					buf[t] = SOSLanesStep(&s[0], buf[t]);
+					buf[t - 1] = SOSLanesStep(&s[1], buf[t - 1]);
+					buf[t - 2] = SOSLanesStep(&s[2], buf[t - 2]);
+				}
+			}
+			else if (group == 2)
 			{
-				df48[i]->a2 = -val;
-				i++;
+				for (; t < m; t++)
+				{
+					buf[t] = SOSLanesStep(&s[0], buf[t]);
+					buf[t - 1] = SOSLanesStep(&s[1], buf[t - 1]);
+				}
 			}
-			b0b1b2a1a2++;
-			if (b0b1b2a1a2 == 5)
-				b0b1b2a1a2 = 0;
+			else
+			{
+				for (; t < m; t++)
+					buf[t] = SOSLanesStep(&s[0], buf[t]);
+			}
+			for (; t < m + group - 1; t++)
+				SOSCascadeSkewed(s, group, buf, t, m);
+			for (k = 0; k < group; k++)
+				SOSLanesSave(&s[k], cascade->state + (j + k) * 4);
+		}
+		for (i = 0; i < m; i++)
+		{
+			y1[done + i] = buf[i][0];
+			y2[done + i] = buf[i][1];
 		}
-		else
-			startingPoint++;
 	}
-	*ptrdf441 = df441;
-	*ptrdf48 = df48;
-	return sosCount;
-}
-void complexMultiplicationRI(double *zReal, double *zImag, double xReal, double xImag, double yReal, double yImag)
-{
-	*zReal = xReal * yReal - xImag * yImag;
-	*zImag = xReal * yImag + xImag * yReal;
 }
-void complexDivisionRI(double *zReal, double *zImag, double xReal, double xImag, double yReal, double yImag)
+static int countChars(const char *s, char c)
 {
-	*zReal = (xReal * yReal + xImag * yImag) / (yReal * yReal + yImag * yImag);
-	*zImag = (xImag * yReal - xReal * yImag) / (yReal * yReal + yImag * yImag);
+	int res = 0;
+	for (; *s && *s != 'S'; s++)
+		if (*s == c)
+			res++;
+	return res;
 }
-// Analytical magnitude response of digital filters
-void DigitalFilterMagnitudeResponsedB(DirectForm2 **IIR, int section, double *magnitude, int NumPts)
+// Reads the 5 * sosCount numbers following an SR_ marker. NaN and null become 0, they would otherwise blow the cascade up
+static void parseDDCRate(const char *s, DirectForm2 **df2, int sosCount)
 {
-	double Arg;
-	double z1Real, z1Imag, z2Real, z2Imag, HofZReal, HofZImag, DenomReal, DenomImag, tmpReal, tmpImag;
-	for (int j = 0; j < NumPts; j++)
+	char *end;
+	double val, *coeff;
+	int counter = 0, numberCount = sosCount * 5;
+	s += 9;
+	while (counter < numberCount && *s)
 	{
-		Arg = M_PI * (double)j / (double)NumPts;
-		z1Real = cos(Arg), z1Imag = -sin(Arg);
-		complexMultiplicationRI(&z2Real, &z2Imag, z1Real, z1Imag, z1Real, z1Imag);
-		HofZReal = 1.0, HofZImag = 0.0;
-		tmpReal = IIR[section]->b0 + IIR[section]->b1 * z1Real + IIR[section]->b2 * z2Real;
-		tmpImag = IIR[section]->b1 * z1Imag + IIR[section]->b2 * z2Imag;
-		complexMultiplicationRI(&HofZReal, &HofZImag, HofZReal, HofZImag, tmpReal, tmpImag);
-		DenomReal = 1.0 + IIR[section]->a1 * z1Real + IIR[section]->a2 * z2Real;
-		DenomImag = IIR[section]->a1 * z1Imag + IIR[section]->a2 * z2Imag;
-		if (sqrt(DenomReal * DenomReal + DenomImag * DenomImag) < DBL_EPSILON)
-			magnitude[j] = 0.0;
+		if (!strncmp(s, "null", 4))
+		{
+			val = 0.0;
+			end = (char*)s + 4;
+		}
 		else
 		{
-			complexDivisionRI(&HofZReal, &HofZImag, HofZReal, HofZImag, DenomReal, DenomImag);
-			magnitude[j] = 20.0 * log10(sqrt(HofZReal * HofZReal + HofZImag * HofZImag));
+			errno = 0;
+			val = strtod(s, &end);
+			if (end == s || errno == ERANGE)
+			{
+				s++;
+				continue;
+			}
+			if (val != val)
+				val = 0.0;
 		}
+		s = end;
+		coeff = &df2[counter / 5]->b0;
+		// File order is b0 b1 b2 a1 a2 with the feedback sign flipped
+		coeff[counter % 5] = counter % 5 > 2 ? -val : val;
+		counter++;
 	}
 }
+int DDCParser(char *DDCString, DirectForm2 ***ptrdf441, DirectForm2 ***ptrdf48)
+{
+	char *fs44_1 = strstr(DDCString, "SR_44100");
+	char *fs48 = strstr(DDCString, "SR_48000");
+	if (!fs44_1 || !fs48)
+		return 0;
+	int sosCount = (countChars(fs48 + 8, ',') + 1) / 5;
+	if (sosCount < 1)
+		return 0;
+	DirectForm2 **df441 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
+	DirectForm2 **df48 = (DirectForm2**)malloc(sosCount * sizeof(DirectForm2*));
+	int i;
+	for (i = 0; i < sosCount; i++)
+	{
+		df441[i] = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+		df48[i] = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+	}
+	parseDDCRate(fs44_1, df441, sosCount);
+	parseDDCRate(fs48, df48, sosCount);
+	*ptrdf441 = df441;
+	*ptrdf48 = df48;
+	return sosCount;
+}
 // DDC resampler
 void designPeakingFilter(double dbGain, double centreFreq, double fs, double dBandwidthOrQOrS, double *b0, double *b1, double *b2, double *a1, double *a2)
 {
@@ -190,62 +241,233 @@ void designPeakingFilter(double dbGain, double centreFreq, double fs, double dBa
 	*a1 = A1 / A0;
 	*a2 = A2 / A0;
 }
+// Inverse of designPeakingFilter. With the coefficients normalised b1 == a1 and b0 + b2 == 1 + a2, from which
+// cos(omega), alpha / A and alpha * A follow directly. Returns 0 for sections of any other form
+static int PeakingFilterParameters(const DirectForm2 *sos, double fs, double *dbGain, double *centreFreq, double *bandwidth)
+{
+	const double tol = 1e-6;
+	double onePlusA2 = 1.0 + sos->a2, oneMinusA2 = 1.0 - sos->a2, cs, omega, sn, alphaOverA, alphaA;
+	if (onePlusA2 <= DBL_EPSILON || oneMinusA2 <= DBL_EPSILON)
+		return 0;
+	if (fabs(sos->b1 - sos->a1) > tol * (1.0 + fabs(sos->a1)) || fabs(sos->b0 + sos->b2 - onePlusA2) > tol * onePlusA2)
+		return 0;
+	cs = -sos->a1 / onePlusA2;
+	alphaOverA = oneMinusA2 / onePlusA2;
+	alphaA = (sos->b0 - sos->b2) / onePlusA2;
+	if (fabs(cs) >= 1.0 || alphaA <= 0.0)
+		return 0;
+	omega = acos(cs);
+	sn = sin(omega);
+	// A^2 = alphaA / alphaOverA, the gain is 40 log10(A)
+	*dbGain = 20.0 * log10(alphaA / alphaOverA);
+	*centreFreq = omega * fs / 6.2831853071795862;
+	*bandwidth = asinh(sqrt(alphaA * alphaOverA) / sn) * sn / (omega * atanh(1.0 / 3.0));
+	return 1;
+}
+// Any other section goes through its bilinear prototype, prewarped so the response at refFreq stays in place
+static void BilinearRetarget(const DirectForm2 *in, double inFs, double refFreq, double outFs, DirectForm2 *out)
+{
+	// v = (1 - z^-1) / (1 + z^-1) at inFs is k times the same variable at outFs
+	double k = tan(M_PI * refFreq / inFs) / tan(M_PI * refFreq / outFs), k2 = k * k;
+	double n0 = in->b0 + in->b1 + in->b2, n1 = 2.0 * (in->b0 - in->b2) * k, n2 = (in->b0 - in->b1 + in->b2) * k2;
+	double d0 = 1.0 + in->a1 + in->a2, d1 = 2.0 * (1.0 - in->a2) * k, d2 = (1.0 - in->a1 + in->a2) * k2;
+	double a0 = d0 + d1 + d2;
+	out->b0 = (n0 + n1 + n2) / a0;
+	out->b1 = 2.0 * (n0 - n2) / a0;
+	out->b2 = (n0 - n1 + n2) / a0;
+	out->a1 = 2.0 * (d0 - d2) / a0;
+	out->a2 = (d0 - d1 + d2) / a0;
+}
 int PeakingFilterResampler(DirectForm2 **inputIIR, double inFs, DirectForm2 ***resampledIIR, double outFs, int sosCount)
 {
-	const int filterTestLength = 32768;
-	double *magnitude = (double*)malloc(filterTestLength * sizeof(double));
-	int i;
-	int outSOSCount = 0;
-	double *cell[3];
-	for (i = 0; i < 3; i++)
-		cell[i] = (double*)malloc(sosCount * sizeof(double));
+	int i, outSOSCount = 0;
+	double dbGain, centreFreq, bandwidth, poleFreq;
+	DirectForm2 **temp = (DirectForm2**)malloc((sosCount ? sosCount : 1) * sizeof(DirectForm2*));
 	for (i = 0; i < sosCount; i++)
 	{
-		DigitalFilterMagnitudeResponsedB(inputIIR, i, magnitude, filterTestLength);
-		double absoluteMax = fabs(magnitude[0]);
-		double centreFreq = 0.0;
-		int index = 0;
-		for (int c = 1; c < filterTestLength; c++)
+		DirectForm2 *df2 = (DirectForm2*)calloc(1, sizeof(DirectForm2));
+		if (PeakingFilterParameters(inputIIR[i], inFs, &dbGain, &centreFreq, &bandwidth))
 		{
-			if (fabs(magnitude[c]) > absoluteMax)
+			// Peaks at or above the new Nyquist frequency have nowhere to go
+			if (centreFreq >= outFs * 0.5)
 			{
-				absoluteMax = fabs(magnitude[c]);
-				index = c;
-				centreFreq = round(c * (inFs / filterTestLength / 2.0));
+				free(df2);
+				continue;
 			}
+			designPeakingFilter(dbGain, centreFreq, outFs, bandwidth, &df2->b0, &df2->b1, &df2->b2, &df2->a1, &df2->a2);
 		}
-		if (centreFreq < DBL_EPSILON)
-			centreFreq = DBL_EPSILON;
-		if (fabs(inputIIR[i]->b1) < DBL_EPSILON)
+		else
 		{
-			if (inputIIR[i]->b1 < 0.0)
-				inputIIR[i]->b1 = -DBL_EPSILON;
-			else
-				inputIIR[i]->b1 = DBL_EPSILON;
+			// Pole angle as the reference, complex poles have magnitude sqrt(a2)
+			poleFreq = inFs * 0.25;
+			if (inputIIR[i]->a2 > 0.0 && fabs(inputIIR[i]->a1) < 2.0 * sqrt(inputIIR[i]->a2))
+				poleFreq = acos(-inputIIR[i]->a1 / (2.0 * sqrt(inputIIR[i]->a2))) * inFs / 6.2831853071795862;
+			if (poleFreq >= outFs * 0.5 || poleFreq <= 0.0)
+				poleFreq = fmin(inFs, outFs) * 0.25;
+			BilinearRetarget(inputIIR[i], inFs, poleFreq, outFs, df2);
 		}
-		double omega = (6.2831853071795862 * centreFreq) / inFs;
-		double A0 = (-2.0 * cos(omega)) / inputIIR[i]->b1;
-		double lingain = pow(10.0, magnitude[index] / 40.0);
-		double num3 = sin(omega);
-		double bandwidth = ((asinh(((A0 - 1.0) * lingain) / num3) * num3) / omega) / 0.34657359027997264;
-		if (bandwidth > 98.8 - DBL_EPSILON)
-			bandwidth = 98.8;
-		if (centreFreq < outFs - DBL_EPSILON)
-			outSOSCount++;
-		cell[0][i] = magnitude[index];
-		cell[1][i] = centreFreq;
-		cell[2][i] = bandwidth;
-	}
-	free(magnitude);
-	DirectForm2 **temp = (DirectForm2**)malloc(outSOSCount * sizeof(DirectForm2*));
-	for (i = 0; i < outSOSCount; i++)
-	{
-		temp[i] = (DirectForm2*)malloc(sizeof(DirectForm2));
-		memset(temp[i], 0, sizeof(DirectForm2));
-		designPeakingFilter(cell[0][i], cell[1][i], outFs, cell[2][i], &temp[i]->b0, &temp[i]->b1, &temp[i]->b2, &temp[i]->a1, &temp[i]->a2);
+		temp[outSOSCount++] = df2;
 	}
-	for (i = 0; i < 3; i++)
-		free(cell[i]);
 	*resampledIIR = temp;
 	return outSOSCount;
 }
+// Graphic EQ
+static void designShelfFilter(int high, double dbGain, double cornerFreq, double fs, DirectForm2 *df2)
+{
+	// Slope 1 shelves, the gain is halfway (in dB) at the corner
+	double A = pow(10.0, dbGain / 40.0);
+	double omega = (6.2831853071795862 * cornerFreq) / fs;
+	double cs = cos(omega);
+	double beta = 2.0 * sqrt(A) * sin(omega) * 0.70710678118654752;
+	double sign = high ? -1.0 : 1.0;
+	double A0 = (A + 1.0) + sign * (A - 1.0) * cs + beta;
+	df2->b0 = A * ((A + 1.0) - sign * (A - 1.0) * cs + beta) / A0;
+	df2->b1 = sign * 2.0 * A * ((A - 1.0) - sign * (A + 1.0) * cs) / A0;
+	df2->b2 = A * ((A + 1.0) - sign * (A - 1.0) * cs - beta) / A0;
+	df2->a1 = -sign * 2.0 * ((A - 1.0) + sign * (A + 1.0) * cs) / A0;
+	df2->a2 = ((A + 1.0) + sign * (A - 1.0) * cs - beta) / A0;
+}
+static double SOSMagnitudedB(const DirectForm2 *df2, double omega)
+{
+	double c1 = cos(omega), s1 = -sin(omega), c2 = cos(2.0 * omega), s2 = -sin(2.0 * omega);
+	double nr = df2->b0 + df2->b1 * c1 + df2->b2 * c2, ni = df2->b1 * s1 + df2->b2 * s2;
+	double dr = 1.0 + df2->a1 * c1 + df2->a2 * c2, di = df2->a1 * s1 + df2->a2 * s2;
+	return 10.0 * log10((nr * nr + ni * ni) / (dr * dr + di * di) + DBL_MIN);
+}
+double SOSCascadeMagnitudedB(DirectForm2 **sos, int sosCount, double omega)
+{
+	double dB = 0.0;
+	for (int i = 0; i < sosCount; i++)
+		dB += SOSMagnitudedB(sos[i], omega);
+	return dB;
+}
+int SOSCascadeDecayLength(DirectForm2 **sos, int sosCount, double decaydB)
+{
+	double r, disc, longest = 0.0;
+	for (int i = 0; i < sosCount; i++)
+	{
+		// Largest pole radius of z^2 + a1 z + a2
+		disc = sos[i]->a1 * sos[i]->a1 - 4.0 * sos[i]->a2;
+		if (disc < 0.0)
+			r = sqrt(sos[i]->a2);
+		else
+			r = 0.5 * (fabs(sos[i]->a1) + sqrt(disc));
+		if (r >= 1.0)
+			return -1;
+		if (r > 0.0)
+			longest = fmax(longest, decaydB / (-20.0 * log10(r)));
+	}
+	return longest >= INT_MAX - 1 ? -1 : (int)ceil(longest) + 1;
+}
+static void designGraphicEqSection(const double *freq, int bands, int k, double dbGain, double fs, DirectForm2 *df2)
+{
+	double bw;
+	if (k == 0 && bands > 1)
+		designShelfFilter(0, dbGain, sqrt(freq[0] * freq[1]), fs, df2);
+	else if (k == bands - 1 && bands > 1)
+		designShelfFilter(1, dbGain, sqrt(freq[k - 1] * freq[k]), fs, df2);
+	else
+	{
+		// One band spacing wide, in octaves
+		bw = log2(freq[k + 1] / freq[k - 1]) * 0.5;
+		designPeakingFilter(dbGain, freq[k], fs, bw, &df2->b0, &df2->b1, &df2->b2, &df2->a1, &df2->a2);
+	}
+}
+static int solveLinearSystem(double *A, double *b, int n)
+{
+	// Gaussian elimination with partial pivoting, A is n x n row major, solution in b
+	int i, j, k, p;
+	double t;
+	for (k = 0; k < n; k++)
+	{
+		p = k;
+		for (i = k + 1; i < n; i++)
+			if (fabs(A[i * n + k]) > fabs(A[p * n + k]))
+				p = i;
+		if (fabs(A[p * n + k]) < DBL_EPSILON)
+			return 0;
+		if (p != k)
+		{
+			for (j = 0; j < n; j++)
+			{
+				t = A[k * n + j];
+				A[k * n + j] = A[p * n + j];
+				A[p * n + j] = t;
+			}
+			t = b[k];
+			b[k] = b[p];
+			b[p] = t;
+		}
+		for (i = k + 1; i < n; i++)
+		{
+			t = A[i * n + k] / A[k * n + k];
+			for (j = k; j < n; j++)
+				A[i * n + j] -= t * A[k * n + j];
+			b[i] -= t * b[k];
+		}
+	}
+	for (k = n - 1; k >= 0; k--)
+	{
+		for (j = k + 1; j < n; j++)
+			b[k] -= A[k * n + j] * b[j];
+		b[k] /= A[k * n + k];
+	}
+	return 1;
+}
+#define GRAPHICEQ_PROBE_DB 6.0
+#define GRAPHICEQ_MAX_DB 30.0
+#define GRAPHICEQ_REFINE 2
+int GraphicEqDesign(const double *freq, const double *gaindB, int bands, double fs, DirectForm2 *sos)
+{
+	// Neighbouring sections overlap, so their gains are solved from the interaction at the band centres instead of taken as is
+	int i, j, it, n = 0;
+	double omega[GRAPHICEQ_MAX_BANDS], target[GRAPHICEQ_MAX_BANDS], gains[GRAPHICEQ_MAX_BANDS], err[GRAPHICEQ_MAX_BANDS];
+	double B[GRAPHICEQ_MAX_BANDS * GRAPHICEQ_MAX_BANDS], A[GRAPHICEQ_MAX_BANDS * GRAPHICEQ_MAX_BANDS];
+	DirectForm2 probe;
+	// Bands too close to Nyquist cannot be realised as peaking sections
+	while (n < bands && n < GRAPHICEQ_MAX_BANDS && freq[n] < 0.45 * fs)
+		n++;
+	if (!n)
+		return 0;
+	for (i = 0; i < n; i++)
+	{
+		omega[i] = (6.2831853071795862 * freq[i]) / fs;
+		target[i] = gaindB[i];
+	}
+	for (j = 0; j < n; j++)
+	{
+		designGraphicEqSection(freq, n, j, GRAPHICEQ_PROBE_DB, fs, &probe);
+		for (i = 0; i < n; i++)
+			B[i * n + j] = SOSMagnitudedB(&probe, omega[i]) / GRAPHICEQ_PROBE_DB;
+	}
+	memcpy(A, B, n * n * sizeof(double));
+	memcpy(gains, target, n * sizeof(double));
+	if (!solveLinearSystem(A, gains, n))
+		memcpy(gains, target, n * sizeof(double));
+	for (it = 0; it <= GRAPHICEQ_REFINE; it++)
+	{
+		for (j = 0; j < n; j++)
+		{
+			if (gains[j] > GRAPHICEQ_MAX_DB)
+				gains[j] = GRAPHICEQ_MAX_DB;
+			if (gains[j] < -GRAPHICEQ_MAX_DB)
+				gains[j] = -GRAPHICEQ_MAX_DB;
+			designGraphicEqSection(freq, n, j, gains[j], fs, &sos[j]);
+		}
+		if (it == GRAPHICEQ_REFINE)
+			break;
+		// Section responses are not quite linear in their dB gain, correct the residual at the centres
+		for (i = 0; i < n; i++)
+		{
+			err[i] = target[i];
+			for (j = 0; j < n; j++)
+				err[i] -= SOSMagnitudedB(&sos[j], omega[i]);
+		}
+		memcpy(A, B, n * n * sizeof(double));
+		if (!solveLinearSystem(A, err, n))
+			break;
+		for (j = 0; j < n; j++)
+			gains[j] += err[j];
+	}
+	return n;
+}
@@ -5,5 +5,27 @@ typedef struct
 } DirectForm2;
 double SOS_DF2Process(DirectForm2 *df2, double x);
 void SOS_DF2_StereoProcess(DirectForm2 *df2, double x1, double x2, double *Out_y1, double *Out_y2);
+// Biquad cascade with its own copy of the coefficients, both channels of a section share one SIMD register.
+// Zeroed it is an empty cascade that passes audio through
+typedef struct
+{
+	int sections, allocated;
+	double *coeffs; // b0 b1 b2 a1 a2 per section, each twice
+	double *state; // v1 and v2 per section, left and right
+} SOSCascade;
+// Replaces the coefficients. Sections that existed before keep their state, new ones start at rest
+void SOSCascadeLoad(SOSCascade *cascade, DirectForm2 **sos, int sosCount);
+void SOSCascadeFree(SOSCascade *cascade);
+// Same arithmetic as SOS_DF2_StereoProcess per sample and section. Outputs may alias inputs
+void SOSCascadeProcess(SOSCascade *cascade, const double *x1, const double *x2, double *y1, double *y2, int n);
+// Magnitude of the whole cascade at omega in radians per sample
+double SOSCascadeMagnitudedB(DirectForm2 **sos, int sosCount, double omega);
+// Samples until the slowest pole has decayed by decaydB, -1 if a pole is on or outside the unit circle
+int SOSCascadeDecayLength(DirectForm2 **sos, int sosCount, double decaydB);
 int DDCParser(char *DDCString, DirectForm2 ***ptrdf441, DirectForm2 ***ptrdf48);
 int PeakingFilterResampler(DirectForm2 **inputIIR, double inFs, DirectForm2 ***resampledIIR, double outFs, int sosCount);
+void designPeakingFilter(double dbGain, double centreFreq, double fs, double dBandwidthOrQOrS, double *b0, double *b1, double *b2, double *a1, double *a2);
+#define GRAPHICEQ_MAX_BANDS 32
+// Shelving outer bands and peaking sections in between whose combined response meets gaindB at each band frequency.
+// Coefficients are written to sos, states are left untouched. Returns the number of sections, bands near Nyquist are dropped
+int GraphicEqDesign(const double *freq, const double *gaindB, int bands, double fs, DirectForm2 *sos);